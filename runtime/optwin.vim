@@ -401,6 +401,14 @@ if has("syntax")
   call append("$", "synmaxcol\tmaximum column to look for syntax items")
   call append("$", "\t(local to buffer)")
   call <SID>OptionL("smc")
+  if has("persistent_undo")
+    call append("$", "synstatefile\tsave the syntax state in a file")
+    call <SID>BinOptionG("ssf", &ssf)
+  endif
+  if has("reltime")
+    call append("$", "syntaxahead\tmsec for syntax parsing when redrawing")
+    call <SID>OptionG("sya", &sya)
+  endif
 endif
 call append("$", "highlight\twhich highlighting to use for various occasions")
 call <SID>OptionG("hl", &hl)
@@ -1034,6 +1042,8 @@ call append("$", "maxmem\tmaximum amount of memory in Kbyte used for one buffer"
 call append("$", " \tset mm=" . &mm)
 call append("$", "maxmemtot\tmaximum amount of memory in Kbyte used for all buffers")
 call append("$", " \tset mmt=" . &mmt)
+call append("$", "largefile\tminimum size in Kbyte of a file to read back unchanged text from")
+call append("$", " \tset lfs=" . &lfs)
 
 
 call <SID>Header("command line editing")
@@ -613,6 +613,9 @@ buf_freeall(buf, flags)
 #ifdef FEAT_DIFF
     diff_buf_delete(buf);	    /* Can't use 'diff' for unloaded buffer. */
 #endif
+#if defined(FEAT_SYN_HL) && defined(FEAT_PERSISTENT_UNDO)
+    syn_state_write(buf);	    /* save syntax states for 'synstatefile' */
+#endif
 #ifdef FEAT_SYN_HL
     /* Remove any ownsyntax, unless exiting. */
     if (firstwin != NULL && curwin->w_buffer == buf)
@@ -648,6 +651,9 @@ buf_freeall(buf, flags)
     }
 #ifdef FEAT_SYN_HL
     syntax_clear(&buf->b_s);	    /* reset syntax info */
+#endif
+#ifdef FEAT_SEARCH_EXTRA
+    sidx_clear(buf);		    /* free the search index */
 #endif
     buf->b_flags &= ~BF_READERR;    /* a read error is no longer relevant */
 }
@@ -730,6 +730,7 @@ static void f_synID __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_synIDattr __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_synIDtrans __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_synstack __ARGS((typval_T *argvars, typval_T *rettv));
+static void f_syntime __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_synconcealed __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_system __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_systemlist __ARGS((typval_T *argvars, typval_T *rettv));
@@ -8302,6 +8303,7 @@ static struct fst
     {"synIDtrans",	1, 1, f_synIDtrans},
     {"synconcealed",	2, 2, f_synconcealed},
     {"synstack",	2, 2, f_synstack},
+    {"syntime",		0, 0, f_syntime},
     {"system",		1, 2, f_system},
     {"systemlist",	1, 2, f_systemlist},
     {"tabpagebuflist",	0, 1, f_tabpagebuflist},
@@ -18741,6 +18743,22 @@ f_synstack(argvars, rettv)
 	}
     }
 #endif
+}
+
+/*
+ * "syntime()" function
+ */
+    static void
+f_syntime(argvars, rettv)
+    typval_T	*argvars UNUSED;
+    typval_T	*rettv;
+{
+    if (rettv_dict_alloc(rettv) == FAIL)
+	return;
+#if defined(FEAT_SYN_HL) && defined(FEAT_PROFILE)
+    if (syntax_present(curwin))
+	syntime_dict(rettv->vval.v_dict);
+#endif
 }
 
     static void
@@ -270,8 +270,12 @@ linelen(has_tab)
     return len;
 }
 
-/* Buffer for two lines used during sorting.  They are allocated to
- * contain the longest line being sorted. */
+/* Copy of the lines being sorted, each one followed by a NUL.  NULL when
+ * there was not enough memory, then lines are obtained with ml_get(). */
+static char_u	*sorttext;
+
+/* Buffer for two lines used during sorting when "sorttext" is NULL.  They are
+ * allocated to contain the longest line being sorted. */
 static char_u	*sortbuf1;
 static char_u	*sortbuf2;
 
@@ -285,6 +289,7 @@ static int	sort_abort;		/* flag to indicate if sorting has been interrupted */
 typedef struct
 {
     linenr_T	lnum;			/* line number */
+    long_u	text_off;		/* offset of the line in "sorttext" */
     long	start_col_nr;		/* starting column number or number */
     long	end_col_nr;		/* ending column number */
 } sorti_T;
@@ -321,6 +326,24 @@ sort_compare(s1, s2)
     if (sort_nr)
 	result = l1.start_col_nr == l2.start_col_nr ? 0
 				 : l1.start_col_nr > l2.start_col_nr ? 1 : -1;
+    else if (sorttext != NULL)
+    {
+	/* Compare the keys in the copied text directly.  Lines don't
+	 * contain a NUL, thus when the common part is equal the shorter key
+	 * sorts first, like with STRCMP(). */
+	long	len1 = l1.end_col_nr - l1.start_col_nr;
+	long	len2 = l2.end_col_nr - l2.start_col_nr;
+
+	result = sort_ic
+	    ? STRNICMP(sorttext + l1.text_off + l1.start_col_nr,
+		       sorttext + l2.text_off + l2.start_col_nr,
+		       len1 < len2 ? len1 : len2)
+	    : STRNCMP(sorttext + l1.text_off + l1.start_col_nr,
+		      sorttext + l2.text_off + l2.start_col_nr,
+		      len1 < len2 ? len1 : len2);
+	if (result == 0 && len1 != len2)
+	    result = len1 > len2 ? 1 : -1;
+    }
     else
     {
 	/* We need to copy one line into "sortbuf1", because there is no
@@ -354,12 +377,15 @@ ex_sort(eap)
     int		len;
     linenr_T	lnum;
     long	maxlen = 0;
+    long_u	textlen = 0;
+    long_u	textsize = 0;
     sorti_T	*nrs;
     size_t	count = (size_t)(eap->line2 - eap->line1 + 1);
     size_t	i;
     char_u	*p;
     char_u	*s;
     char_u	*s2;
+    char_u	*prev = NULL;
     char_u	c;			/* temporary character storage */
     int		unique = FALSE;
     long	deleted;
@@ -374,6 +400,7 @@ ex_sort(eap)
 
     if (u_save((linenr_T)(eap->line1 - 1), (linenr_T)(eap->line2 + 1)) == FAIL)
 	return;
+    sorttext = NULL;
     sortbuf1 = NULL;
     sortbuf2 = NULL;
     regmatch.regprog = NULL;
@@ -450,8 +477,10 @@ ex_sort(eap)
     sort_nr += sort_oct + sort_hex;
 
     /*
-     * Make an array with all line numbers.  This avoids having to copy all
-     * the lines into allocated memory.
+     * Make an array with all line numbers and copy the lines into
+     * "sorttext", so that comparing and putting back the lines doesn't need
+     * to go through the memline for every line.  When that copy can't be
+     * allocated the lines are obtained with ml_get() instead.
      * When sorting on strings "start_col_nr" is the offset in the line, for
      * numbers sorting it's the number to sort on.  This means the pattern
      * matching and number conversion only has to be done once per line.
@@ -464,6 +493,24 @@ ex_sort(eap)
 	if (maxlen < len)
 	    maxlen = len;
 
+	if ((lnum == eap->line1 || sorttext != NULL)
+					   && textlen + len + 1 > textsize)
+	{
+	    /* Double the size, to avoid copying the text many times. */
+	    textsize = textsize * 2 + len + 1 + 0x10000L;
+	    p = lalloc(textsize, FALSE);
+	    if (p != NULL && sorttext != NULL)
+		mch_memmove(p, sorttext, (size_t)textlen);
+	    vim_free(sorttext);
+	    sorttext = p;
+	}
+	if (sorttext != NULL)
+	{
+	    mch_memmove(sorttext + textlen, s, (size_t)len + 1);
+	    nrs[lnum - eap->line1].text_off = textlen;
+	    textlen += len + 1;
+	}
+
 	start_col = 0;
 	end_col = len;
 	if (regmatch.regprog != NULL && vim_regexec(&regmatch, s, 0))
@@ -518,13 +565,16 @@ ex_sort(eap)
 	    goto sortend;
     }
 
-    /* Allocate a buffer that can hold the longest line. */
-    sortbuf1 = alloc((unsigned)maxlen + 1);
-    if (sortbuf1 == NULL)
-	goto sortend;
-    sortbuf2 = alloc((unsigned)maxlen + 1);
-    if (sortbuf2 == NULL)
-	goto sortend;
+    if (sorttext == NULL)
+    {
+	/* Allocate a buffer that can hold the longest line. */
+	sortbuf1 = alloc((unsigned)maxlen + 1);
+	if (sortbuf1 == NULL)
+	    goto sortend;
+	sortbuf2 = alloc((unsigned)maxlen + 1);
+	if (sortbuf2 == NULL)
+	    goto sortend;
+    }
 
     /* Sort the array of line numbers.  Note: can't be interrupted! */
     qsort((void *)nrs, count, sizeof(sorti_T), sort_compare);
@@ -536,14 +586,25 @@ ex_sort(eap)
     lnum = eap->line2;
     for (i = 0; i < count; ++i)
     {
-	s = ml_get(nrs[eap->forceit ? count - i - 1 : i].lnum);
+	if (sorttext != NULL)
+	    s = sorttext + nrs[eap->forceit ? count - i - 1 : i].text_off;
+	else
+	    s = ml_get(nrs[eap->forceit ? count - i - 1 : i].lnum);
 	if (!unique || i == 0
-		|| (sort_ic ? STRICMP(s, sortbuf1) : STRCMP(s, sortbuf1)) != 0)
+		|| (sort_ic ? STRICMP(s, prev) : STRCMP(s, prev)) != 0)
 	{
 	    if (ml_append(lnum++, s, (colnr_T)0, FALSE) == FAIL)
 		break;
 	    if (unique)
-		STRCPY(sortbuf1, s);
+	    {
+		if (sorttext != NULL)
+		    prev = s;
+		else
+		{
+		    STRCPY(sortbuf1, s);
+		    prev = sortbuf1;
+		}
+	    }
 	}
 	fast_breakcheck();
 	if (got_int)
@@ -570,6 +631,8 @@ ex_sort(eap)
 
 sortend:
     vim_free(nrs);
+    vim_free(sorttext);
+    sorttext = NULL;
     vim_free(sortbuf1);
     vim_free(sortbuf2);
     vim_regfree(regmatch.regprog);
@@ -4565,6 +4628,11 @@ do_sub(eap)
 	regmatch.rmm_ic = TRUE;
     else if (do_ic == 'I')
 	regmatch.rmm_ic = FALSE;
+#ifdef FEAT_SEARCH_EXTRA
+    /* With ":g" only matching lines are used, the index doesn't help. */
+    if (!global_busy)
+	sidx_prepare(curbuf, &regmatch);
+#endif
 
     sub_firstline = NULL;
 
@@ -4586,8 +4654,18 @@ do_sub(eap)
 #endif
 		); ++lnum)
     {
+#ifdef FEAT_SEARCH_EXTRA
+	/* Skip a line the search index knows has no match.  Not used anymore
+	 * once lines were inserted or deleted. */
+	if (sidx_nomatch(curbuf, &regmatch, lnum))
+	    continue;
+#endif
 	nmatch = vim_regexec_multi(&regmatch, curwin, curbuf, lnum,
 							    (colnr_T)0, NULL);
+#ifdef FEAT_SEARCH_EXTRA
+	if (nmatch == 0)
+	    sidx_set_nomatch(curbuf, &regmatch, lnum);
+#endif
 	if (nmatch)
 	{
 	    colnr_T	copycol;
@@ -5466,14 +5544,29 @@ ex_global(eap)
 	return;
     }
 
+#ifdef FEAT_SEARCH_EXTRA
+    sidx_prepare(curbuf, &regmatch);
+#endif
+
     /*
      * pass 1: set marks for each (not) matching line
      */
     for (lnum = eap->line1; lnum <= eap->line2 && !got_int; ++lnum)
     {
 	/* a match on this line? */
-	match = vim_regexec_multi(&regmatch, curwin, curbuf, lnum,
+#ifdef FEAT_SEARCH_EXTRA
+	if (sidx_nomatch(curbuf, &regmatch, lnum))
+	    match = 0;
+	else
+#endif
+	{
+	    match = vim_regexec_multi(&regmatch, curwin, curbuf, lnum,
 							    (colnr_T)0, NULL);
+#ifdef FEAT_SEARCH_EXTRA
+	    if (match == 0)
+		sidx_set_nomatch(curbuf, &regmatch, lnum);
+#endif
+	}
 	if ((type == 'g' && match) || (type == 'v' && !match))
 	{
 	    ml_setmarked(lnum);
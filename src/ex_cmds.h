@@ -900,6 +900,9 @@ EX(CMD_mkvimrc,		"mkvimrc",	ex_mkrc,
 EX(CMD_mkview,		"mkview",	ex_mkrc,
 			BANG|FILE1|TRLBAR,
 			ADDR_LINES),
+EX(CMD_mlstat,		"mlstat",	ex_mlstat,
+			BANG|TRLBAR|CMDWIN,
+			ADDR_LINES),
 EX(CMD_mode,		"mode",		ex_mode,
 			WORD1|TRLBAR|CMDWIN,
 			ADDR_LINES),
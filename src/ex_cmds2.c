@@ -983,6 +983,23 @@ profile_divide(tm, count, tm2)
 # endif
     }
 }
+
+/*
+ * Return the time "tm" in seconds.
+ */
+    float_T
+profile_float(tm)
+    proftime_T  *tm;
+{
+# ifdef WIN3264
+    LARGE_INTEGER   fr;
+
+    QueryPerformanceFrequency(&fr);
+    return (float_T)tm->QuadPart / (float_T)fr.QuadPart;
+# else
+    return (float_T)tm->tv_sec + (float_T)tm->tv_usec / 1000000.0;
+# endif
+}
 #endif
 
 # if defined(FEAT_PROFILE) || defined(PROTO)
@@ -22,6 +22,11 @@
 #endif
 
 #define BUFSIZE		8192	/* size of normal write buffer */
+#if VIM_SIZEOF_INT <= 2
+# define WRITEBUFSIZE	BUFSIZE	/* size must fit in an int */
+#else
+# define WRITEBUFSIZE	65536	/* size of buffer for writing lines */
+#endif
 #define SMBUFSIZE	256	/* size of emergency write buffer */
 
 /* Is there any system that doesn't have access()? */
@@ -46,6 +51,10 @@ static char_u *check_for_cryptkey __ARGS((char_u *cryptkey, char_u *ptr, long *s
 #ifdef UNIX
 static void set_file_time __ARGS((char_u *fname, time_t atime, time_t mtime));
 #endif
+static char_u *find_nl_or_nul __ARGS((char_u *p, long len));
+#ifdef FEAT_MBYTE
+static char_u *skip_ascii __ARGS((char_u *p, long len));
+#endif
 static int set_rw_fname __ARGS((char_u *fname, char_u *sfname));
 static int msg_add_fileformat __ARGS((int eol_type));
 static void msg_add_eol __ARGS((void));
@@ -244,6 +253,7 @@ readfile(fname, sfname, from, lines_to_skip, lines_to_read, eap, flags)
     int		read_undo_file = FALSE;
 #endif
     int		split = 0;		/* number of split lines */
+    int		lazy_read = FALSE;	/* may read back text, 'largefile' */
 #define UNKNOWN	 0x0fffffff		/* file size is unknown */
     linenr_T	linecnt;
     int		error = FALSE;		/* errors encountered */
@@ -940,8 +950,11 @@ retry:
 	    goto failed;
 	}
 	/* Delete the previously read lines. */
+	ml_lazy_done(curbuf);
 	while (lnum > from)
 	    ml_delete(lnum--, FALSE);
+	if (wasempty)
+	    ml_lazy_free(curbuf);
 	file_rewind = FALSE;
 #ifdef FEAT_MBYTE
 	if (set_options)
@@ -1142,6 +1155,15 @@ retry:
 	filesize = 0;
 	skip_count = lines_to_skip;
 	read_count = lines_to_read;
+	/* When reading a whole file into an empty buffer the text may be read
+	 * back from the file later, see 'largefile'. */
+	lazy_read = (p_lfs > 0 && newfile && wasempty && from == 0
+				  && lines_to_skip == 0
+				  && lines_to_read == MAXLNUM
+				  && !filtering
+				  && !read_stdin
+				  && !read_buffer
+				  && (flags & READ_DUMMY) == 0);
 #ifdef FEAT_MBYTE
 	conv_restlen = 0;
 #endif
@@ -2008,9 +2030,11 @@ retry:
 		/* Reading UTF-8: Check if the bytes are valid UTF-8. */
 		for (p = ptr; ; ++p)
 		{
-		    int	 todo = (int)((ptr + size) - p);
+		    int	 todo;
 		    int	 l;
 
+		    p = skip_ascii(p, (long)((ptr + size) - p));
+		    todo = (int)((ptr + size) - p);
 		    if (todo <= 0)
 			break;
 		    if (*p >= 0x80)
@@ -2149,6 +2173,30 @@ rewind_retry:
 	    }
 	}
 
+	/*
+	 * For 'largefile' the text must be exactly what is in the file.
+	 */
+	if (lazy_read)
+	{
+	    lazy_read = FALSE;
+	    if (fileformat != EOL_MAC && split == 0
+#ifdef FEAT_MBYTE
+		    && !converted && tmpname == NULL
+		    && illegal_byte == 0 && conv_error == 0
+#endif
+#ifdef FEAT_CRYPT
+		    && cryptkey == NULL
+#endif
+		    )
+		(void)ml_lazy_start(curbuf, fd, fileformat);
+	}
+	else if ((curbuf->b_ml.ml_flags & ML_LAZY_LOAD) && (split != 0
+#ifdef FEAT_MBYTE
+		    || illegal_byte != 0 || conv_error != 0
+#endif
+		    ))
+	    ml_lazy_done(curbuf);
+
 	/*
 	 * This loop is executed once for every character read.
 	 * Keep it fast!
@@ -2196,12 +2244,18 @@ rewind_retry:
 	}
 	else
 	{
-	    --ptr;
-	    while (++ptr, --size >= 0)
+	    for ( ; size > 0; ++ptr)
 	    {
-		if ((c = *ptr) != NUL && c != NL)  /* catch most common case */
-		    continue;
-		if (c == NUL)
+		/* Skip over the most common characters quickly. */
+		p = find_nl_or_nul(ptr, size);
+		if (p == NULL)
+		{
+		    ptr += size;
+		    break;
+		}
+		size -= (long)(p - ptr) + 1;
+		ptr = p;
+		if (*ptr == NUL)
 		    *ptr = NL;	/* NULs are replaced by newlines! */
 		else
 		{
@@ -2239,6 +2293,10 @@ rewind_retry:
 				ff_error = EOL_DOS;
 			    }
 			}
+			if ((curbuf->b_ml.ml_flags & ML_LAZY_LOAD)
+				&& ml_lazy_offset(curbuf, lnum + 1, filesize
+				     - (off_t)(ptr + 1 + size - line_start)) == FAIL)
+			    ml_lazy_done(curbuf);
 			if (ml_append(lnum, line_start, len, newfile) == FAIL)
 			{
 			    error = TRUE;
@@ -2289,6 +2347,10 @@ failed:
 	    curbuf->b_p_eol = FALSE;
 	*ptr = NUL;
 	len = (colnr_T)(ptr - line_start + 1);
+	if ((curbuf->b_ml.ml_flags & ML_LAZY_LOAD)
+		&& ml_lazy_offset(curbuf, lnum + 1,
+				 filesize - (off_t)(ptr - line_start)) == FAIL)
+	    ml_lazy_done(curbuf);
 	if (ml_append(lnum, line_start, len, newfile) == FAIL)
 	    error = TRUE;
 	else
@@ -2301,6 +2363,9 @@ failed:
 	}
     }
 
+    /* Further changes are written to the swap file as usual. */
+    ml_lazy_done(curbuf);
+
     if (set_options)
 	save_file_ff(curbuf);		/* remember the current file format */
 
@@ -2697,7 +2762,71 @@ is_dev_fd_file(fname)
 }
 #endif
 
+/*
+ * The scanning functions below check a long_u at a time.  ONE_BYTES has 0x01
+ * in each byte, HIGH_BITS 0x80.  A word "w" has a zero byte when
+ * HAS_ZERO_BYTE(w) is non-zero.
+ */
+#define ONE_BYTES	(~(long_u)0 / 0xff)
+#define HIGH_BITS	(ONE_BYTES << 7)
+#define HAS_ZERO_BYTE(w) (((w) - ONE_BYTES) & ~(w) & HIGH_BITS)
+#define WORD_ALIGNED(p)	(((long_u)(p) & (sizeof(long_u) - 1)) == 0)
+
+/*
+ * Return a pointer to the first NL or NUL in "p[len]", NULL if there is none.
+ * Used by readfile() to quickly skip over the text of a line.
+ */
+    static char_u *
+find_nl_or_nul(p, len)
+    char_u	*p;
+    long	len;
+{
+    char_u	*end = p + len;
+    long_u	w;
+
+    while (p < end && !WORD_ALIGNED(p))
+    {
+	if (*p == NUL || *p == NL)
+	    return p;
+	++p;
+    }
+    while (end - p >= (long)sizeof(long_u))
+    {
+	w = *(long_u *)p;
+	if (HAS_ZERO_BYTE(w) || HAS_ZERO_BYTE(w ^ (ONE_BYTES * NL)))
+	    break;
+	p += sizeof(long_u);
+    }
+    for ( ; p < end; ++p)
+	if (*p == NUL || *p == NL)
+	    return p;
+    return NULL;
+}
+
 #ifdef FEAT_MBYTE
+/*
+ * Return a pointer to the first byte in "p[len]" that is not ASCII, "p + len"
+ * if there is none.
+ */
+    static char_u *
+skip_ascii(p, len)
+    char_u	*p;
+    long	len;
+{
+    char_u	*end = p + len;
+
+    while (p < end && !WORD_ALIGNED(p))
+    {
+	if (*p >= 0x80)
+	    return p;
+	++p;
+    }
+    while (end - p >= (long)sizeof(long_u) && (*(long_u *)p & HIGH_BITS) == 0)
+	p += sizeof(long_u);
+    while (p < end && *p < 0x80)
+	++p;
+    return p;
+}
 
 /*
  * From the current line count and characters read after that, estimate the
@@ -3099,8 +3228,11 @@ buf_write(buf, fname, sfname, start, end, eap, append, forceit,
     char_u	    *wfname = NULL;	/* name of file to write to */
     char_u	    *s;
     char_u	    *ptr;
+    char_u	    *p;
     char_u	    c;
     int		    len;
+    int		    n;
+    long	    linelen;
     linenr_T	    lnum;
     long	    nchars;
     char_u	    *errmsg = NULL;
@@ -3486,7 +3618,7 @@ buf_write(buf, fname, sfname, start, end, eap, append, forceit,
 		    (char_u *)"", 0);	/* show that we are busy */
     msg_scroll = FALSE;		    /* always overwrite the file message now */
 
-    buffer = alloc(BUFSIZE);
+    buffer = alloc(WRITEBUFSIZE);
     if (buffer == NULL)		    /* can't allocate big buffer, use small
 				     * one (to be able to write when out of
 				     * memory) */
@@ -3495,7 +3627,7 @@ buf_write(buf, fname, sfname, start, end, eap, append, forceit,
 	bufsize = SMBUFSIZE;
     }
     else
-	bufsize = BUFSIZE;
+	bufsize = WRITEBUFSIZE;
 
     /*
      * Get information about original file (if there is one).
@@ -3607,6 +3739,16 @@ buf_write(buf, fname, sfname, start, end, eap, append, forceit,
 	}
     }
 
+    /*
+     * Text of a buffer that is read back from this file ('largefile') must be
+     * in memory or in the swap file before the file is changed.
+     */
+    if (perm >= 0 && ml_lazy_before_write(fname) == FAIL)
+    {
+	errmsg = (char_u *)_("E891: Cannot read back text of the file before writing");
+	goto fail;
+    }
+
 #ifdef HAVE_ACL
     /*
      * For systems that support ACL: get the ACL from the original file.
@@ -4502,25 +4644,37 @@ restore_backup:
     len = 0;
     for (lnum = start; lnum <= end; ++lnum)
     {
-	/*
-	 * The next while loop is done once for each character written.
-	 * Keep it fast!
-	 */
-	ptr = ml_get_buf(buf, lnum, FALSE) - 1;
+	ptr = ml_get_buf(buf, lnum, FALSE);
+	linelen = (long)STRLEN(ptr);
 #ifdef FEAT_PERSISTENT_UNDO
 	if (write_undo_file)
-	    sha256_update(&sha_ctx, ptr + 1, (UINT32_T)(STRLEN(ptr + 1) + 1));
+	    sha256_update(&sha_ctx, ptr, (UINT32_T)(linelen + 1));
 #endif
-	while ((c = *++ptr) != NUL)
-	{
-	    if (c == NL)
-		*s = NUL;		/* replace newlines with NULs */
-	    else if (c == CAR && fileformat == EOL_MAC)
-		*s = NL;		/* Mac: replace CRs with NLs */
-	    else
-		*s = c;
-	    ++s;
-	    if (++len != bufsize)
+	/*
+	 * The next while loop is done once for each piece of the line that
+	 * fits in the buffer, for most lines just once.  Copy the piece and
+	 * then fix up the few characters that need it.  Keep it fast!
+	 */
+	while (linelen > 0)
+	{
+	    n = bufsize - len;
+	    if (n > linelen)
+		n = (int)linelen;
+	    mch_memmove(s, ptr, (size_t)n);
+	    /* replace newlines with NULs */
+	    for (p = s; (p = (char_u *)memchr(p, NL, (size_t)(s + n - p)))
+							       != NULL; ++p)
+		*p = NUL;
+	    /* Mac: replace CRs with NLs */
+	    if (fileformat == EOL_MAC)
+		for (p = s; (p = (char_u *)memchr(p, CAR, (size_t)(s + n - p)))
+							       != NULL; ++p)
+		    *p = NL;
+	    s += n;
+	    ptr += n;
+	    linelen -= n;
+	    len += n;
+	    if (len != bufsize)
 		continue;
 	    if (buf_write_bytes(&write_info) == FAIL)
 	    {
@@ -9231,6 +9385,15 @@ has_funcundefined()
     return (first_autopat[(int)EVENT_FUNCUNDEFINED] != NULL);
 }
 
+/*
+ * Return TRUE when there is a FileType autocommand defined.
+ */
+    int
+has_filetype_autocmd()
+{
+    return (first_autopat[(int)EVENT_FILETYPE] != NULL);
+}
+
     static int
 apply_autocmds_group(event, fname, fname_io, force, group, buf, eap)
     event_T	event;
@@ -9791,12 +9954,29 @@ has_autocmd(event, sfname, buf)
     event_T	event;
     char_u	*sfname;
     buf_T       *buf;
+{
+    return has_autocmd_except(event, sfname, buf, NULL);
+}
+
+/*
+ * Like has_autocmd(), but ignore autocommands in group "group_name", when it
+ * is not NULL.
+ */
+    int
+has_autocmd_except(event, sfname, buf, group_name)
+    event_T	event;
+    char_u	*sfname;
+    buf_T       *buf;
+    char_u	*group_name;
 {
     AutoPat	*ap;
     char_u	*fname;
     char_u	*tail = gettail(sfname);
+    int		group = AUGROUP_ERROR;
     int		retval = FALSE;
 
+    if (group_name != NULL)
+	group = au_find_group(group_name);
     fname = FullName_save(sfname, FALSE);
     if (fname == NULL)
 	return FALSE;
@@ -9814,6 +9994,7 @@ has_autocmd(event, sfname, buf)
 
     for (ap = first_autopat[(int)event]; ap != NULL; ap = ap->next)
 	if (ap->pat != NULL && ap->cmds != NULL
+	      && (group == AUGROUP_ERROR || ap->group != group)
 	      && (ap->buflocal_nr == 0
 		? match_file_pat(NULL, &ap->reg_prog,
 					  fname, sfname, tail, ap->allow_dirs)
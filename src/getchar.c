@@ -1566,8 +1566,9 @@ before_blocking()
  * updatescipt() is called when a character can be written into the script file
  * or when we have waited some time for a character (c == 0)
  *
- * All the changed memfiles are synced if c == 0 or when the number of typed
- * characters reaches 'updatecount' and 'updatecount' is non-zero.
+ * All the changed memfiles are synced if c == 0.  When the number of typed
+ * characters reaches 'updatecount' and 'updatecount' is non-zero syncing is
+ * started, the blocks are then written a few for each typed character.
  */
     void
 updatescript(c)
@@ -1577,11 +1578,20 @@ updatescript(c)
 
     if (c && scriptout)
 	putc(c, scriptout);
-    if (c == 0 || (p_uc > 0 && ++count >= p_uc))
+    if (c == 0)
     {
-	ml_sync_all(c == 0, TRUE);
+	ml_sync_all(TRUE, TRUE);
 	count = 0;
     }
+    else
+    {
+	if (p_uc > 0 && ++count >= p_uc)
+	{
+	    ml_sync_start();
+	    count = 0;
+	}
+	ml_sync_slice();
+    }
 }
 
 /*
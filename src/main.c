@@ -1513,6 +1513,11 @@ getout(exitval)
 	write_viminfo(NULL, FALSE);
 #endif
 
+#if defined(FEAT_SYN_HL) && defined(FEAT_PERSISTENT_UNDO)
+    /* Save the syntax states of loaded buffers for 'synstatefile'. */
+    syn_state_write_all();
+#endif
+
 #ifdef FEAT_AUTOCMD
     if (get_vim_var_nr(VV_DYING) <= 1)
 	apply_autocmds(EVENT_VIMLEAVE, NULL, NULL, FALSE, curbuf);
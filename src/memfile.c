@@ -66,10 +66,12 @@ extern int dos2;			/* this is in os_amiga.c */
 #endif
 
 #define MEMFILE_PAGE_SIZE 4096		/* default page size */
+#define MF_SYNC_SLICE	8		/* nr of blocks written by one
+					   mf_sync(MFS_SLICE) call */
 
 static long_u	total_mem_used = 0;	/* total memory used for memfiles */
 
-static void mf_ins_hash __ARGS((memfile_T *, bhdr_T *));
+static int  mf_ins_hash __ARGS((memfile_T *, bhdr_T *));
 static void mf_rem_hash __ARGS((memfile_T *, bhdr_T *));
 static bhdr_T *mf_find_hash __ARGS((memfile_T *, blocknr_T));
 static void mf_ins_used __ARGS((memfile_T *, bhdr_T *));
@@ -88,7 +90,8 @@ static void mf_hash_init __ARGS((mf_hashtab_T *));
 static void mf_hash_free __ARGS((mf_hashtab_T *));
 static void mf_hash_free_all __ARGS((mf_hashtab_T *));
 static mf_hashitem_T *mf_hash_find __ARGS((mf_hashtab_T *, blocknr_T));
-static void mf_hash_add_item __ARGS((mf_hashtab_T *, mf_hashitem_T *));
+static void mf_hash_put_slot __ARGS((mf_hashslot_T *, long_u, mf_hashitem_T *));
+static int  mf_hash_add_item __ARGS((mf_hashtab_T *, mf_hashitem_T *));
 static void mf_hash_rem_item __ARGS((mf_hashtab_T *, mf_hashitem_T *));
 static int mf_hash_grow __ARGS((mf_hashtab_T *));
 
@@ -154,9 +157,9 @@ mf_open(fname, flags)
     }
 
     mfp->mf_free_first = NULL;		/* free list is empty */
-    mfp->mf_used_first = NULL;		/* used list is empty */
-    mfp->mf_used_last = NULL;
+    mfp->mf_used_hand = NULL;		/* used ring is empty */
     mfp->mf_dirty = FALSE;
+    mfp->mf_sync_todo = FALSE;
     mfp->mf_used_count = 0;
     mf_hash_init(&mfp->mf_hash);
     mf_hash_init(&mfp->mf_trans);
@@ -255,8 +258,10 @@ mf_close(mfp, del_file)
     }
     if (del_file && mfp->mf_fname != NULL)
 	mch_remove(mfp->mf_fname);
-					    /* free entries in used list */
-    for (hp = mfp->mf_used_first; hp != NULL; hp = nextp)
+					    /* free entries in used ring */
+    if (mfp->mf_used_hand != NULL)
+	mfp->mf_used_hand->bh_prev->bh_next = NULL;	/* break the ring */
+    for (hp = mfp->mf_used_hand; hp != NULL; hp = nextp)
     {
 	total_mem_used -= hp->bh_page_count * mfp->mf_page_size;
 	nextp = hp->bh_next;
@@ -405,8 +410,12 @@ mf_new(mfp, negative, page_count)
     hp->bh_flags = BH_LOCKED | BH_DIRTY;	/* new block is always dirty */
     mfp->mf_dirty = TRUE;
     hp->bh_page_count = page_count;
+    if (mf_ins_hash(mfp, hp) == FAIL)	/* out of memory, number is lost */
+    {
+	mf_free_bhdr(hp);
+	return NULL;
+    }
     mf_ins_used(mfp, hp);
-    mf_ins_hash(mfp, hp);
 
     /*
      * Init the data to all zero, to avoid reading uninitialized data.
@@ -438,7 +447,7 @@ mf_get(mfp, nr, page_count)
      * see if it is in the cache
      */
     hp = mf_find_hash(mfp, nr);
-    if (hp == NULL)	/* not in the hash list */
+    if (hp == NULL)	/* not in the hash table */
     {
 	if (nr < 0 || nr >= mfp->mf_infile_count)   /* can't be in the file */
 	    return NULL;
@@ -455,23 +464,54 @@ mf_get(mfp, nr, page_count)
 	    return NULL;
 
 	hp->bh_bnum = nr;
-	hp->bh_flags = 0;
+	hp->bh_flags = BH_LOCKED;
 	hp->bh_page_count = page_count;
-	if (mf_read(mfp, hp) == FAIL)	    /* cannot read the block! */
+	if (mf_read(mfp, hp) == FAIL	    /* cannot read the block! */
+		|| mf_ins_hash(mfp, hp) == FAIL)
 	{
 	    mf_free_bhdr(hp);
 	    return NULL;
 	}
+	mf_ins_used(mfp, hp);	/* put just before the clock hand */
     }
     else
+	/* Only mark it as used, the clock hand will find it later. */
+	hp->bh_flags |= BH_LOCKED | BH_REF;
+
+    return hp;
+}
+
+/*
+ * Get a block header for block "nr" with "page_count" pages that is not in
+ * memory and not in the file, but can be produced by the caller.  Used for a
+ * negative block that was released without writing it, see mf_release().
+ * The caller must fill bh_data.  The block is locked and not dirty.
+ */
+    bhdr_T *
+mf_get_released(mfp, nr, page_count)
+    memfile_T	*mfp;
+    blocknr_T	nr;
+    int		page_count;
+{
+    bhdr_T    *hp;
+
+    if (nr >= mfp->mf_blocknr_max || nr <= mfp->mf_blocknr_min
+					    || mf_find_hash(mfp, nr) != NULL)
+	return NULL;
+
+    hp = mf_release(mfp, page_count);
+    if (hp == NULL && (hp = mf_alloc_bhdr(mfp, page_count)) == NULL)
+	return NULL;
+
+    hp->bh_bnum = nr;
+    hp->bh_flags = BH_LOCKED;
+    hp->bh_page_count = page_count;
+    if (mf_ins_hash(mfp, hp) == FAIL)
     {
-	mf_rem_used(mfp, hp);	/* remove from list, insert in front below */
-	mf_rem_hash(mfp, hp);
+	mf_free_bhdr(hp);
+	return NULL;
     }
-
-    hp->bh_flags |= BH_LOCKED;
-    mf_ins_used(mfp, hp);	/* put in front of used list */
-    mf_ins_hash(mfp, hp);	/* put in front of hash list */
+    mf_ins_used(mfp, hp);	/* put just before the clock hand */
 
     return hp;
 }
@@ -517,8 +557,8 @@ mf_free(mfp, hp)
     bhdr_T	*hp;
 {
     vim_free(hp->bh_data);	/* free the memory */
-    mf_rem_hash(mfp, hp);	/* get *hp out of the hash list */
-    mf_rem_used(mfp, hp);	/* get *hp out of the used list */
+    mf_rem_hash(mfp, hp);	/* get *hp out of the hash table */
+    mf_rem_used(mfp, hp);	/* get *hp out of the used ring */
     if (hp->bh_bnum < 0)
     {
 	vim_free(hp);		/* don't want negative numbers in free list */
@@ -549,6 +589,9 @@ fdtofh(int filedescriptor)
  *  MFS_FLUSH	Make sure buffers are flushed to disk, so they will survive a
  *		system crash.
  *  MFS_ZERO	Only write block 0.
+ *  MFS_SLICE	Only write blocks marked by mf_sync_start(), at most
+ *		MF_SYNC_SLICE of them.  MFS_FLUSH only applies to the call
+ *		that writes the last one.
  *
  * Return FAIL for failure, OK otherwise
  */
@@ -559,6 +602,8 @@ mf_sync(mfp, flags)
 {
     int		status;
     bhdr_T	*hp;
+    bhdr_T	*last;
+    int		slice = MF_SYNC_SLICE;
 #if defined(SYNC_DUP_CLOSE) && !defined(MSDOS)
     int		fd;
 #endif
@@ -567,6 +612,7 @@ mf_sync(mfp, flags)
     if (mfp->mf_fd < 0)	    /* there is no file, nothing to do */
     {
 	mfp->mf_dirty = FALSE;
+	mfp->mf_sync_todo = FALSE;
 	return FAIL;
     }
 
@@ -575,13 +621,16 @@ mf_sync(mfp, flags)
     got_int = FALSE;
 
     /*
-     * sync from last to first (may reduce the probability of an inconsistent
-     * file) If a write fails, it is very likely caused by a full filesystem.
-     * Then we only try to write blocks within the existing file. If that also
-     * fails then we give up.
+     * sync going around the used ring from the clock hand, oldest block first
+     * (may reduce the probability of an inconsistent file) If a write fails,
+     * it is very likely caused by a full filesystem. Then we only try to
+     * write blocks within the existing file. If that also fails then we give
+     * up.
      */
     status = OK;
-    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+    hp = mfp->mf_used_hand;
+    last = hp == NULL ? NULL : hp->bh_prev;
+    for ( ; hp != NULL; hp = hp == last ? NULL : hp->bh_next)
 	if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
 		&& (hp->bh_flags & BH_DIRTY)
 		&& (status == OK || (hp->bh_bnum >= 0
@@ -589,6 +638,13 @@ mf_sync(mfp, flags)
 	{
 	    if ((flags & MFS_ZERO) && hp->bh_bnum != 0)
 		continue;
+	    if (flags & MFS_SLICE)
+	    {
+		if (!(hp->bh_flags & BH_SYNC))
+		    continue;
+		if (slice-- == 0)
+		    break;
+	    }
 	    if (mf_write(mfp, hp) == FAIL)
 	    {
 		if (status == FAIL)	/* double error: quit syncing */
@@ -608,13 +664,20 @@ mf_sync(mfp, flags)
 	}
 
     /*
-     * If the whole list is flushed, the memfile is not dirty anymore.
+     * If the whole ring is flushed, the memfile is not dirty anymore.
      * In case of an error this flag is also set, to avoid trying all the time.
      */
     if (hp == NULL || status == FAIL)
-	mfp->mf_dirty = FALSE;
+    {
+	/* blocks changed after mf_sync_start() may still be dirty */
+	if (!(flags & MFS_SLICE))
+	    mfp->mf_dirty = FALSE;
+	if (!(flags & MFS_ZERO))
+	    mfp->mf_sync_todo = FALSE;
+    }
 
-    if ((flags & MFS_FLUSH) && *p_sws != NUL)
+    if ((flags & MFS_FLUSH) && *p_sws != NUL
+			       && !((flags & MFS_SLICE) && mfp->mf_sync_todo))
     {
 #if defined(UNIX)
 # ifdef HAVE_FSYNC
@@ -715,6 +778,31 @@ mf_sync(mfp, flags)
     return status;
 }
 
+/*
+ * Mark the dirty blocks of memfile *mfp to be written by following
+ * mf_sync(MFS_SLICE) calls.  Blocks that get dirty later are not included,
+ * the swap file then contains at least the changes made before this call.
+ */
+    void
+mf_sync_start(mfp)
+    memfile_T	*mfp;
+{
+    bhdr_T	*hp;
+
+    if (mfp->mf_fd < 0 || (hp = mfp->mf_used_hand) == NULL)
+	return;
+    do
+    {
+	/* negative blocks are only written by mf_sync(MFS_ALL) */
+	if ((hp->bh_flags & BH_DIRTY) && hp->bh_bnum >= 0)
+	{
+	    hp->bh_flags |= BH_SYNC;
+	    mfp->mf_sync_todo = TRUE;
+	}
+	hp = hp->bh_next;
+    } while (hp != mfp->mf_used_hand);
+}
+
 /*
  * For all blocks in memory file *mfp that have a positive block number set
  * the dirty flag.  These are blocks that need to be written to a newly
@@ -726,25 +814,31 @@ mf_set_dirty(mfp)
 {
     bhdr_T	*hp;
 
-    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
-	if (hp->bh_bnum > 0)
-	    hp->bh_flags |= BH_DIRTY;
+    hp = mfp->mf_used_hand;
+    if (hp != NULL)
+	do
+	{
+	    if (hp->bh_bnum > 0)
+		hp->bh_flags |= BH_DIRTY;
+	    hp = hp->bh_next;
+	} while (hp != mfp->mf_used_hand);
     mfp->mf_dirty = TRUE;
 }
 
 /*
- * insert block *hp in front of hashlist of memfile *mfp
+ * insert block *hp in the hash table of memfile *mfp
+ * Return FAIL when out of memory.
  */
-    static void
+    static int
 mf_ins_hash(mfp, hp)
     memfile_T	*mfp;
     bhdr_T	*hp;
 {
-    mf_hash_add_item(&mfp->mf_hash, (mf_hashitem_T *)hp);
+    return mf_hash_add_item(&mfp->mf_hash, (mf_hashitem_T *)hp);
 }
 
 /*
- * remove block *hp from hashlist of memfile list *mfp
+ * remove block *hp from the hash table of memfile *mfp
  */
     static void
 mf_rem_hash(mfp, hp)
@@ -755,7 +849,7 @@ mf_rem_hash(mfp, hp)
 }
 
 /*
- * look in hash lists of memfile *mfp for block header with number 'nr'
+ * look in hash table of memfile *mfp for block header with number 'nr'
  */
     static bhdr_T *
 mf_find_hash(mfp, nr)
@@ -766,47 +860,60 @@ mf_find_hash(mfp, nr)
 }
 
 /*
- * insert block *hp in front of used list of memfile *mfp
+ * insert block *hp in the used ring of memfile *mfp, just before the clock
+ * hand, so that it is the last one the hand gets to
  */
     static void
 mf_ins_used(mfp, hp)
     memfile_T	*mfp;
     bhdr_T	*hp;
 {
-    hp->bh_next = mfp->mf_used_first;
-    mfp->mf_used_first = hp;
-    hp->bh_prev = NULL;
-    if (hp->bh_next == NULL)	    /* list was empty, adjust last pointer */
-	mfp->mf_used_last = hp;
+    bhdr_T	*hand = mfp->mf_used_hand;
+
+    if (hand == NULL)		    /* ring was empty */
+    {
+	hp->bh_next = hp;
+	hp->bh_prev = hp;
+	mfp->mf_used_hand = hp;
+    }
     else
-	hp->bh_next->bh_prev = hp;
+    {
+	hp->bh_next = hand;
+	hp->bh_prev = hand->bh_prev;
+	hand->bh_prev->bh_next = hp;
+	hand->bh_prev = hp;
+    }
     mfp->mf_used_count += hp->bh_page_count;
     total_mem_used += hp->bh_page_count * mfp->mf_page_size;
 }
 
 /*
- * remove block *hp from used list of memfile *mfp
+ * remove block *hp from used ring of memfile *mfp
+ * When the clock hand points to it, the hand moves on to the next block.
  */
     static void
 mf_rem_used(mfp, hp)
     memfile_T	*mfp;
     bhdr_T	*hp;
 {
-    if (hp->bh_next == NULL)	    /* last block in used list */
-	mfp->mf_used_last = hp->bh_prev;
+    if (hp->bh_next == hp)	    /* only block in used ring */
+	mfp->mf_used_hand = NULL;
     else
+    {
 	hp->bh_next->bh_prev = hp->bh_prev;
-    if (hp->bh_prev == NULL)	    /* first block in used list */
-	mfp->mf_used_first = hp->bh_next;
-    else
 	hp->bh_prev->bh_next = hp->bh_next;
+	if (mfp->mf_used_hand == hp)
+	    mfp->mf_used_hand = hp->bh_next;
+    }
     mfp->mf_used_count -= hp->bh_page_count;
     total_mem_used -= hp->bh_page_count * mfp->mf_page_size;
 }
 
 /*
- * Release the least recently used block from the used list if the number
- * of used memory blocks gets to big.
+ * Release a block that was not used recently from the used ring if the number
+ * of used memory blocks gets to big.  Uses the CLOCK algorithm: the hand goes
+ * around the ring, skipping locked blocks and clearing BH_REF, until it finds
+ * an unlocked block without BH_REF.
  *
  * Return the block header to the caller, including the memory block, so
  * it can be re-used. Make sure the page_count is right.
@@ -819,6 +926,7 @@ mf_release(mfp, page_count)
     bhdr_T	*hp;
     int		need_release;
     buf_T	*buf;
+    int		round;
 
     /* don't release while in mf_close_file() */
     if (mf_dont_release)
@@ -856,15 +964,31 @@ mf_release(mfp, page_count)
     if (mfp->mf_fd < 0 || !need_release)
 	return NULL;
 
-    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+    /* After going around once all BH_REF flags are cleared, thus the second
+     * round finds a block unless they are all locked. */
+    hp = mfp->mf_used_hand;
+    round = 0;
+    while (hp != NULL)
+    {
 	if (!(hp->bh_flags & BH_LOCKED))
-	    break;
+	{
+	    if (!(hp->bh_flags & BH_REF))
+		break;
+	    hp->bh_flags &= ~BH_REF;
+	}
+	hp = hp->bh_next;
+	if (hp == mfp->mf_used_hand && ++round == 2)
+	    hp = NULL;
+    }
     if (hp == NULL)	/* not a single one that can be released */
 	return NULL;
+    mfp->mf_used_hand = hp;	/* mf_rem_used() moves it past "hp" */
 
     /*
      * If the block is dirty, write it.
      * If the write fails we don't free it.
+     * A negative block that is not dirty is dropped, it can be read back
+     * from the original file (see ml_lazy_reload()).
      */
     if ((hp->bh_flags & BH_DIRTY) && mf_write(mfp, hp) == FAIL)
 	return NULL;
@@ -900,7 +1024,7 @@ mf_release_all()
 {
     buf_T	*buf;
     memfile_T	*mfp;
-    bhdr_T	*hp;
+    bhdr_T	*hp, *nextp, *last;
     int		retval = FALSE;
 
     for (buf = firstbuf; buf != NULL; buf = buf->b_next)
@@ -915,8 +1039,13 @@ mf_release_all()
 	    /* only if there is a swapfile */
 	    if (mfp->mf_fd >= 0)
 	    {
-		for (hp = mfp->mf_used_last; hp != NULL; )
+		/* Go around the used ring once, removing blocks does not
+		 * change "nextp" or "last". */
+		hp = mfp->mf_used_hand;
+		last = hp == NULL ? NULL : hp->bh_prev;
+		for ( ; hp != NULL; hp = nextp)
 		{
+		    nextp = hp == last ? NULL : hp->bh_next;
 		    if (!(hp->bh_flags & BH_LOCKED)
 			    && (!(hp->bh_flags & BH_DIRTY)
 				|| mf_write(mfp, hp) != FAIL))
@@ -924,11 +1053,8 @@ mf_release_all()
 			mf_rem_used(mfp, hp);
 			mf_rem_hash(mfp, hp);
 			mf_free_bhdr(hp);
-			hp = mfp->mf_used_last;	/* re-start, list was changed */
 			retval = TRUE;
 		    }
-		    else
-			hp = hp->bh_prev;
 		}
 	    }
 	}
@@ -1066,7 +1192,7 @@ mf_write(mfp, hp)
     /*
      * We don't want gaps in the file. Write the blocks in front of *hp
      * to extend the file.
-     * If block 'mf_infile_count' is not in the hash list, it has been
+     * If block 'mf_infile_count' is not in the hash table, it has been
      * freed. Fill the space in the file with data from the current block.
      */
     for (;;)
@@ -1106,7 +1232,7 @@ mf_write(mfp, hp)
 	}
 	did_swapwrite_msg = FALSE;
 	if (hp2 != NULL)		    /* written a non-dummy block */
-	    hp2->bh_flags &= ~BH_DIRTY;
+	    hp2->bh_flags &= ~(BH_DIRTY | BH_SYNC);
 					    /* appended to the file */
 	if (nr + (blocknr_T)page_count > mfp->mf_infile_count)
 	    mfp->mf_infile_count = nr + page_count;
@@ -1173,6 +1299,15 @@ mf_trans_add(mfp, hp)
     if ((np = (NR_TRANS *)alloc((unsigned)sizeof(NR_TRANS))) == NULL)
 	return FAIL;
 
+    /* Insert "np" into "mf_trans" hashtable with key "np->nt_old_bnum"
+     * before taking a number, so that failing leaves everything as it was. */
+    np->nt_old_bnum = hp->bh_bnum;
+    if (mf_hash_add_item(&mfp->mf_trans, (mf_hashitem_T *)np) == FAIL)
+    {
+	vim_free(np);
+	return FAIL;
+    }
+
 /*
  * Get a new number for the block.
  * If the first item in the free list has sufficient pages, use its number
@@ -1204,15 +1339,12 @@ mf_trans_add(mfp, hp)
 	mfp->mf_blocknr_max += page_count;
     }
 
-    np->nt_old_bnum = hp->bh_bnum;	    /* adjust number */
-    np->nt_new_bnum = new_bnum;
+    np->nt_new_bnum = new_bnum;		    /* adjust number */
 
-    mf_rem_hash(mfp, hp);		    /* remove from old hash list */
+    /* Re-inserting with the new number can't fail, removing made room. */
+    mf_rem_hash(mfp, hp);
     hp->bh_bnum = new_bnum;
-    mf_ins_hash(mfp, hp);		    /* insert in new hash list */
-
-    /* Insert "np" into "mf_trans" hashtable with key "np->nt_old_bnum" */
-    mf_hash_add_item(&mfp->mf_trans, (mf_hashitem_T *)np);
+    (void)mf_ins_hash(mfp, hp);
 
     return OK;
 }
@@ -1370,13 +1502,19 @@ mf_do_open(mfp, fname, flags)
  */
 
 /*
- * The number of buckets in the hashtable is increased by a factor of
- * MHT_GROWTH_FACTOR when the average number of items per bucket
- * exceeds 2 ^ MHT_LOG_LOAD_FACTOR.
+ * The number of slots in the hashtable is increased by a factor of
+ * MHT_GROWTH_FACTOR when it would get more than half full.
  */
-#define MHT_LOG_LOAD_FACTOR 6
 #define MHT_GROWTH_FACTOR   2   /* must be a power of two */
 
+/*
+ * The home slot of block number "key".  The number is scrambled, so that
+ * consecutive block numbers are spread over the table instead of forming one
+ * long run of used slots, which would make removing an item slow.
+ */
+#define MHT_HASH(key)	    ((long_u)(key) * 2654435769UL)
+#define MHT_HOME(key, mask) ((MHT_HASH(key) ^ (MHT_HASH(key) >> 16)) & (mask))
+
 /*
  * Initialize an empty hash table.
  */
@@ -1385,7 +1523,7 @@ mf_hash_init(mht)
     mf_hashtab_T *mht;
 {
     vim_memset(mht, 0, sizeof(mf_hashtab_T));
-    mht->mht_buckets = mht->mht_small_buckets;
+    mht->mht_slots = mht->mht_small_slots;
     mht->mht_mask = MHT_INIT_SIZE - 1;
 }
 
@@ -1397,8 +1535,8 @@ mf_hash_init(mht)
 mf_hash_free(mht)
     mf_hashtab_T *mht;
 {
-    if (mht->mht_buckets != mht->mht_small_buckets)
-	vim_free(mht->mht_buckets);
+    if (mht->mht_slots != mht->mht_small_slots)
+	vim_free(mht->mht_slots);
 }
 
 /*
@@ -1409,15 +1547,9 @@ mf_hash_free_all(mht)
     mf_hashtab_T    *mht;
 {
     long_u	    idx;
-    mf_hashitem_T   *mhi;
-    mf_hashitem_T   *next;
 
     for (idx = 0; idx <= mht->mht_mask; idx++)
-	for (mhi = mht->mht_buckets[idx]; mhi != NULL; mhi = next)
-	{
-	    next = mhi->mhi_next;
-	    vim_free(mhi);
-	}
+	vim_free(mht->mht_slots[idx].mhs_item);
 
     mf_hash_free(mht);
 }
@@ -1431,41 +1563,51 @@ mf_hash_find(mht, key)
     mf_hashtab_T    *mht;
     blocknr_T	    key;
 {
-    mf_hashitem_T   *mhi;
+    mf_hashslot_T   *slots = mht->mht_slots;
+    long_u	    mask = mht->mht_mask;
+    long_u	    idx;
 
-    mhi = mht->mht_buckets[key & mht->mht_mask];
-    while (mhi != NULL && mhi->mhi_key != key)
-	mhi = mhi->mhi_next;
+    /* There always is an empty slot, thus this loop ends. */
+    for (idx = MHT_HOME(key, mask); slots[idx].mhs_item != NULL;
+							idx = (idx + 1) & mask)
+	if (slots[idx].mhs_key == key)
+	    return slots[idx].mhs_item;
+    return NULL;
+}
 
-    return mhi;
+/*
+ * Put item "mhi" in the first free slot at or after its home slot in "slots",
+ * which has "mask" + 1 entries.
+ */
+    static void
+mf_hash_put_slot(slots, mask, mhi)
+    mf_hashslot_T   *slots;
+    long_u	    mask;
+    mf_hashitem_T   *mhi;
+{
+    long_u	    idx;
+
+    for (idx = MHT_HOME(mhi->mhi_key, mask); slots[idx].mhs_item != NULL;
+							idx = (idx + 1) & mask)
+	;
+    slots[idx].mhs_key = mhi->mhi_key;
+    slots[idx].mhs_item = mhi;
 }
 
 /*
  * Add item "mhi" to hashtable "mht".
  * "mhi" must not be NULL.
+ * Returns FAIL when the table could not grow and is full.
  */
-    static void
+    static int
 mf_hash_add_item(mht, mhi)
     mf_hashtab_T    *mht;
     mf_hashitem_T   *mhi;
 {
-    long_u	    idx;
-
-    idx = mhi->mhi_key & mht->mht_mask;
-    mhi->mhi_next = mht->mht_buckets[idx];
-    mhi->mhi_prev = NULL;
-    if (mhi->mhi_next != NULL)
-	mhi->mhi_next->mhi_prev = mhi;
-    mht->mht_buckets[idx] = mhi;
-
-    mht->mht_count++;
-
     /*
-     * Grow hashtable when we have more thank 2^MHT_LOG_LOAD_FACTOR
-     * items per bucket on average
+     * Grow hashtable when it would get more than half full.
      */
-    if (mht->mht_fixed == 0
-	&& (mht->mht_count >> MHT_LOG_LOAD_FACTOR) > mht->mht_mask)
+    if (mht->mht_fixed == 0 && (mht->mht_count + 1) * 2 > mht->mht_mask + 1)
     {
 	if (mf_hash_grow(mht) == FAIL)
 	{
@@ -1473,6 +1615,14 @@ mf_hash_add_item(mht, mhi)
 	    mht->mht_fixed = 1;
 	}
     }
+
+    /* Keep at least one slot empty, lookups stop there. */
+    if (mht->mht_count >= mht->mht_mask)
+	return FAIL;
+
+    mf_hash_put_slot(mht->mht_slots, mht->mht_mask, mhi);
+    mht->mht_count++;
+    return OK;
 }
 
 /*
@@ -1484,13 +1634,33 @@ mf_hash_rem_item(mht, mhi)
     mf_hashtab_T    *mht;
     mf_hashitem_T   *mhi;
 {
-    if (mhi->mhi_prev == NULL)
-	mht->mht_buckets[mhi->mhi_key & mht->mht_mask] = mhi->mhi_next;
-    else
-	mhi->mhi_prev->mhi_next = mhi->mhi_next;
+    mf_hashslot_T   *slots = mht->mht_slots;
+    long_u	    mask = mht->mht_mask;
+    long_u	    hole;
+    long_u	    idx;
+    long_u	    home;
 
-    if (mhi->mhi_next != NULL)
-	mhi->mhi_next->mhi_prev = mhi->mhi_prev;
+    for (hole = MHT_HOME(mhi->mhi_key, mask); slots[hole].mhs_item != mhi;
+						      hole = (hole + 1) & mask)
+	if (slots[hole].mhs_item == NULL)
+	    return;	    /* not found, can't happen */
+
+    /*
+     * Instead of leaving a "deleted" marker, move items following the hole
+     * back into it when that doesn't put them before their home slot.  This
+     * keeps every item reachable from its home slot without gaps.
+     */
+    for (idx = (hole + 1) & mask; slots[idx].mhs_item != NULL;
+							idx = (idx + 1) & mask)
+    {
+	home = MHT_HOME(slots[idx].mhs_key, mask);
+	if (((idx - home) & mask) >= ((idx - hole) & mask))
+	{
+	    slots[hole] = slots[idx];
+	    hole = idx;
+	}
+    }
+    slots[hole].mhs_item = NULL;
 
     mht->mht_count--;
 
@@ -1499,7 +1669,7 @@ mf_hash_rem_item(mht, mhi)
 }
 
 /*
- * Increase number of buckets in the hashtable by MHT_GROWTH_FACTOR and
+ * Increase number of slots in the hashtable by MHT_GROWTH_FACTOR and
  * rehash items.
  * Returns FAIL when out of memory.
  */
@@ -1507,64 +1677,25 @@ mf_hash_rem_item(mht, mhi)
 mf_hash_grow(mht)
     mf_hashtab_T    *mht;
 {
-    long_u	    i, j;
-    int		    shift;
-    mf_hashitem_T   *mhi;
-    mf_hashitem_T   *tails[MHT_GROWTH_FACTOR];
-    mf_hashitem_T   **buckets;
-    size_t	    size;
-
-    size = (mht->mht_mask + 1) * MHT_GROWTH_FACTOR * sizeof(void *);
-    buckets = (mf_hashitem_T **)lalloc_clear(size, FALSE);
-    if (buckets == NULL)
+    long_u	    i;
+    long_u	    new_mask;
+    mf_hashslot_T   *slots;
+
+    new_mask = (mht->mht_mask + 1) * MHT_GROWTH_FACTOR - 1;
+    slots = (mf_hashslot_T *)lalloc_clear(
+			     (new_mask + 1) * sizeof(mf_hashslot_T), FALSE);
+    if (slots == NULL)
 	return FAIL;
 
-    shift = 0;
-    while ((mht->mht_mask >> shift) != 0)
-	shift++;
-
     for (i = 0; i <= mht->mht_mask; i++)
-    {
-	/*
-	 * Traverse the items in the i-th original bucket and move them into
-	 * MHT_GROWTH_FACTOR new buckets, preserving their relative order
-	 * within each new bucket.  Preserving the order is important because
-	 * mf_get() tries to keep most recently used items at the front of
-	 * each bucket.
-	 *
-	 * Here we strongly rely on the fact the hashes are computed modulo
-	 * a power of two.
-	 */
-
-	vim_memset(tails, 0, sizeof(tails));
-
-	for (mhi = mht->mht_buckets[i]; mhi != NULL; mhi = mhi->mhi_next)
-	{
-	    j = (mhi->mhi_key >> shift) & (MHT_GROWTH_FACTOR - 1);
-	    if (tails[j] == NULL)
-	    {
-		buckets[i + (j << shift)] = mhi;
-		tails[j] = mhi;
-		mhi->mhi_prev = NULL;
-	    }
-	    else
-	    {
-		tails[j]->mhi_next = mhi;
-		mhi->mhi_prev = tails[j];
-		tails[j] = mhi;
-	    }
-	}
-
-	for (j = 0; j < MHT_GROWTH_FACTOR; j++)
-	    if (tails[j] != NULL)
-		tails[j]->mhi_next = NULL;
-    }
+	if (mht->mht_slots[i].mhs_item != NULL)
+	    mf_hash_put_slot(slots, new_mask, mht->mht_slots[i].mhs_item);
 
-    if (mht->mht_buckets != mht->mht_small_buckets)
-	vim_free(mht->mht_buckets);
+    if (mht->mht_slots != mht->mht_small_slots)
+	vim_free(mht->mht_slots);
 
-    mht->mht_buckets = buckets;
-    mht->mht_mask = (mht->mht_mask + 1) * MHT_GROWTH_FACTOR - 1;
+    mht->mht_slots = slots;
+    mht->mht_mask = new_mask;
 
     return OK;
 }
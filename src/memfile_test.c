@@ -25,7 +25,15 @@
 #define index_to_key(i) ((i) ^ 15167)
 #define TEST_COUNT 50000
 
+#define BENCH_BLOCKS 4096
+#define BENCH_HOT 16
+#define BENCH_ROUNDS 20
+#define BENCH_HITS 1000000L
+
 static void test_mf_hash __ARGS((void));
+static void test_mf_hash_collide __ARGS((void));
+static void test_mf_clock __ARGS((void));
+static void test_mf_sync_slice __ARGS((void));
 
 /*
  * Test mf_hash_*() functions.
@@ -37,7 +45,7 @@ test_mf_hash()
     mf_hashitem_T  *item;
     blocknr_T      key;
     long_u	   i;
-    long_u	   num_buckets;
+    long_u	   num_slots;
 
     mf_hash_init(&ht);
 
@@ -46,41 +54,41 @@ test_mf_hash()
     {
 	assert(ht.mht_count == i);
 
-	/* check that number of buckets is a power of 2 */
-	num_buckets = ht.mht_mask + 1;
-	assert(num_buckets > 0 && (num_buckets & (num_buckets - 1)) == 0);
+	/* check that number of slots is a power of 2 */
+	num_slots = ht.mht_mask + 1;
+	assert(num_slots > 0 && (num_slots & (num_slots - 1)) == 0);
 
-	/* check load factor */
-	assert(ht.mht_count <= (num_buckets << MHT_LOG_LOAD_FACTOR));
+	/* check load factor: at most half full */
+	assert(ht.mht_count * 2 <= num_slots);
 
-	if (i < (MHT_INIT_SIZE << MHT_LOG_LOAD_FACTOR))
+	if (i <= MHT_INIT_SIZE / 2)
 	{
 	    /* first expansion shouldn't have occurred yet */
-	    assert(num_buckets == MHT_INIT_SIZE);
-	    assert(ht.mht_buckets == ht.mht_small_buckets);
+	    assert(num_slots == MHT_INIT_SIZE);
+	    assert(ht.mht_slots == ht.mht_small_slots);
 	}
 	else
 	{
-	    assert(num_buckets > MHT_INIT_SIZE);
-	    assert(ht.mht_buckets != ht.mht_small_buckets);
+	    assert(num_slots > MHT_INIT_SIZE);
+	    assert(ht.mht_slots != ht.mht_small_slots);
 	}
 
 	key = index_to_key(i);
 	assert(mf_hash_find(&ht, key) == NULL);
 
 	/* allocate and add new item */
-	item = (mf_hashitem_T *)lalloc_clear(sizeof(mf_hashtab_T), FALSE);
+	item = (mf_hashitem_T *)lalloc_clear(sizeof(mf_hashitem_T), FALSE);
 	assert(item != NULL);
 	item->mhi_key = key;
-	mf_hash_add_item(&ht, item);
+	assert(mf_hash_add_item(&ht, item) == OK);
 
 	assert(mf_hash_find(&ht, key) == item);
 
-	if (ht.mht_mask + 1 != num_buckets)
+	if (ht.mht_mask + 1 != num_slots)
 	{
 	    /* hash table was expanded */
-	    assert(ht.mht_mask + 1 == num_buckets * MHT_GROWTH_FACTOR);
-	    assert(i + 1 == (num_buckets << MHT_LOG_LOAD_FACTOR));
+	    assert(ht.mht_mask + 1 == num_slots * MHT_GROWTH_FACTOR);
+	    assert(i == num_slots / 2);
 	}
     }
 
@@ -106,7 +114,7 @@ test_mf_hash()
 	    mf_hash_rem_item(&ht, item);
 	    assert(mf_hash_find(&ht, key) == NULL);
 
-	    mf_hash_add_item(&ht, item);
+	    assert(mf_hash_add_item(&ht, item) == OK);
 	    assert(mf_hash_find(&ht, key) == item);
 
 	    mf_hash_rem_item(&ht, item);
@@ -137,9 +145,193 @@ test_mf_hash()
     mf_hash_free_all(&ht);
 }
 
+/*
+ * Test a table that can't grow, with keys that all have the same home slot.
+ */
+    static void
+test_mf_hash_collide()
+{
+    mf_hashtab_T   ht;
+    mf_hashitem_T  items[MHT_INIT_SIZE];
+    long_u	   i, j;
+    blocknr_T	   key = 0;
+
+    mf_hash_init(&ht);
+    ht.mht_fixed = 1;
+
+    /* one slot must stay empty */
+    for (i = 0; i < MHT_INIT_SIZE; i++)
+    {
+	/* all keys have the same home slot */
+	while (MHT_HOME(key, ht.mht_mask) != MHT_HOME(0, ht.mht_mask))
+	    ++key;
+	items[i].mhi_key = key++;
+	assert(mf_hash_add_item(&ht, &items[i])
+				   == (i < MHT_INIT_SIZE - 1 ? OK : FAIL));
+    }
+    assert(ht.mht_slots == ht.mht_small_slots);
+    assert(ht.mht_count == MHT_INIT_SIZE - 1);
+
+    /* removing from the middle of the cluster keeps the rest reachable */
+    for (i = 1; i < MHT_INIT_SIZE - 1; i += 2)
+	mf_hash_rem_item(&ht, &items[i]);
+    for (j = 0; j < MHT_INIT_SIZE - 1; j++)
+	assert(mf_hash_find(&ht, items[j].mhi_key)
+					    == (j % 2 == 1 ? NULL : &items[j]));
+    for (i = 0; i < MHT_INIT_SIZE - 1; i += 2)
+	mf_hash_rem_item(&ht, &items[i]);
+    assert(ht.mht_count == 0);
+    for (j = 0; j <= ht.mht_mask; j++)
+	assert(ht.mht_slots[j].mhs_item == NULL);
+
+    mf_hash_free(&ht);
+}
+
+/*
+ * Test getting and putting blocks with a swap file when only a few of them fit
+ * in memory, so that they are released all the time.  This doubles as a
+ * benchmark: the time taken is reported.
+ */
+    static void
+test_mf_clock()
+{
+    memfile_T	*mfp;
+    bhdr_T	*hp;
+    blocknr_T	nrs[BENCH_BLOCKS];
+    long	i;
+    long	round;
+    long	calls = 0;
+    clock_t	start;
+#ifdef FEAT_CRYPT
+    buf_T	buf;
+#endif
+
+    p_mm = 256;		/* Kbyte, keeps 64 blocks of 4096 bytes */
+    p_mmt = 1000000L;
+    mch_remove((char_u *)"Xmftest");
+    mfp = mf_open(vim_strsave((char_u *)"Xmftest"),
+					       O_RDWR | O_CREAT | O_EXCL);
+    assert(mfp != NULL);
+#ifdef FEAT_CRYPT
+    vim_memset(&buf, 0, sizeof(buf));
+    buf.b_p_key = (char_u *)"";
+    mfp->mf_buffer = &buf;
+#endif
+    start = clock();
+
+    for (i = 0; i < BENCH_BLOCKS; ++i)
+    {
+	hp = mf_new(mfp, FALSE, 1);
+	assert(hp != NULL);
+	nrs[i] = hp->bh_bnum;
+	*(long *)hp->bh_data = i;
+	mf_put(mfp, hp, TRUE, FALSE);
+	++calls;
+	assert(mfp->mf_used_count <= mfp->mf_used_count_max);
+    }
+
+    /* Scan all blocks while using a few all the time. */
+    for (round = 0; round < BENCH_ROUNDS; ++round)
+	for (i = 0; i < BENCH_BLOCKS; ++i)
+	{
+	    hp = mf_get(mfp, nrs[i], 1);
+	    assert(hp != NULL && *(long *)hp->bh_data == i);
+	    mf_put(mfp, hp, i % 7 == 0, FALSE);
+
+	    hp = mf_get(mfp, nrs[i % BENCH_HOT], 1);
+	    assert(hp != NULL && *(long *)hp->bh_data == i % BENCH_HOT);
+	    mf_put(mfp, hp, FALSE, FALSE);
+	    calls += 2;
+	    assert(mfp->mf_used_count <= mfp->mf_used_count_max);
+	}
+
+    /* the blocks used all the time were never released */
+    for (i = 0; i < BENCH_HOT; ++i)
+	assert(mf_find_hash(mfp, nrs[i]) != NULL);
+    printf("memfile: %ld mf_get()/mf_new() calls in %ld msec\n", calls,
+		 (long)((clock() - start) * 1000 / CLOCKS_PER_SEC));
+
+    /* Only use blocks that stay in memory. */
+    start = clock();
+    for (i = 0; i < BENCH_HITS; ++i)
+    {
+	hp = mf_get(mfp, nrs[i % BENCH_HOT], 1);
+	assert(hp != NULL);
+	mf_put(mfp, hp, FALSE, FALSE);
+    }
+    printf("memfile: %ld mf_get() hits in %ld msec\n", BENCH_HITS,
+		 (long)((clock() - start) * 1000 / CLOCKS_PER_SEC));
+
+    assert(mf_sync(mfp, MFS_ALL) == OK);
+    assert(mf_release_all() == FALSE);	/* no buffers */
+
+    mf_close(mfp, TRUE);
+    assert(total_mem_used == 0);
+}
+
+/*
+ * Test writing the blocks marked by mf_sync_start() in slices.
+ */
+    static void
+test_mf_sync_slice()
+{
+    memfile_T	*mfp;
+    bhdr_T	*hp;
+    bhdr_T	*late;
+    long	i;
+    long	calls;
+
+    p_mm = 4096;	/* Kbyte, everything stays in memory */
+    p_mmt = 1000000L;
+    mch_remove((char_u *)"Xmftest");
+    mfp = mf_open(vim_strsave((char_u *)"Xmftest"),
+					       O_RDWR | O_CREAT | O_EXCL);
+    assert(mfp != NULL);
+
+    for (i = 0; i < 100; ++i)
+    {
+	hp = mf_new(mfp, FALSE, 1);
+	assert(hp != NULL);
+	mf_put(mfp, hp, TRUE, FALSE);
+    }
+    mf_sync_start(mfp);
+    assert(mfp->mf_sync_todo);
+
+    /* a block changed later is not written */
+    late = mf_new(mfp, FALSE, 1);
+    assert(late != NULL);
+    mf_put(mfp, late, TRUE, FALSE);
+
+    for (calls = 0; mfp->mf_sync_todo; ++calls)
+	assert(mf_sync(mfp, MFS_SLICE) == OK);
+    assert(calls == (100 + MF_SYNC_SLICE - 1) / MF_SYNC_SLICE);
+    assert(mfp->mf_dirty);
+    assert(mfp->mf_infile_count == 100);
+
+    hp = mfp->mf_used_hand;
+    do
+    {
+	assert(((hp->bh_flags & BH_DIRTY) != 0) == (hp == late));
+	assert(!(hp->bh_flags & BH_SYNC));
+	hp = hp->bh_next;
+    } while (hp != mfp->mf_used_hand);
+
+    /* a full sync also finishes a started one */
+    mf_sync_start(mfp);
+    assert(mfp->mf_sync_todo);
+    assert(mf_sync(mfp, 0) == OK);
+    assert(!mfp->mf_sync_todo && !mfp->mf_dirty);
+    assert(!(late->bh_flags & (BH_DIRTY | BH_SYNC)));
+
+    mf_close(mfp, TRUE);
+}
+
     int
 main()
 {
     test_mf_hash();
+    test_mf_hash_collide();
+    test_mf_clock();
+    test_mf_sync_slice();
     return 0;
 }
@@ -210,6 +210,10 @@ struct block0
 
 #define STACK_INCR	5	/* nr of entries added to ml_stack at a time */
 
+#define ML_LAZY_STEP	32	/* remember the offset of every 32nd line */
+#define ML_LAZY_READSIZE 8192	/* nr of bytes read at a time for ml_lazy */
+#define ML_ROOM_DIV	16	/* keep 1/16 of a data block free for ml_lazy */
+
 /*
  * The line number where the first mark may be is remembered.
  * If it is 0 there are no marks at all.
@@ -218,6 +222,12 @@ struct block0
  */
 static linenr_T	lowest_marked = 0;
 
+/*
+ * TRUE when ml_sync_start() marked blocks that ml_sync_slice() still has to
+ * write.
+ */
+static int	ml_sync_todo = FALSE;
+
 /*
  * arguments for ml_find_line()
  */
@@ -254,8 +264,11 @@ static void ml_flush_line __ARGS((buf_T *));
 static bhdr_T *ml_new_data __ARGS((memfile_T *, int, int));
 static bhdr_T *ml_new_ptr __ARGS((memfile_T *));
 static bhdr_T *ml_find_line __ARGS((buf_T *, linenr_T, int));
+static bhdr_T *ml_cache_find __ARGS((buf_T *, linenr_T));
+static void ml_cache_add __ARGS((buf_T *, bhdr_T *, linenr_T, linenr_T));
 static int ml_add_stack __ARGS((buf_T *));
 static void ml_lineadd __ARGS((buf_T *, int));
+static bhdr_T *ml_lazy_reload __ARGS((buf_T *buf, blocknr_T bnum, int page_count, linenr_T old_lnum, linenr_T line_count));
 static int b0_magic_wrong __ARGS((ZERO_BL *));
 #ifdef CHECK_INODE
 static int fnamecmp_ino __ARGS((char_u *, char_u *, long));
@@ -269,6 +282,10 @@ static char_u *make_percent_swname __ARGS((char_u *dir, char_u *name));
 static cryptstate_T *ml_crypt_prepare __ARGS((memfile_T *mfp, off_t offset, int reading));
 #endif
 #ifdef FEAT_BYTEOFF
+static void ml_chunktree_clear __ARGS((buf_T *buf));
+static int ml_chunktree_build __ARGS((buf_T *buf));
+static void ml_chunktree_add __ARGS((buf_T *buf, int idx, int lines, long size));
+static int ml_chunktree_find __ARGS((buf_T *buf, linenr_T lnum, long offset, int ffdos, linenr_T *linep, long *sizep));
 static void ml_updatechunk __ARGS((buf_T *buf, long line, long len, int updtype));
 #endif
 
@@ -295,9 +312,16 @@ ml_open(buf)
     buf->b_ml.ml_stack_top = 0;	/* nothing in the stack */
     buf->b_ml.ml_locked = NULL;	/* no cached block */
     buf->b_ml.ml_line_lnum = 0;	/* no cached line */
+    buf->b_ml.ml_cache_len = 0;	/* no recently used blocks */
+    buf->b_ml.ml_stat_line = 0;
+    buf->b_ml.ml_stat_locked = 0;
+    buf->b_ml.ml_stat_cache = 0;
+    buf->b_ml.ml_stat_walk = 0;
 #ifdef FEAT_BYTEOFF
     buf->b_ml.ml_chunksize = NULL;
+    buf->b_ml.ml_chunktree = NULL;
 #endif
+    buf->b_ml.ml_lazy = NULL;	/* text can't be read back from a file */
 
     if (cmdmod.noswapfile)
 	buf->b_p_swf = FALSE;
@@ -849,7 +873,9 @@ ml_close(buf, del_file)
 #ifdef FEAT_BYTEOFF
     vim_free(buf->b_ml.ml_chunksize);
     buf->b_ml.ml_chunksize = NULL;
+    ml_chunktree_clear(buf);
 #endif
+    ml_lazy_free(buf);
     buf->b_ml.ml_mfp = NULL;
 
     /* Reset the "recovered" flag, give the ATTENTION prompt the next time
@@ -1212,6 +1238,7 @@ ml_recover()
     buf->b_ml.ml_stack_top = 0;		/* nothing in the stack */
     buf->b_ml.ml_line_lnum = 0;		/* no cached line */
     buf->b_ml.ml_locked = NULL;		/* no locked block */
+    buf->b_ml.ml_cache_len = 0;		/* no recently used blocks */
     buf->b_ml.ml_flags = 0;
 #ifdef FEAT_CRYPT
     buf->b_p_key = empty_option;
@@ -2319,6 +2346,58 @@ ml_sync_all(check_file, check_char)
     }
 }
 
+/*
+ * Start syncing all memlines without waiting for it: the dirty blocks are
+ * marked and then written by ml_sync_slice() a few at a time.
+ */
+    void
+ml_sync_start()
+{
+    buf_T	*buf;
+
+    for (buf = firstbuf; buf != NULL; buf = buf->b_next)
+    {
+	if (buf->b_ml.ml_mfp == NULL || buf->b_ml.ml_mfp->mf_fname == NULL)
+	    continue;			    /* no file */
+
+	ml_flush_line(buf);		    /* flush buffered line */
+					    /* flush locked block */
+	(void)ml_find_line(buf, (linenr_T)0, ML_FLUSH);
+	if (buf->b_ml.ml_mfp->mf_dirty)
+	{
+	    mf_sync_start(buf->b_ml.ml_mfp);
+	    if (buf->b_ml.ml_mfp->mf_sync_todo)
+		ml_sync_todo = TRUE;
+	}
+    }
+}
+
+/*
+ * Write a few of the blocks marked by ml_sync_start(), fewer when a character
+ * is available.  Called for every typed character, so that writing the swap
+ * files is spread out instead of causing a noticeable delay.  The swap file
+ * is flushed after the last block was written.
+ */
+    void
+ml_sync_slice()
+{
+    buf_T	*buf;
+
+    if (!ml_sync_todo)
+	return;
+    for (buf = firstbuf; buf != NULL; buf = buf->b_next)
+	if (buf->b_ml.ml_mfp != NULL && buf->b_ml.ml_mfp->mf_sync_todo)
+	{
+	    /* The locked block may be marked, it must be complete. */
+	    ml_flush_line(buf);
+	    (void)ml_find_line(buf, (linenr_T)0, ML_FLUSH);
+	    (void)mf_sync(buf->b_ml.ml_mfp, MFS_SLICE | MFS_STOP
+					| (bufIsChanged(buf) ? MFS_FLUSH : 0));
+	    return;
+	}
+    ml_sync_todo = FALSE;
+}
+
 /*
  * sync one buffer, including negative blocks
  *
@@ -2353,7 +2432,12 @@ ml_preserve(buf, message)
 
     ml_flush_line(buf);				    /* flush buffered line */
     (void)ml_find_line(buf, (linenr_T)0, ML_FLUSH); /* flush locked block */
-    status = mf_sync(mfp, MFS_ALL | MFS_FLUSH);
+
+    /* Text that is read back from the original file must go into the swap
+     * file now. */
+    status = ml_lazy_detach(buf);
+    if (mf_sync(mfp, MFS_ALL | MFS_FLUSH) == FAIL)
+	status = FAIL;
 
     /* stack is invalid after mf_sync(.., MFS_ALL) */
     buf->b_ml.ml_stack_top = 0;
@@ -2523,8 +2607,16 @@ errorret:
 	buf->b_ml.ml_line_lnum = lnum;
 	buf->b_ml.ml_flags &= ~ML_LINE_DIRTY;
     }
+    else
+	++buf->b_ml.ml_stat_line;
     if (will_change)
+    {
 	buf->b_ml.ml_flags |= (ML_LOCKED_DIRTY | ML_LOCKED_POS);
+#ifdef FEAT_SEARCH_EXTRA
+	/* The line is changed in place, without ml_replace(). */
+	sidx_changed(buf, lnum, lnum + 1, 0L);
+#endif
+    }
 
     return buf->b_ml.ml_line_ptr;
 }
@@ -2603,6 +2695,7 @@ ml_append_int(buf, lnum, line, len, newfile, mark)
     int		offset;
     int		from, to;
     int		space_needed;	/* space needed for new line */
+    int		room = 0;	/* space to keep free in data block */
     int		page_size;
     int		page_count;
     int		db_idx;		/* index for lnum in data block */
@@ -2618,6 +2711,9 @@ ml_append_int(buf, lnum, line, len, newfile, mark)
 
     if (lowest_marked && lowest_marked > lnum)
 	lowest_marked = lnum + 1;
+#ifdef FEAT_SEARCH_EXTRA
+    sidx_changed(buf, lnum + 1, lnum + 1, 1L);
+#endif
 
     if (len == 0)
 	len = (colnr_T)STRLEN(line) + 1;	/* space needed for the text */
@@ -2626,6 +2722,13 @@ ml_append_int(buf, lnum, line, len, newfile, mark)
     mfp = buf->b_ml.ml_mfp;
     page_size = mfp->mf_page_size;
 
+    /*
+     * When reading a large file for 'largefile' leave some room in each data
+     * block, so that lines can become longer without splitting the block.
+     */
+    if (newfile && (buf->b_ml.ml_flags & ML_LAZY_LOAD))
+	room = page_size / ML_ROOM_DIV;
+
 /*
  * find the data block containing the previous line
  * This also fills the stack with the blocks from the root to the data block
@@ -2653,7 +2756,7 @@ ml_append_int(buf, lnum, line, len, newfile, mark)
  * - not appending to the last line in the file
  * insert in front of the next block.
  */
-    if ((int)dp->db_free < space_needed && db_idx == line_count - 1
+    if ((int)dp->db_free < space_needed + room && db_idx == line_count - 1
 					    && lnum < buf->b_ml.ml_line_count)
     {
 	/*
@@ -2676,7 +2779,7 @@ ml_append_int(buf, lnum, line, len, newfile, mark)
 
     ++buf->b_ml.ml_line_count;
 
-    if ((int)dp->db_free >= space_needed)	/* enough room in data block */
+    if ((int)dp->db_free >= space_needed + room) /* enough room in data block */
     {
 /*
  * Insert new line in existing data block, or in data block allocated above.
@@ -2909,6 +3012,10 @@ ml_append_int(buf, lnum, line, len, newfile, mark)
 	 */
 	lineadd = buf->b_ml.ml_locked_lineadd;
 	buf->b_ml.ml_locked_lineadd = 0;
+	if ((buf->b_ml.ml_flags & ML_LAZY_LOAD) && db_idx >= 0)
+	    /* the old block no longer contains the last line */
+	    buf->b_ml.ml_locked_high = buf->b_ml.ml_locked_low
+							 + line_count_left - 1;
 	ml_find_line(buf, (linenr_T)0, ML_FLUSH);   /* flush data block */
 
 	/*
@@ -3113,6 +3220,9 @@ ml_replace(lnum, line, copy)
 
     if (copy && (line = vim_strsave(line)) == NULL) /* allocate memory */
 	return FAIL;
+#ifdef FEAT_SEARCH_EXTRA
+    sidx_changed(curbuf, lnum, lnum + 1, 0L);
+#endif
 #ifdef FEAT_NETBEANS_INTG
     if (netbeans_active())
     {
@@ -3172,6 +3282,9 @@ ml_delete_int(buf, lnum, message)
 
     if (lowest_marked && lowest_marked > lnum)
 	lowest_marked--;
+#ifdef FEAT_SEARCH_EXTRA
+    sidx_changed(buf, lnum, lnum + 1, -1L);
+#endif
 
 /*
  * If the file becomes empty the last line is replaced by an empty line.
@@ -3606,6 +3719,7 @@ ml_find_line(buf, lnum, action)
     blocknr_T	bnum, bnum2;
     int		dirty;
     linenr_T	low, high;
+    linenr_T	old_lnum = 0;
     int		top;
     int		page_count;
     int		idx;
@@ -3619,12 +3733,17 @@ ml_find_line(buf, lnum, action)
      * Don't do this for ML_FLUSH, because we want to flush the locked block.
      * Don't do this when 'swapfile' is reset, we want to load all the blocks.
      */
+    if (action == ML_INSERT || action == ML_DELETE)
+	buf->b_ml.ml_cache_len = 0;	/* line numbers are going to change */
+
     if (buf->b_ml.ml_locked)
     {
 	if (ML_SIMPLE(action)
 		&& buf->b_ml.ml_locked_low <= lnum
 		&& buf->b_ml.ml_locked_high >= lnum
-		&& !mf_dont_release)
+		&& !mf_dont_release
+		&& (action == ML_FIND
+			     || !(buf->b_ml.ml_flags & ML_LOCKED_NOSTACK)))
 	{
 	    /* remember to update pointer blocks and stack later */
 	    if (action == ML_INSERT)
@@ -3637,9 +3756,26 @@ ml_find_line(buf, lnum, action)
 		--(buf->b_ml.ml_locked_lineadd);
 		--(buf->b_ml.ml_locked_high);
 	    }
+	    else
+		++buf->b_ml.ml_stat_locked;
 	    return (buf->b_ml.ml_locked);
 	}
 
+	/*
+	 * While reading a file for ml_lazy a data block with a negative
+	 * number that doesn't contain the last line only holds text from the
+	 * file.  It doesn't need to be written to the swap file, it can be
+	 * read back from the file.
+	 */
+	if ((buf->b_ml.ml_flags & (ML_LAZY_LOAD | ML_LOCKED_POS))
+								== ML_LAZY_LOAD
+		&& buf->b_ml.ml_locked->bh_bnum < 0
+		&& buf->b_ml.ml_locked_high < buf->b_ml.ml_line_count)
+	{
+	    buf->b_ml.ml_locked->bh_flags &= ~BH_DIRTY;
+	    buf->b_ml.ml_flags &= ~ML_LOCKED_DIRTY;
+	}
+
 	mf_put(mfp, buf->b_ml.ml_locked, buf->b_ml.ml_flags & ML_LOCKED_DIRTY,
 					    buf->b_ml.ml_flags & ML_LOCKED_POS);
 	buf->b_ml.ml_locked = NULL;
@@ -3655,6 +3791,20 @@ ml_find_line(buf, lnum, action)
     if (action == ML_FLUSH)	    /* nothing else to do */
 	return NULL;
 
+    /*
+     * Try the recently used data blocks.  This avoids walking the tree when
+     * lines in several places are used alternately, e.g. for redrawing and
+     * syntax highlighting.
+     */
+    if (action == ML_FIND && !mf_dont_release
+				  && (hp = ml_cache_find(buf, lnum)) != NULL)
+    {
+	++buf->b_ml.ml_stat_cache;
+	return hp;
+    }
+    if (action == ML_FIND)
+	++buf->b_ml.ml_stat_walk;
+
     bnum = 1;			    /* start at the root of the tree */
     page_count = 1;
     low = 1;
@@ -3685,7 +3835,12 @@ ml_find_line(buf, lnum, action)
  */
     for (;;)
     {
-	if ((hp = mf_get(mfp, bnum, page_count)) == NULL)
+	hp = mf_get(mfp, bnum, page_count);
+	if (hp == NULL && bnum < 0 && buf->b_ml.ml_lazy != NULL)
+	    /* released without writing, read the text back from the file */
+	    hp = ml_lazy_reload(buf, bnum, page_count, old_lnum,
+							       high - low + 1);
+	if (hp == NULL)
 	    goto error_noblock;
 
 	/*
@@ -3703,7 +3858,10 @@ ml_find_line(buf, lnum, action)
 	    buf->b_ml.ml_locked_low = low;
 	    buf->b_ml.ml_locked_high = high;
 	    buf->b_ml.ml_locked_lineadd = 0;
-	    buf->b_ml.ml_flags &= ~(ML_LOCKED_DIRTY | ML_LOCKED_POS);
+	    buf->b_ml.ml_flags &= ~(ML_LOCKED_DIRTY | ML_LOCKED_POS
+							| ML_LOCKED_NOSTACK);
+	    if (action == ML_FIND)
+		ml_cache_add(buf, hp, low, high);
 	    return hp;
 	}
 
@@ -3732,6 +3890,7 @@ ml_find_line(buf, lnum, action)
 		ip->ip_index = idx;
 		bnum = pp->pb_pointer[idx].pe_bnum;
 		page_count = pp->pb_pointer[idx].pe_page_count;
+		old_lnum = pp->pb_pointer[idx].pe_old_lnum;
 		high = low - 1;
 		low -= t;
 
@@ -3791,6 +3950,113 @@ error_noblock:
     return NULL;
 }
 
+/*
+ * Find line "lnum" in the cache of recently used data blocks.
+ * When found, lock the block and make it the most recently used one.
+ * Must only be called when there is no locked block.
+ * Returns NULL when not found.
+ */
+    static bhdr_T *
+ml_cache_find(buf, lnum)
+    buf_T	*buf;
+    linenr_T	lnum;
+{
+    mlcache_T	*cp = buf->b_ml.ml_cache;
+    mlcache_T	entry;
+    bhdr_T	*hp;
+    DATA_BL	*dp;
+    int		i;
+
+    for (i = 0; i < buf->b_ml.ml_cache_len; ++i)
+	if (cp[i].mlc_low <= lnum && cp[i].mlc_high >= lnum)
+	    break;
+    if (i == buf->b_ml.ml_cache_len)
+	return NULL;
+
+    entry = cp[i];
+    hp = mf_get(buf->b_ml.ml_mfp, entry.mlc_bnum, entry.mlc_page_count);
+    if (hp != NULL)
+    {
+	/* The block may have been changed into something else, e.g. when a
+	 * negative block number was changed into a positive one. */
+	dp = (DATA_BL *)(hp->bh_data);
+	if (dp->db_id != DATA_ID || dp->db_line_count
+				    != entry.mlc_high - entry.mlc_low + 1)
+	{
+	    mf_put(buf->b_ml.ml_mfp, hp, FALSE, FALSE);
+	    hp = NULL;
+	}
+    }
+    if (hp == NULL)
+    {
+	/* Not valid, remove the entry. */
+	--buf->b_ml.ml_cache_len;
+	mch_memmove(cp + i, cp + i + 1,
+		     (size_t)(buf->b_ml.ml_cache_len - i) * sizeof(mlcache_T));
+	return NULL;
+    }
+
+    /* Move the entry to the front. */
+    mch_memmove(cp + 1, cp, (size_t)i * sizeof(mlcache_T));
+    cp[0] = entry;
+
+    buf->b_ml.ml_locked = hp;
+    buf->b_ml.ml_locked_low = entry.mlc_low;
+    buf->b_ml.ml_locked_high = entry.mlc_high;
+    buf->b_ml.ml_locked_lineadd = 0;
+    buf->b_ml.ml_flags &= ~(ML_LOCKED_DIRTY | ML_LOCKED_POS);
+    /* The stack doesn't lead to this block, thus inserting or deleting a
+     * line must search the tree. */
+    buf->b_ml.ml_flags |= ML_LOCKED_NOSTACK;
+    return hp;
+}
+
+/*
+ * Add data block "hp" with lines "low" to "high" to the front of the cache of
+ * recently used data blocks.  The least recently used one is dropped.
+ */
+    static void
+ml_cache_add(buf, hp, low, high)
+    buf_T	*buf;
+    bhdr_T	*hp;
+    linenr_T	low;
+    linenr_T	high;
+{
+    mlcache_T	*cp = buf->b_ml.ml_cache;
+
+    if (buf->b_ml.ml_cache_len < ML_CACHE_SIZE)
+	++buf->b_ml.ml_cache_len;
+    mch_memmove(cp + 1, cp,
+		      (size_t)(buf->b_ml.ml_cache_len - 1) * sizeof(mlcache_T));
+    cp[0].mlc_bnum = hp->bh_bnum;
+    cp[0].mlc_page_count = hp->bh_page_count;
+    cp[0].mlc_low = low;
+    cp[0].mlc_high = high;
+}
+
+/*
+ * ":mlstat": show how lines in the current buffer were found.
+ * ":mlstat!": reset the counters.
+ */
+    void
+ex_mlstat(eap)
+    exarg_T	*eap;
+{
+    memline_T	*ml = &curbuf->b_ml;
+
+    if (eap->forceit)
+    {
+	ml->ml_stat_line = 0;
+	ml->ml_stat_locked = 0;
+	ml->ml_stat_cache = 0;
+	ml->ml_stat_walk = 0;
+	return;
+    }
+    smsg((char_u *)_("cached line: %ld  locked block: %ld  recent blocks: %ld  tree search: %ld"),
+	    ml->ml_stat_line, ml->ml_stat_locked, ml->ml_stat_cache,
+	    ml->ml_stat_walk);
+}
+
 /*
  * add an entry to the info pointer stack
  *
@@ -3864,6 +4130,324 @@ ml_lineadd(buf, count)
     }
 }
 
+/*
+ * Functions for reading back text from the original file, used for files
+ * that were read while 'largefile' applied.
+ *
+ * While reading the file the ML_LAZY_LOAD flag is set.  A data block that
+ * only contains text from the file is then not marked dirty when it is
+ * flushed, thus mf_release() can drop it without writing it to the swap file.
+ * The block keeps its negative number, so that on recovery the text is read
+ * from the original file, like for any other negative block.  When the block
+ * is needed again ml_find_line() calls ml_lazy_reload().
+ */
+
+/*
+ * Prepare for reading file descriptor "fd" into "buf" with 'largefile'.
+ * "fileformat" is EOL_UNIX or EOL_DOS.
+ * Returns FAIL when the file is too small or the text can't be read back.
+ */
+    int
+ml_lazy_start(buf, fd, fileformat)
+    buf_T	*buf;
+    int		fd;
+    int		fileformat;
+{
+    mllazy_T	*lz;
+    struct stat	st;
+
+    ml_lazy_free(buf);
+    if (p_lfs <= 0 || mch_fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)
+					   || st.st_size / 1024 < (off_t)p_lfs)
+	return FAIL;
+
+    lz = (mllazy_T *)alloc((unsigned)sizeof(mllazy_T));
+    if (lz == NULL)
+	return FAIL;
+    /* Use our own file descriptor, it's kept open after reading. */
+    lz->mlz_fd = dup(fd);
+    if (lz->mlz_fd < 0)
+    {
+	vim_free(lz);
+	return FAIL;
+    }
+#ifdef HAVE_FD_CLOEXEC
+    {
+	int fdflags = fcntl(lz->mlz_fd, F_GETFD);
+	if (fdflags >= 0 && (fdflags & FD_CLOEXEC) == 0)
+	    fcntl(lz->mlz_fd, F_SETFD, fdflags | FD_CLOEXEC);
+    }
+#endif
+    lz->mlz_size = st.st_size;
+    lz->mlz_mtime = st.st_mtime;
+    lz->mlz_fileformat = fileformat;
+    ga_init2(&lz->mlz_offsets, (int)sizeof(off_t), 1000);
+
+    buf->b_ml.ml_lazy = lz;
+    buf->b_ml.ml_flags |= ML_LAZY_LOAD;
+    return OK;
+}
+
+/*
+ * Remember that line "lnum" starts at byte "offset" in the file.  Must be
+ * called for every line that is read, before appending it.
+ * Returns FAIL when out of memory, the caller must call ml_lazy_done() then.
+ */
+    int
+ml_lazy_offset(buf, lnum, offset)
+    buf_T	*buf;
+    linenr_T	lnum;
+    off_t	offset;
+{
+    garray_T	*gap = &buf->b_ml.ml_lazy->mlz_offsets;
+
+    if ((lnum - 1) % ML_LAZY_STEP == 0)
+    {
+	if ((lnum - 1) / ML_LAZY_STEP != gap->ga_len || ga_grow(gap, 1) == FAIL)
+	    return FAIL;
+	((off_t *)gap->ga_data)[gap->ga_len++] = offset;
+    }
+    return OK;
+}
+
+/*
+ * Done reading a file for "buf": blocks that are flushed from now on are
+ * written to the swap file as usual.
+ */
+    void
+ml_lazy_done(buf)
+    buf_T	*buf;
+{
+    if (!(buf->b_ml.ml_flags & ML_LAZY_LOAD))
+	return;
+    buf->b_ml.ml_flags &= ~ML_LAZY_LOAD;
+    if (buf->b_ml.ml_lazy->mlz_offsets.ga_len == 0)
+	ml_lazy_free(buf);
+}
+
+/*
+ * Free the info for reading back text into "buf".
+ * Only to be used when there are no blocks that depend on it.
+ */
+    void
+ml_lazy_free(buf)
+    buf_T	*buf;
+{
+    mllazy_T	*lz = buf->b_ml.ml_lazy;
+
+    if (lz == NULL)
+	return;
+    close(lz->mlz_fd);
+    ga_clear(&lz->mlz_offsets);
+    vim_free(lz);
+    buf->b_ml.ml_lazy = NULL;
+    buf->b_ml.ml_flags &= ~ML_LAZY_LOAD;
+}
+
+/*
+ * Read back the text of data block "bnum" with "page_count" pages from the
+ * original file.  "old_lnum" is the line number of the first line in the
+ * file, the block has "line_count" lines.
+ * Returns the locked block, NULL when the file was changed or can't be read.
+ */
+    static bhdr_T *
+ml_lazy_reload(buf, bnum, page_count, old_lnum, line_count)
+    buf_T	*buf;
+    blocknr_T	bnum;
+    int		page_count;
+    linenr_T	old_lnum;
+    linenr_T	line_count;
+{
+    mllazy_T	*lz = buf->b_ml.ml_lazy;
+    memfile_T	*mfp = buf->b_ml.ml_mfp;
+    struct stat	st;
+    bhdr_T	*hp = NULL;
+    DATA_BL	*dp = NULL;
+    char_u	*iobuf = NULL;
+    char_u	*p;
+    char_u	*e;
+    garray_T	ga;
+    off_t	offset;
+    off_t	save_offset;
+    unsigned	size;
+    long	n = 0;
+    int		skip;
+    int		len;
+    int		i;
+    linenr_T	count = 0;
+    static int	did_msg = FALSE;
+
+    if (old_lnum <= 0
+	    || (old_lnum - 1) / ML_LAZY_STEP >= lz->mlz_offsets.ga_len)
+	return NULL;
+    if (mch_fstat(lz->mlz_fd, &st) < 0
+	    || st.st_size != lz->mlz_size
+	    || st.st_mtime != lz->mlz_mtime)
+    {
+	/* Only give the message once, it would be repeated for every
+	 * line that is redrawn. */
+	if (!did_msg)
+	    EMSG(_("E890: File was changed, cannot read back text"));
+	did_msg = TRUE;
+	return NULL;
+    }
+
+    offset = ((off_t *)lz->mlz_offsets.ga_data)[
+					       (old_lnum - 1) / ML_LAZY_STEP];
+    skip = (old_lnum - 1) % ML_LAZY_STEP;
+    size = mfp->mf_page_size * page_count;
+    dp = (DATA_BL *)alloc(size);
+    iobuf = alloc(ML_LAZY_READSIZE);
+    ga_init2(&ga, 1, 200);
+    save_offset = lseek(lz->mlz_fd, (off_t)0L, SEEK_CUR);
+    if (dp == NULL || iobuf == NULL
+		      || lseek(lz->mlz_fd, offset, SEEK_SET) != offset)
+	goto theend;
+
+    /* Same as what ml_new_data() does. */
+    dp->db_id = DATA_ID;
+    dp->db_txt_start = dp->db_txt_end = size;
+    dp->db_free = size - HEADER_SIZE;
+    dp->db_line_count = 0;
+
+    /*
+     * Split the text into lines the same way readfile() does: NULs become
+     * NLs and with "dos" format a CR before the NL is removed.  The last
+     * line in the file may be missing the NL.
+     */
+    while (count < line_count)
+    {
+	n = read_eintr(lz->mlz_fd, iobuf, ML_LAZY_READSIZE);
+	if (n < 0 || (n == 0 && ga.ga_len == 0))
+	    break;
+	p = iobuf;
+	while (count < line_count && (p < iobuf + n || n == 0))
+	{
+	    if (n == 0)
+		e = NULL;	/* end of file, line without a NL */
+	    else
+	    {
+		e = (char_u *)memchr(p, NL, (size_t)(iobuf + n - p));
+		len = (int)((e == NULL ? iobuf + n : e) - p);
+		if (skip == 0)
+		{
+		    if (ga_grow(&ga, len) == FAIL)
+			goto theend;
+		    mch_memmove((char_u *)ga.ga_data + ga.ga_len, p, len);
+		    ga.ga_len += len;
+		}
+		if (e == NULL)
+		    break;	/* need to read more */
+		p = e + 1;
+	    }
+	    if (skip > 0)
+	    {
+		--skip;
+		continue;
+	    }
+
+	    /* Got a complete line in "ga". */
+	    len = ga.ga_len;
+	    if (e != NULL && lz->mlz_fileformat == EOL_DOS && len > 0
+				  && ((char_u *)ga.ga_data)[len - 1] == CAR)
+		--len;
+	    if ((int)dp->db_free < len + 1 + (int)INDEX_SIZE)
+		goto theend;	/* doesn't fit, must have been changed */
+	    dp->db_txt_start -= len + 1;
+	    dp->db_free -= len + 1 + INDEX_SIZE;
+	    dp->db_index[count++] = dp->db_txt_start;
+	    for (i = 0; i < len; ++i)
+	    {
+		int c = ((char_u *)ga.ga_data)[i];
+
+		((char_u *)dp)[dp->db_txt_start + i] = c == NUL ? NL : c;
+	    }
+	    ((char_u *)dp)[dp->db_txt_start + len] = NUL;
+	    ga.ga_len = 0;
+	    if (n == 0)
+		break;
+	}
+	if (n == 0)
+	    break;
+    }
+
+    if (count == line_count
+	    && (hp = mf_get_released(mfp, bnum, page_count)) != NULL)
+    {
+	dp->db_line_count = count;
+	mch_memmove(hp->bh_data, dp, (size_t)size);
+    }
+
+theend:
+    if (save_offset >= 0)
+	(void)lseek(lz->mlz_fd, save_offset, SEEK_SET);
+    vim_free(dp);
+    vim_free(iobuf);
+    ga_clear(&ga);
+    return hp;
+}
+
+/*
+ * Make sure all text in "buf" is in memory or in the swap file, so that the
+ * original file is not needed anymore.  This reads all the text that was
+ * not changed.
+ * Returns FAIL when some text can't be read back.
+ */
+    int
+ml_lazy_detach(buf)
+    buf_T	*buf;
+{
+    bhdr_T	*hp;
+    linenr_T	lnum;
+
+    if (buf->b_ml.ml_lazy == NULL)
+	return OK;
+    ml_lazy_done(buf);
+
+    for (lnum = 1; lnum <= buf->b_ml.ml_line_count;
+					   lnum = buf->b_ml.ml_locked_high + 1)
+    {
+	if ((hp = ml_find_line(buf, lnum, ML_FIND)) == NULL)
+	    return FAIL;
+	/* A negative block that is not dirty must be written later. */
+	if (hp->bh_bnum < 0)
+	    buf->b_ml.ml_flags |= ML_LOCKED_DIRTY;
+    }
+    (void)ml_find_line(buf, (linenr_T)0, ML_FLUSH);
+
+    ml_lazy_free(buf);
+    return OK;
+}
+
+/*
+ * Called before writing file "fname": when the text of a buffer is read back
+ * from this file, read all of it now.
+ * Returns FAIL if that doesn't work.
+ */
+    int
+ml_lazy_before_write(fname)
+    char_u	*fname;
+{
+    buf_T	*buf;
+    struct stat	st;
+    struct stat	st_lazy;
+    int		retval = OK;
+
+    if (mch_stat((char *)fname, &st) < 0)
+	return OK;	/* new file */
+    for (buf = firstbuf; buf != NULL; buf = buf->b_next)
+	if (buf->b_ml.ml_lazy != NULL
+		&& mch_fstat(buf->b_ml.ml_lazy->mlz_fd, &st_lazy) >= 0
+		&& st.st_dev == st_lazy.st_dev
+		&& st.st_ino == st_lazy.st_ino)
+	{
+	    ml_flush_line(buf);
+	    if (ml_lazy_detach(buf) == FAIL)
+		retval = FAIL;
+	}
+    return retval;
+}
+
 #if defined(HAVE_READLINK) || defined(PROTO)
 /*
  * Resolve a symlink in the last component of a file name.
@@ -4816,9 +5400,9 @@ ml_setflags(buf)
     bhdr_T	*hp;
     ZERO_BL	*b0p;
 
-    if (!buf->b_ml.ml_mfp)
+    if (!buf->b_ml.ml_mfp || (hp = buf->b_ml.ml_mfp->mf_used_hand) == NULL)
 	return;
-    for (hp = buf->b_ml.ml_mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+    do
     {
 	if (hp->bh_bnum == 0)
 	{
@@ -4833,7 +5417,8 @@ ml_setflags(buf)
 	    mf_sync(buf->b_ml.ml_mfp, MFS_ZERO);
 	    break;
 	}
-    }
+	hp = hp->bh_next;
+    } while (hp != buf->b_ml.ml_mfp->mf_used_hand);
 }
 
 #if defined(FEAT_CRYPT) || defined(PROTO)
@@ -4967,6 +5552,125 @@ ml_crypt_prepare(mfp, offset, reading)
 #define MLCS_MAXL 800	/* max no of lines in chunk */
 #define MLCS_MINL 400   /* should be half of MLCS_MAXL */
 
+/*
+ * To find the chunk for a line or byte offset without going over all chunks
+ * a Fenwick tree is kept in ml_chunktree: entry "i" holds the sums of the
+ * (i & -i) chunks ending with ml_chunksize[i - 1].  A change in the size of
+ * a chunk updates it, when chunks are split, joined or added it is thrown
+ * away and rebuilt when needed.
+ */
+
+/*
+ * Throw away the Fenwick tree of buffer "buf".
+ */
+    static void
+ml_chunktree_clear(buf)
+    buf_T	*buf;
+{
+    vim_free(buf->b_ml.ml_chunktree);
+    buf->b_ml.ml_chunktree = NULL;
+}
+
+/*
+ * Build the Fenwick tree of buffer "buf" from ml_chunksize.
+ * Returns FAIL when out of memory.
+ */
+    static int
+ml_chunktree_build(buf)
+    buf_T	*buf;
+{
+    chunksize_T	*tree;
+    int		n = buf->b_ml.ml_usedchunks;
+    int		i, j;
+
+    tree = (chunksize_T *)alloc((unsigned)sizeof(chunksize_T) * (n + 1));
+    if (tree == NULL)
+	return FAIL;
+    for (i = 1; i <= n; ++i)
+	tree[i] = buf->b_ml.ml_chunksize[i - 1];
+    for (i = 1; i <= n; ++i)
+    {
+	j = i + (i & -i);
+	if (j <= n)
+	{
+	    tree[j].mlcs_numlines += tree[i].mlcs_numlines;
+	    tree[j].mlcs_totalsize += tree[i].mlcs_totalsize;
+	}
+    }
+    buf->b_ml.ml_chunktree = tree;
+    return OK;
+}
+
+/*
+ * Add "lines" and "size" to chunk "idx" in the Fenwick tree of buffer "buf",
+ * if there is one.
+ */
+    static void
+ml_chunktree_add(buf, idx, lines, size)
+    buf_T	*buf;
+    int		idx;
+    int		lines;
+    long	size;
+{
+    chunksize_T	*tree = buf->b_ml.ml_chunktree;
+    int		i;
+
+    if (tree == NULL)
+	return;
+    for (i = idx + 1; i <= buf->b_ml.ml_usedchunks; i += i & -i)
+    {
+	tree[i].mlcs_numlines += lines;
+	tree[i].mlcs_totalsize += size;
+    }
+}
+
+/*
+ * Find the chunk that contains line "lnum" or, when "lnum" is zero, byte
+ * "offset", counting one extra byte per line when "ffdos" is TRUE.  The
+ * last chunk is used when beyond the end.
+ * Returns the index of the chunk and sets "*linep" to its first line and
+ * "*sizep" to the number of bytes before it (including the extra bytes when
+ * "lnum" is zero).  Returns -1 when out of memory.
+ */
+    static int
+ml_chunktree_find(buf, lnum, offset, ffdos, linep, sizep)
+    buf_T	*buf;
+    linenr_T	lnum;
+    long	offset;
+    int		ffdos;
+    linenr_T	*linep;
+    long	*sizep;
+{
+    chunksize_T	*tree;
+    int		n = buf->b_ml.ml_usedchunks - 1;  /* never skip last chunk */
+    int		pos = 0;
+    int		step;
+    linenr_T	lines = 0;
+    long	size = 0;
+
+    if (buf->b_ml.ml_chunktree == NULL && ml_chunktree_build(buf) == FAIL)
+	return -1;
+    tree = buf->b_ml.ml_chunktree;
+
+    for (step = 1; step * 2 <= n; step *= 2)
+	;
+    for ( ; step > 0; step /= 2)
+	if (pos + step <= n
+		&& (lnum != 0
+		    ? lnum >= 1 + lines + tree[pos + step].mlcs_numlines
+		    : offset > size + tree[pos + step].mlcs_totalsize
+			+ ffdos * (lines + tree[pos + step].mlcs_numlines)))
+	{
+	    pos += step;
+	    lines += tree[pos].mlcs_numlines;
+	    size += tree[pos].mlcs_totalsize;
+	}
+
+    *linep = 1 + lines;
+    *sizep = lnum == 0 && ffdos ? size + lines : size;
+    return pos;
+}
+
 /*
  * Keep information for finding byte offset of a line, updtype may be one of:
  * ML_CHNK_ADDLINE: Add len to parent chunk, possibly splitting it
@@ -5009,6 +5713,7 @@ ml_updatechunk(buf, line, len, updtype)
 	buf->b_ml.ml_usedchunks = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_numlines = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_totalsize = 1;
+	ml_chunktree_clear(buf);
     }
 
     if (updtype == ML_CHNK_UPDLINE && buf->b_ml.ml_line_count == 1)
@@ -5020,6 +5725,7 @@ ml_updatechunk(buf, line, len, updtype)
 	buf->b_ml.ml_chunksize[0].mlcs_numlines = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_totalsize =
 				  (long)STRLEN(buf->b_ml.ml_line_ptr) + 1;
+	ml_chunktree_clear(buf);
 	return;
     }
 
@@ -5027,29 +5733,43 @@ ml_updatechunk(buf, line, len, updtype)
      * Find chunk that our line belongs to, curline will be at start of the
      * chunk.
      */
-    if (buf != ml_upd_lastbuf || line != ml_upd_lastline + 1
-	    || updtype != ML_CHNK_ADDLINE)
+    if (buf == ml_upd_lastbuf && curix < buf->b_ml.ml_usedchunks
+	    && (updtype == ML_CHNK_ADDLINE ? line == ml_upd_lastline + 1
+		: updtype == ML_CHNK_UPDLINE && line >= curline
+		    && line < curline
+			+ buf->b_ml.ml_chunksize[curix].mlcs_numlines
+			+ (curix < buf->b_ml.ml_usedchunks - 1
+			   ? buf->b_ml.ml_chunksize[curix + 1].mlcs_numlines
+			   : 0)))
     {
-	for (curline = 1, curix = 0;
-	     curix < buf->b_ml.ml_usedchunks - 1
-	     && line >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	     curix++)
+	/* Appending below the last line or changing a line in the same or
+	 * the next chunk, e.g. for ":s" on a range of lines. */
+	if (line >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines
+		 && curix < buf->b_ml.ml_usedchunks - 1)
 	{
+	    /* Adjust cached curix & curline */
 	    curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
+	    curix++;
 	}
     }
-    else if (line >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines
-		 && curix < buf->b_ml.ml_usedchunks - 1)
+    else
     {
-	/* Adjust cached curix & curline */
-	curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	curix++;
+	curix = ml_chunktree_find(buf, (linenr_T)line, 0L, FALSE,
+							       &curline, &size);
+	if (curix < 0)
+	{
+	    buf->b_ml.ml_usedchunks = -1;
+	    return;
+	}
     }
     curchnk = buf->b_ml.ml_chunksize + curix;
 
     if (updtype == ML_CHNK_DELLINE)
 	len = -len;
     curchnk->mlcs_totalsize += len;
+    /* the line count is changed below */
+    ml_chunktree_add(buf, curix, updtype == ML_CHNK_ADDLINE ? 1
+				 : updtype == ML_CHNK_DELLINE ? -1 : 0, len);
     if (updtype == ML_CHNK_ADDLINE)
     {
 	curchnk->mlcs_numlines++;
@@ -5065,6 +5785,7 @@ ml_updatechunk(buf, line, len, updtype)
 	    {
 		/* Hmmmm, Give up on offset for this buffer */
 		buf->b_ml.ml_usedchunks = -1;
+		ml_chunktree_clear(buf);
 		return;
 	    }
 	}
@@ -5076,6 +5797,7 @@ ml_updatechunk(buf, line, len, updtype)
 	    int	    text_end;
 	    int	    linecnt;
 
+	    ml_chunktree_clear(buf);
 	    mch_memmove(buf->b_ml.ml_chunksize + curix + 1,
 			buf->b_ml.ml_chunksize + curix,
 			(buf->b_ml.ml_usedchunks - curix) *
@@ -5132,6 +5854,7 @@ ml_updatechunk(buf, line, len, updtype)
 	     */
 	    curchnk = buf->b_ml.ml_chunksize + curix + 1;
 	    buf->b_ml.ml_usedchunks++;
+	    ml_chunktree_clear(buf);
 	    if (line == buf->b_ml.ml_line_count)
 	    {
 		curchnk->mlcs_numlines = 0;
@@ -5176,6 +5899,7 @@ ml_updatechunk(buf, line, len, updtype)
 	}
 	else if (curix == 0 && curchnk->mlcs_numlines <= 0)
 	{
+	    ml_chunktree_clear(buf);
 	    buf->b_ml.ml_usedchunks--;
 	    mch_memmove(buf->b_ml.ml_chunksize, buf->b_ml.ml_chunksize + 1,
 			buf->b_ml.ml_usedchunks * sizeof(chunksize_T));
@@ -5189,6 +5913,7 @@ ml_updatechunk(buf, line, len, updtype)
 	}
 
 	/* Collapse chunks */
+	ml_chunktree_clear(buf);
 	curchnk[-1].mlcs_numlines += curchnk->mlcs_numlines;
 	curchnk[-1].mlcs_totalsize += curchnk->mlcs_totalsize;
 	buf->b_ml.ml_usedchunks--;
@@ -5220,7 +5945,6 @@ ml_find_line_or_offset(buf, lnum, offp)
     long	*offp;
 {
     linenr_T	curline;
-    int		curix;
     long	size;
     bhdr_T	*hp;
     DATA_BL	*dp;
@@ -5248,24 +5972,11 @@ ml_find_line_or_offset(buf, lnum, offp)
     if (lnum == 0 && offset <= 0)
 	return 1;   /* Not a "find offset" and offset 0 _must_ be in line 1 */
     /*
-     * Find the last chunk before the one containing our line. Last chunk is
-     * special because it will never qualify
+     * Find the chunk containing our line or offset. Last chunk is special
+     * because it will never be skipped.
      */
-    curline = 1;
-    curix = size = 0;
-    while (curix < buf->b_ml.ml_usedchunks - 1
-	    && ((lnum != 0
-	     && lnum >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines)
-		|| (offset != 0
-	       && offset > size + buf->b_ml.ml_chunksize[curix].mlcs_totalsize
-		      + ffdos * buf->b_ml.ml_chunksize[curix].mlcs_numlines)))
-    {
-	curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	size += buf->b_ml.ml_chunksize[curix].mlcs_totalsize;
-	if (offset && ffdos)
-	    size += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	curix++;
-    }
+    if (ml_chunktree_find(buf, lnum, offset, ffdos, &curline, &size) < 0)
+	return -1;
 
     while ((lnum != 0 && curline < lnum) || (offset != 0 && size < offset))
     {
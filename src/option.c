@@ -1731,6 +1731,9 @@ static struct vimoption
 			    (char_u *)NULL, PV_NONE,
 #endif
 			    {(char_u *)FALSE, (char_u *)0L} SCRIPTID_INIT},
+    {"largefile",   "lfs",  P_NUM|P_VI_DEF,
+			    (char_u *)&p_lfs, PV_NONE,
+			    {(char_u *)0L, (char_u *)0L} SCRIPTID_INIT},
     {"laststatus",  "ls",   P_NUM|P_VI_DEF|P_RALL,
 #ifdef FEAT_WINDOWS
 			    (char_u *)&p_ls, PV_NONE,
@@ -2562,6 +2565,13 @@ static struct vimoption
 			    {(char_u *)0L, (char_u *)0L}
 #endif
 			    SCRIPTID_INIT},
+    {"synstatefile", "ssf", P_BOOL|P_VI_DEF,
+#if defined(FEAT_SYN_HL) && defined(FEAT_PERSISTENT_UNDO)
+			    (char_u *)&p_ssf, PV_NONE,
+#else
+			    (char_u *)NULL, PV_NONE,
+#endif
+			    {(char_u *)FALSE, (char_u *)0L} SCRIPTID_INIT},
     {"syntax",	    "syn",  P_STRING|P_ALLOCED|P_VI_DEF|P_NOGLOB|P_NFNAME,
 #ifdef FEAT_SYN_HL
 			    (char_u *)&p_syn, PV_SYN,
@@ -2571,6 +2581,13 @@ static struct vimoption
 			    {(char_u *)0L, (char_u *)0L}
 #endif
 			    SCRIPTID_INIT},
+    {"syntaxahead", "sya",  P_NUM|P_VI_DEF,
+#if defined(FEAT_SYN_HL) && defined(FEAT_RELTIME)
+			    (char_u *)&p_sya, PV_NONE,
+#else
+			    (char_u *)NULL, PV_NONE,
+#endif
+			    {(char_u *)0L, (char_u *)0L} SCRIPTID_INIT},
     {"tabline",	    "tal",  P_STRING|P_VI_DEF|P_RALL,
 #ifdef FEAT_STL_OPT
 			    (char_u *)&p_tal, PV_NONE,
@@ -8791,6 +8808,13 @@ set_num_option(opt_idx, varp, value, errbuf, errbuflen, opt_flags)
 	errmsg = e_positive;
 	p_tm = 0;
     }
+#if defined(FEAT_SYN_HL) && defined(FEAT_RELTIME)
+    if (p_sya < 0)
+    {
+	errmsg = e_positive;
+	p_sya = 0;
+    }
+#endif
     if ((curwin->w_p_scr <= 0
 		|| (curwin->w_p_scr > curwin->w_height
 		    && curwin->w_height > 0))
@@ -8819,7 +8843,7 @@ set_num_option(opt_idx, varp, value, errbuf, errbuflen, opt_flags)
 	errmsg = e_invarg;
 	p_hi = 10000;
     }
-    if (p_re < 0 || p_re > 2)
+    if (p_re < 0 || p_re > 3)
     {
 	errmsg = e_invarg;
 	p_re = 0;
@@ -8829,6 +8853,11 @@ set_num_option(opt_idx, varp, value, errbuf, errbuflen, opt_flags)
 	errmsg = e_positive;
 	p_report = 1;
     }
+    if (p_lfs < 0)
+    {
+	errmsg = e_positive;
+	p_lfs = 0;
+    }
     if ((p_sj < -100 || p_sj >= Rows) && full_screen)
     {
 	if (Rows != old_Rows)	/* Rows changed, just adjust p_sj */
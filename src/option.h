@@ -603,6 +603,7 @@ EXTERN char_u	*p_lispwords;	/* 'lispwords' */
 EXTERN long	p_ls;		/* 'laststatus' */
 EXTERN long	p_stal;		/* 'showtabline' */
 #endif
+EXTERN long	p_lfs;		/* 'largefile' */
 EXTERN char_u	*p_lcs;		/* 'listchars' */
 
 EXTERN int	p_lz;		/* 'lazyredraw' */
@@ -783,6 +784,12 @@ static char *(p_swb_values[]) = {"useopen", "usetab", "split", "newtab", NULL};
 #define SWB_USETAB		0x002
 #define SWB_SPLIT		0x004
 #define SWB_NEWTAB		0x008
+#if defined(FEAT_SYN_HL) && defined(FEAT_PERSISTENT_UNDO)
+EXTERN int	p_ssf;		/* 'synstatefile' */
+#endif
+#if defined(FEAT_SYN_HL) && defined(FEAT_RELTIME)
+EXTERN long	p_sya;		/* 'syntaxahead' */
+#endif
 EXTERN int	p_tbs;		/* 'tagbsearch' */
 EXTERN long	p_tl;		/* 'taglength' */
 EXTERN int	p_tr;		/* 'tagrelative' */
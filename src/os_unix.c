@@ -4007,6 +4007,10 @@ wait4pid(child, status)
 # endif
 	if (wait_pid == 0)
 	{
+# ifdef FEAT_QUICKFIX
+	    /* Parse the errorfile of ":make" while it is being written. */
+	    qf_stream_poll();
+# endif
 	    /* Wait for 10 msec before trying again. */
 	    mch_delay(10L, TRUE);
 	    continue;
@@ -4977,6 +4981,11 @@ mch_call_shell(cmd, options)
 		    else
 			wait_pid = 0;
 
+# ifdef FEAT_QUICKFIX
+		    /* Parse the errorfile of ":make" while it is being
+		     * written. */
+		    qf_stream_poll();
+# endif
 # if defined(FEAT_XCLIPBOARD) && defined(FEAT_X11)
 		    /* Handle any X events, e.g. serving the clipboard. */
 		    clip_update();
@@ -5041,6 +5050,11 @@ finished:
 
 		    /* Handle any X events, e.g. serving the clipboard. */
 		    clip_update();
+#  ifdef FEAT_QUICKFIX
+		    /* Parse the errorfile of ":make" while it is being
+		     * written. */
+		    qf_stream_poll();
+#  endif
 
 		    mch_delay(10L, TRUE);
 		}
@@ -49,11 +49,13 @@ int has_textchangedI __ARGS((void));
 int has_insertcharpre __ARGS((void));
 int has_cmdundefined __ARGS((void));
 int has_funcundefined __ARGS((void));
+int has_filetype_autocmd __ARGS((void));
 void block_autocmds __ARGS((void));
 void unblock_autocmds __ARGS((void));
 int is_autocmd_blocked __ARGS((void));
 char_u *getnextac __ARGS((int c, void *cookie, int indent));
 int has_autocmd __ARGS((event_T event, char_u *sfname, buf_T *buf));
+int has_autocmd_except __ARGS((event_T event, char_u *sfname, buf_T *buf, char_u *group_name));
 char_u *get_augroup_name __ARGS((expand_T *xp, int idx));
 char_u *set_context_in_autocmd __ARGS((expand_T *xp, char_u *arg, int doautocmd));
 char_u *get_event_name __ARGS((expand_T *xp, int idx));
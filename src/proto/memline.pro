@@ -12,6 +12,8 @@ void ml_timestamp __ARGS((buf_T *buf));
 void ml_recover __ARGS((void));
 int recover_names __ARGS((char_u *fname, int list, int nr, char_u **fname_out));
 void ml_sync_all __ARGS((int check_file, int check_char));
+void ml_sync_start __ARGS((void));
+void ml_sync_slice __ARGS((void));
 void ml_preserve __ARGS((buf_T *buf, int message));
 char_u *ml_get __ARGS((linenr_T lnum));
 char_u *ml_get_pos __ARGS((pos_T *pos));
@@ -26,6 +28,13 @@ int ml_delete __ARGS((linenr_T lnum, int message));
 void ml_setmarked __ARGS((linenr_T lnum));
 linenr_T ml_firstmarked __ARGS((void));
 void ml_clearmarked __ARGS((void));
+void ex_mlstat __ARGS((exarg_T *eap));
+int ml_lazy_start __ARGS((buf_T *buf, int fd, int fileformat));
+int ml_lazy_offset __ARGS((buf_T *buf, linenr_T lnum, off_t offset));
+void ml_lazy_done __ARGS((buf_T *buf));
+void ml_lazy_free __ARGS((buf_T *buf));
+int ml_lazy_detach __ARGS((buf_T *buf));
+int ml_lazy_before_write __ARGS((char_u *fname));
 int resolve_symlink __ARGS((char_u *fname, char_u *buf));
 char_u *makeswapname __ARGS((char_u *fname, char_u *ffname, buf_T *buf, char_u *dir_name));
 char_u *get_file_in_dir __ARGS((char_u *fname, char_u *dname));
@@ -1,6 +1,8 @@
 /* regexp.c */
 int re_multiline __ARGS((regprog_T *prog));
 int re_lookbehind __ARGS((regprog_T *prog));
+int re_position __ARGS((regprog_T *prog));
+char_u *vim_regmust __ARGS((regprog_T *prog, int ic, int *icp));
 char_u *skip_regexp __ARGS((char_u *startp, int dirc, int magic, char_u **newp));
 int vim_regcomp_had_eol __ARGS((void));
 void free_regexp_stuff __ARGS((void));
@@ -11,6 +13,7 @@ int vim_regsub __ARGS((regmatch_T *rmp, char_u *source, char_u *dest, int copy,
 int vim_regsub_multi __ARGS((regmmatch_T *rmp, linenr_T lnum, char_u *source, char_u *dest, int copy, int magic, int backslash));
 char_u *reg_submatch __ARGS((int no));
 list_T *reg_submatch_list __ARGS((int no));
+int vim_regcomp_state __ARGS((void));
 regprog_T *vim_regcomp __ARGS((char_u *expr_arg, int re_flags));
 void vim_regfree __ARGS((regprog_T *prog));
 int vim_regexec_prog __ARGS((regprog_T **prog, int ignore_case, char_u *line, colnr_T col));
@@ -12,6 +12,11 @@ char_u *last_search_pat __ARGS((void));
 void reset_search_dir __ARGS((void));
 void set_last_search_pat __ARGS((char_u *s, int idx, int magic, int setlast));
 void last_pat_prog __ARGS((regmmatch_T *regmatch));
+void sidx_prepare __ARGS((buf_T *buf, regmmatch_T *regmatch));
+int sidx_nomatch __ARGS((buf_T *buf, regmmatch_T *regmatch, linenr_T lnum));
+void sidx_set_nomatch __ARGS((buf_T *buf, regmmatch_T *regmatch, linenr_T lnum));
+void sidx_changed __ARGS((buf_T *buf, linenr_T lnum, linenr_T lnume, long xtra));
+void sidx_clear __ARGS((buf_T *buf));
 int searchit __ARGS((win_T *win, buf_T *buf, pos_T *pos, int dir, char_u *pat, long count, int options, int pat_use, linenr_T stop_lnum, proftime_T *tm));
 void set_search_direction __ARGS((int cdir));
 int do_search __ARGS((oparg_T *oap, int dirc, char_u *pat, long count, int options, proftime_T *tm));
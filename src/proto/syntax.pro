@@ -1,5 +1,9 @@
 /* syntax.c */
 void syntax_start __ARGS((win_T *wp, linenr_T lnum));
+void syntax_start_draw __ARGS((win_T *wp, linenr_T lnum));
+void syntax_ahead __ARGS((void));
+void syn_state_write __ARGS((buf_T *buf));
+void syn_state_write_all __ARGS((void));
 void syn_stack_free_all __ARGS((synblock_T *block));
 void syn_stack_apply_changes __ARGS((buf_T *buf));
 void syntax_end_parsing __ARGS((linenr_T lnum));
@@ -21,6 +25,7 @@ int syn_get_stack_item __ARGS((int i));
 int syn_get_foldlevel __ARGS((win_T *wp, long lnum));
 void ex_syntime __ARGS((exarg_T *eap));
 char_u *get_syntime_arg __ARGS((expand_T *xp, int idx));
+void syntime_dict __ARGS((dict_T *d));
 void init_highlight __ARGS((int both, int reset));
 int load_colors __ARGS((char_u *name));
 void do_highlight __ARGS((char_u *line, int forceit, int init));
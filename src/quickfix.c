@@ -24,19 +24,17 @@ struct dir_stack_T
 static struct dir_stack_T   *dir_stack = NULL;
 
 /*
- * For each error the next struct is allocated and linked in a list.
+ * For each error there is one of these in the qf_lines array of the list.
  */
 typedef struct qfline_S qfline_T;
 struct qfline_S
 {
-    qfline_T	*qf_next;	/* pointer to next error in the list */
-    qfline_T	*qf_prev;	/* pointer to previous error in the list */
     linenr_T	qf_lnum;	/* line number where the error occurred */
     int		qf_fnum;	/* file number for the line */
     int		qf_col;		/* column where the error occurred */
     int		qf_nr;		/* error number */
-    char_u	*qf_pattern;	/* search pattern for the error */
-    char_u	*qf_text;	/* description of the error */
+    char_u	*qf_pattern;	/* search pattern for the error, in qf_blocks */
+    char_u	*qf_text;	/* description of the error, in qf_blocks */
     char_u	qf_viscol;	/* set to TRUE if qf_col is screen column */
     char_u	qf_cleared;	/* set to TRUE if line has been deleted */
     char_u	qf_type;	/* type of the error (mostly 'E'); 1 for
@@ -44,6 +42,23 @@ struct qfline_S
     char_u	qf_valid;	/* valid error message detected */
 };
 
+/*
+ * The text and pattern of the errors in a list are stored in blocks of
+ * memory, which are only freed together with the list.  Each block is twice
+ * as big as the previous one, up to QF_BLOCKSIZE_MAX.
+ */
+#define QF_BLOCKSIZE_MIN    4000
+#define QF_BLOCKSIZE_MAX    1000000L
+
+typedef struct qfblock_S qfblock_T;
+struct qfblock_S
+{
+    qfblock_T	*qb_next;	/* next block in list */
+    long	qb_size;	/* size of qb_data */
+    long	qb_used;	/* number of bytes in qb_data used */
+    char_u	qb_data[1];	/* data, actually longer */
+};
+
 /*
  * There is a stack of error lists.
  */
@@ -51,8 +66,10 @@ struct qfline_S
 
 typedef struct qf_list_S
 {
-    qfline_T	*qf_start;	/* pointer to the first error */
-    qfline_T	*qf_ptr;	/* pointer to the current error */
+    qfline_T	*qf_lines;	/* array with the errors */
+    int		qf_maxcount;	/* number of entries allocated in qf_lines */
+    qfblock_T	*qf_blocks;	/* memory for text and patterns */
+    int		qf_id;		/* unique number, identifies the list */
     int		qf_count;	/* number of errors (0 means no error list) */
     int		qf_index;	/* current index in the error list */
     int		qf_nonevalid;	/* TRUE if not a single valid entry found */
@@ -60,6 +77,9 @@ typedef struct qf_list_S
 				 * the error list */
 } qf_list_T;
 
+/* Error "idx" of list "qfl", the first one is 1. */
+#define QF_ENTRY(qfl, idx)  (&(qfl)->qf_lines[(idx) - 1])
+
 struct qf_info_S
 {
     /*
@@ -75,9 +95,15 @@ struct qf_info_S
 };
 
 static qf_info_T ql_info;	/* global quickfix list */
+static int	last_qf_id = 0;	/* last used qf_id */
 
 #define FMT_PATTERNS 10		/* maximum number of % recognized */
 
+/* Values for "litc" in qf_compile_efm(), other than a literal character. */
+#define QF_LIT_NONE	-1	/* nothing that matches text */
+#define QF_LIT_ATOM	-2	/* an item that is not a literal character */
+#define QF_LIT_STAR	-3	/* "%#", makes the previous item optional */
+
 /*
  * Structure used to hold the info of one part of 'errorformat'
  */
@@ -104,13 +130,82 @@ struct efm_S
 				/*   '-' do not include this line */
 				/*   '+' include whole line in message */
     int		    conthere;	/* %> used */
+    char_u	    firstc;	/* first char of a matching line, lower case;
+				   NUL when unknown */
+    char_u	    *lit;	/* text in every matching line, lower case;
+				   NULL when unknown */
 };
 
+/*
+ * The compiled 'errorformat' is kept and used again when the next errorfile
+ * is read with the same 'errorformat'.
+ */
+static efm_T	*fmt_cache = NULL;
+static char_u	*fmt_cache_efm = NULL;	/* 'errorformat' it was made from */
+static int	fmt_cache_key;		/* qf_efm_cache_key() for it */
+static int	fmt_cache_busy = FALSE;	/* used by a qfstate_T */
+
+/*
+ * State kept while parsing the lines of an errorfile, see qf_parse_line().
+ */
+typedef struct qfstate_S
+{
+    qf_info_T	    *qs_qi;		/* list the entries are added to */
+    efm_T	    *qs_fmt_first;	/* compiled 'errorformat' */
+    efm_T	    *qs_fmt_start;	/* part to start the next line with */
+    char_u	    *qs_namebuf;	/* file name of the current line */
+    char_u	    *qs_errmsg;		/* message of the current line */
+    char_u	    *qs_pattern;	/* pattern of the current line */
+    char_u	    *qs_directory;	/* directory from "%D" */
+    char_u	    *qs_currfile;	/* file name from "%P" */
+    struct dir_stack_T *qs_file_stack;	/* stack of "%P" file names */
+    int		    qs_multiline;	/* inside a multi-line message */
+    int		    qs_multiignore;	/* ignore continuation lines */
+    int		    qs_fmt_cached;	/* qs_fmt_first is fmt_cache */
+} qfstate_T;
+
+/*
+ * State for parsing the errorfile of ":make" while the command is running.
+ */
+typedef struct qfstream_S
+{
+    int		    qst_active;		/* the command is running */
+    int		    qst_blocked;	/* autocommands blocked, remember
+					   buffers for qf_stream_finish() */
+    int		    qst_stopped;	/* parse the rest when finished */
+    qfstate_T	    qst_state;
+    char_u	    *qst_fname;		/* name of the errorfile */
+    int		    qst_fd;		/* errorfile, -1 when not opened */
+    int		    qst_newlist;	/* argument for qf_state_newlist() */
+    char_u	    *qst_title;		/* argument for qf_state_newlist() */
+    garray_T	    qst_pending;	/* text read but not parsed yet */
+    garray_T	    qst_newbufs;	/* numbers of buffers created */
+    garray_T	    qst_listedbufs;	/* numbers of buffers made listed */
+} qfstream_T;
+
+static qfstream_T qf_stream;
+
 static int	qf_init_ext __ARGS((qf_info_T *qi, char_u *efile, buf_T *buf, typval_T *tv, char_u *errorformat, int newlist, linenr_T lnumfirst, linenr_T lnumlast, char_u *qf_title));
+static efm_T	*qf_compile_efm __ARGS((char_u *efm));
+static void	qf_efm_keep_lit __ARGS((efm_T *fmt_ptr, char_u *run, int runlen));
+static int	qf_efm_has_lit __ARGS((char_u *line, char_u *lit));
+static void	qf_free_efm __ARGS((efm_T *fmt_first));
+static int	qf_efm_cache_key __ARGS((void));
+static int	qf_state_init __ARGS((qfstate_T *qs, qf_info_T *qi, char_u *efm));
+static void	qf_state_newlist __ARGS((qfstate_T *qs, int newlist, char_u *qf_title));
+static int	qf_parse_line __ARGS((qfstate_T *qs));
+static int	qf_state_done __ARGS((qfstate_T *qs, int ok));
+static void	qf_state_free __ARGS((qfstate_T *qs));
+static int	qf_stream_start __ARGS((win_T *wp, char_u *fname, char_u *errorformat, int newlist, char_u *qf_title));
+static int	qf_stream_read __ARGS((int final));
+static int	qf_stream_finish __ARGS((void));
+static int	qf_buflist_add __ARGS((char_u *fname));
 static void	qf_store_title __ARGS((qf_info_T *qi, char_u *title));
 static void	qf_new_list __ARGS((qf_info_T *qi, char_u *qf_title));
 static void	ll_free_all __ARGS((qf_info_T **pqi));
-static int	qf_add_entry __ARGS((qf_info_T *qi, qfline_T **prevp, char_u *dir, char_u *fname, int bufnum, char_u *mesg, long lnum, int col, int vis_col, char_u *pattern, int nr, int type, int valid));
+static char_u	*qf_getroom __ARGS((qf_list_T *qfl, size_t len));
+static char_u	*qf_getroom_save __ARGS((qf_list_T *qfl, char_u *s));
+static int	qf_add_entry __ARGS((qf_info_T *qi, char_u *dir, char_u *fname, int bufnum, char_u *mesg, long lnum, int col, int vis_col, char_u *pattern, int nr, int type, int valid));
 static qf_info_T *ll_new_list __ARGS((void));
 static void	qf_msg __ARGS((qf_info_T *qi));
 static void	qf_free __ARGS((qf_info_T *qi, int idx));
@@ -131,6 +226,9 @@ static void	qf_set_title_var __ARGS((qf_info_T *qi));
 static void	qf_fill_buffer __ARGS((qf_info_T *qi));
 #endif
 static char_u	*get_mef_name __ARGS((void));
+static int	vgr_scan_flags __ARGS((regprog_T *prog));
+static int	vgr_scan_line __ARGS((regmmatch_T *rmp, char_u *line, char_u *end, int flags));
+static int	vgr_scan_file __ARGS((regmmatch_T *rmp, char_u *fname, int flags));
 static void	restore_start_dir __ARGS((char_u *dirname_start));
 static buf_T	*load_dummy_buffer __ARGS((char_u *fname, char_u *dirname_start, char_u *resulting_dir));
 static void	wipe_dummy_buffer __ARGS((buf_T *buf, char_u *dirname_start));
@@ -199,42 +297,161 @@ qf_init_ext(qi, efile, buf, tv, errorformat, newlist, lnumfirst, lnumlast,
     linenr_T	    lnumlast;		/* last line number to use */
     char_u	    *qf_title;
 {
-    char_u	    *namebuf;
-    char_u	    *errmsg;
-    char_u	    *pattern;
-    char_u	    *fmtstr = NULL;
-    int		    col = 0;
-    char_u	    use_viscol = FALSE;
-    int		    type = 0;
-    int		    valid;
+    qfstate_T	    qs;
     linenr_T	    buflnum = lnumfirst;
-    long	    lnum = 0L;
-    int		    enr = 0;
     FILE	    *fd = NULL;
-    qfline_T	    *qfprev = NULL;	/* init to make SASC shut up */
+    char_u	    *efm;
+    int		    len;
+    int		    ok = TRUE;
+    int		    retval = -1;	/* default: return error flag */
+    char_u	    *p_str = NULL;
+    listitem_T	    *p_li = NULL;
+
+    if (efile != NULL && (fd = mch_fopen((char *)efile, "r")) == NULL)
+    {
+	EMSG2(_(e_openerrf), efile);
+	goto qf_init_end;
+    }
+
+    /* Use the local value of 'errorformat' if it's set. */
+    if (errorformat == p_efm && tv == NULL && *buf->b_p_efm != NUL)
+	efm = buf->b_p_efm;
+    else
+	efm = errorformat;
+    if (qf_state_init(&qs, qi, efm) == FAIL)
+	goto qf_init_end;
+    qf_state_newlist(&qs, newlist, qf_title);
+
+    /*
+     * got_int is reset here, because it was probably set when killing the
+     * ":make" command, but we still want to read the errorfile then.
+     */
+    got_int = FALSE;
+
+    if (tv != NULL)
+    {
+	if (tv->v_type == VAR_STRING)
+	    p_str = tv->vval.v_string;
+	else if (tv->v_type == VAR_LIST)
+	    p_li = tv->vval.v_list->lv_first;
+    }
+
+    /*
+     * Read the lines in the error file one by one.
+     * Try to recognize one of the error formats in each line.
+     */
+    while (!got_int)
+    {
+	/* Get the next line. */
+	if (fd == NULL)
+	{
+	    if (tv != NULL)
+	    {
+		if (tv->v_type == VAR_STRING)
+		{
+		    /* Get the next line from the supplied string */
+		    char_u *p;
+
+		    if (!*p_str) /* Reached the end of the string */
+			break;
+
+		    p = vim_strchr(p_str, '\n');
+		    if (p)
+			len = (int)(p - p_str + 1);
+		    else
+			len = (int)STRLEN(p_str);
+
+		    if (len > CMDBUFFSIZE - 2)
+			vim_strncpy(IObuff, p_str, CMDBUFFSIZE - 2);
+		    else
+			vim_strncpy(IObuff, p_str, len);
+
+		    p_str += len;
+		}
+		else if (tv->v_type == VAR_LIST)
+		{
+		    /* Get the next line from the supplied list */
+		    while (p_li && p_li->li_tv.v_type != VAR_STRING)
+			p_li = p_li->li_next;	/* Skip non-string items */
+
+		    if (!p_li)			/* End of the list */
+			break;
+
+		    len = (int)STRLEN(p_li->li_tv.vval.v_string);
+		    if (len > CMDBUFFSIZE - 2)
+			len = CMDBUFFSIZE - 2;
+
+		    vim_strncpy(IObuff, p_li->li_tv.vval.v_string, len);
+
+		    p_li = p_li->li_next;	/* next item */
+		}
+	    }
+	    else
+	    {
+		/* Get the next line from the supplied buffer */
+		if (buflnum > lnumlast)
+		    break;
+		vim_strncpy(IObuff, ml_get_buf(buf, buflnum++, FALSE),
+			    CMDBUFFSIZE - 2);
+	    }
+	}
+	else if (fgets((char *)IObuff, CMDBUFFSIZE - 2, fd) == NULL)
+	    break;
+
+	if (qf_parse_line(&qs) == FAIL)
+	{
+	    ok = FALSE;
+	    break;
+	}
+	line_breakcheck();
+    }
+    if (ok && fd != NULL && ferror(fd))
+    {
+	EMSG(_(e_readerrf));
+	ok = FALSE;
+    }
+    retval = qf_state_done(&qs, ok);
+
+qf_init_end:
+    if (fd != NULL)
+	fclose(fd);
+
+#ifdef FEAT_WINDOWS
+    qf_update_buffer(qi);
+#endif
+
+    return retval;
+}
+
+/*
+ * Convert 'errorformat' "efm" into a list of efm_T items, each with the
+ * regexp program for one part.
+ * Returns NULL and gives an error message when "efm" is invalid.
+ */
+    static efm_T *
+qf_compile_efm(efm)
+    char_u	    *efm;
+{
+    char_u	    *fmtstr;
     char_u	    *efmp;
     efm_T	    *fmt_first = NULL;
     efm_T	    *fmt_last = NULL;
     efm_T	    *fmt_ptr;
-    efm_T	    *fmt_start = NULL;
-    char_u	    *efm;
     char_u	    *ptr;
     char_u	    *srcptr;
     int		    len;
     int		    i;
     int		    round;
     int		    idx = 0;
-    int		    multiline = FALSE;
-    int		    multiignore = FALSE;
-    int		    multiscan = FALSE;
-    int		    retval = -1;	/* default: return error flag */
-    char_u	    *directory = NULL;
-    char_u	    *currfile = NULL;
-    char_u	    *tail = NULL;
-    char_u	    *p_str = NULL;
-    listitem_T	    *p_li = NULL;
-    struct dir_stack_T  *file_stack = NULL;
-    regmatch_T	    regmatch;
+    char_u	    *run;	/* literal text found so far */
+    int		    runlen;
+    int		    natoms;	/* number of items matching text */
+    int		    litc;	/* literal char, or one of QF_LIT_ */
+    int		    lastlit;	/* previous item was a literal char */
+    int		    rawbs;	/* item put a backslash in the pattern */
+    int		    skipnext;	/* next item is not literal */
+    int		    coll;	/* 1: just after "%[", 2: inside it */
+    int		    collbs;	/* previous item in "%[]" was "%\" */
     static struct fmtpattern
     {
 	char_u	convchar;
@@ -253,36 +470,10 @@ qf_init_ext(qi, efile, buf, tv, errorformat, newlist, lnumfirst, lnumlast,
 			{'s', ".\\+"}
 		    };
 
-    namebuf = alloc(CMDBUFFSIZE + 1);
-    errmsg = alloc(CMDBUFFSIZE + 1);
-    pattern = alloc(CMDBUFFSIZE + 1);
-    if (namebuf == NULL || errmsg == NULL || pattern == NULL)
-	goto qf_init_end;
-
-    if (efile != NULL && (fd = mch_fopen((char *)efile, "r")) == NULL)
-    {
-	EMSG2(_(e_openerrf), efile);
-	goto qf_init_end;
-    }
-
-    if (newlist || qi->qf_curlist == qi->qf_listcount)
-	/* make place for a new list */
-	qf_new_list(qi, qf_title);
-    else if (qi->qf_lists[qi->qf_curlist].qf_count > 0)
-	/* Adding to existing list, find last entry. */
-	for (qfprev = qi->qf_lists[qi->qf_curlist].qf_start;
-			  qfprev->qf_next != qfprev; qfprev = qfprev->qf_next)
-	    ;
-
 /*
  * Each part of the format string is copied and modified from errorformat to
  * regex prog.  Only a few % characters are allowed.
  */
-    /* Use the local value of 'errorformat' if it's set. */
-    if (errorformat == p_efm && tv == NULL && *buf->b_p_efm != NUL)
-	efm = buf->b_p_efm;
-    else
-	efm = errorformat;
     /*
      * Get some space to modify the format string into.
      */
@@ -295,7 +486,12 @@ qf_init_ext(qi, efile, buf, tv, errorformat, newlist, lnumfirst, lnumlast,
     i += 2; /* "%f" can become two chars longer */
 #endif
     if ((fmtstr = alloc(i)) == NULL)
-	goto error2;
+	return NULL;
+    if ((run = alloc((unsigned)STRLEN(efm) + 1)) == NULL)
+    {
+	vim_free(fmtstr);
+	return NULL;
+    }
 
     while (efm[0] != NUL)
     {
@@ -319,13 +515,23 @@ qf_init_ext(qi, efile, buf, tv, errorformat, newlist, lnumfirst, lnumlast,
 		++len;
 
 	/*
-	 * Build regexp pattern from current 'errorformat' option
+	 * Build regexp pattern from current 'errorformat' option.
+	 * Also find out what literal text a matching line must contain, to
+	 * be able to skip the regexp quickly.
 	 */
 	ptr = fmtstr;
 	*ptr++ = '^';
 	round = 0;
+	runlen = 0;
+	natoms = 0;
+	lastlit = FALSE;
+	skipnext = FALSE;
+	coll = 0;
+	collbs = FALSE;
 	for (efmp = efm; efmp < efm + len; ++efmp)
 	{
+	    litc = QF_LIT_NONE;
+	    rawbs = FALSE;
 	    if (*efmp == '%')
 	    {
 		++efmp;
@@ -336,9 +542,9 @@ qf_init_ext(qi, efile, buf, tv, errorformat, newlist, lnumfirst, lnumlast,
 		{
 		    if (fmt_ptr->addr[idx])
 		    {
-			sprintf((char *)errmsg,
+			sprintf((char *)IObuff,
 				_("E372: Too many %%%c in format string"), *efmp);
-			EMSG(errmsg);
+			EMSG(IObuff);
 			goto error2;
 		    }
 		    if ((idx
@@ -349,9 +555,9 @@ qf_init_ext(qi, efile, buf, tv, errorformat, newlist, lnumfirst, lnumlast,
 				&& vim_strchr((char_u *)"OPQ",
 						    fmt_ptr->prefix) == NULL))
 		    {
-			sprintf((char *)errmsg,
+			sprintf((char *)IObuff,
 				_("E373: Unexpected %%%c in format string"), *efmp);
-			EMSG(errmsg);
+			EMSG(IObuff);
 			goto error2;
 		    }
 		    fmt_ptr->addr[idx] = (char_u)++round;
@@ -395,6 +601,7 @@ qf_init_ext(qi, efile, buf, tv, errorformat, newlist, lnumfirst, lnumlast,
 		    }
 		    *ptr++ = '\\';
 		    *ptr++ = ')';
+		    litc = QF_LIT_ATOM;
 		}
 		else if (*efmp == '*')
 		{
@@ -421,20 +628,28 @@ qf_init_ext(qi, efile, buf, tv, errorformat, newlist, lnumfirst, lnumlast,
 			    *ptr++ = *++efmp;
 			*ptr++ = '\\';
 			*ptr++ = '+';
+			litc = QF_LIT_ATOM;
 		    }
 		    else
 		    {
 			/* TODO: scanf()-like: %*ud, %*3c, %*f, ... ? */
-			sprintf((char *)errmsg,
+			sprintf((char *)IObuff,
 				_("E375: Unsupported %%%c in format string"), *efmp);
-			EMSG(errmsg);
+			EMSG(IObuff);
 			goto error2;
 		    }
 		}
 		else if (vim_strchr((char_u *)"%\\.^$~[", *efmp) != NULL)
+		{
 		    *ptr++ = *efmp;		/* regexp magic characters */
+		    litc = *efmp == '%' ? '%' : QF_LIT_ATOM;
+		    rawbs = *efmp == '\\';
+		}
 		else if (*efmp == '#')
+		{
 		    *ptr++ = '*';
+		    litc = QF_LIT_STAR;
+		}
 		else if (*efmp == '>')
 		    fmt_ptr->conthere = TRUE;
 		else if (efmp == efm + 1)		/* analyse prefix */
@@ -445,30 +660,91 @@ qf_init_ext(qi, efile, buf, tv, errorformat, newlist, lnumfirst, lnumlast,
 			fmt_ptr->prefix = *efmp;
 		    else
 		    {
-			sprintf((char *)errmsg,
+			sprintf((char *)IObuff,
 				_("E376: Invalid %%%c in format string prefix"), *efmp);
-			EMSG(errmsg);
+			EMSG(IObuff);
 			goto error2;
 		    }
 		}
 		else
 		{
-		    sprintf((char *)errmsg,
+		    sprintf((char *)IObuff,
 			    _("E377: Invalid %%%c in format string"), *efmp);
-		    EMSG(errmsg);
+		    EMSG(IObuff);
 		    goto error2;
 		}
 	    }
 	    else			/* copy normal character */
 	    {
 		if (*efmp == '\\' && efmp + 1 < efm + len)
+		{
 		    ++efmp;
+		    /* the character is used as-is, it may be magic */
+		    if (vim_strchr((char_u *)".*^$~[\\", *efmp) != NULL)
+			litc = QF_LIT_ATOM;
+		    else
+			litc = *efmp;
+		}
 		else if (vim_strchr((char_u *)".*^$~[", *efmp) != NULL)
+		{
 		    *ptr++ = '\\';	/* escape regexp atoms */
+		    litc = *efmp;
+		}
+		else
+		    litc = *efmp == '\\' ? QF_LIT_ATOM : *efmp;
+		rawbs = *efmp == '\\';
 		if (*efmp)
 		    *ptr++ = *efmp;
 	    }
+
+	    /* A "%[]" collection is one item, up to the "]" that is not the
+	     * first character and does not follow "%\".  "%^" negates. */
+	    if (coll != 0)
+	    {
+		if (*efmp == ']' && coll == 2 && !collbs)
+		    coll = 0;
+		else if (coll == 2 || *efmp != '^' || litc != QF_LIT_ATOM)
+		    coll = 2;
+		collbs = rawbs;
+		litc = QF_LIT_NONE;
+	    }
+	    else if (litc == QF_LIT_ATOM && *efmp == '[' && efmp[-1] == '%')
+	    {
+		coll = 1;
+		collbs = FALSE;
+	    }
+
+	    /* Only ASCII is literal, 'ignorecase' applies and "k" and "s"
+	     * may match a multi-byte character. */
+	    if (litc >= 0x80 || vim_strchr((char_u *)"kKsS", litc) != NULL
+						  || (litc >= 0 && skipnext))
+		litc = QF_LIT_ATOM;
+	    if (litc >= 0)
+	    {
+		if (natoms++ == 0)
+		    fmt_ptr->firstc = TOLOWER_ASC(litc);
+		run[runlen++] = TOLOWER_ASC(litc);
+		lastlit = TRUE;
+	    }
+	    else if (litc != QF_LIT_NONE)
+	    {
+		/* "%#" makes the previous item optional */
+		if (litc == QF_LIT_STAR && lastlit)
+		{
+		    --runlen;
+		    if (natoms == 1)
+			fmt_ptr->firstc = NUL;
+		}
+		else
+		    ++natoms;
+		qf_efm_keep_lit(fmt_ptr, run, runlen);
+		runlen = 0;
+		lastlit = FALSE;
+	    }
+	    if (litc != QF_LIT_NONE)
+		skipnext = rawbs;
 	}
+	qf_efm_keep_lit(fmt_ptr, run, runlen);
 	*ptr++ = '$';
 	*ptr = NUL;
 	if ((fmt_ptr->prog = vim_regcomp(fmtstr, RE_MAGIC + RE_STRING)) == NULL)
@@ -479,416 +755,565 @@ qf_init_ext(qi, efile, buf, tv, errorformat, newlist, lnumfirst, lnumlast,
 	efm = skip_to_option_part(efm + len);	/* skip comma and spaces */
     }
     if (fmt_first == NULL)	/* nothing found */
-    {
 	EMSG(_("E378: 'errorformat' contains no pattern"));
-	goto error2;
-    }
+    vim_free(fmtstr);
+    vim_free(run);
+    return fmt_first;
 
-    /*
-     * got_int is reset here, because it was probably set when killing the
-     * ":make" command, but we still want to read the errorfile then.
-     */
-    got_int = FALSE;
+error2:
+    vim_free(fmtstr);
+    vim_free(run);
+    qf_free_efm(fmt_first);
+    return NULL;
+}
 
-    /* Always ignore case when looking for a matching error. */
-    regmatch.rm_ic = TRUE;
+/*
+ * Use literal text "run[runlen]" for "fmt_ptr" if it is longer than what was
+ * found before.
+ */
+    static void
+qf_efm_keep_lit(fmt_ptr, run, runlen)
+    efm_T	*fmt_ptr;
+    char_u	*run;
+    int		runlen;
+{
+    char_u	*p;
 
-    if (tv != NULL)
+    if (runlen > 0 && (fmt_ptr->lit == NULL
+				       || runlen > (int)STRLEN(fmt_ptr->lit)))
     {
-	if (tv->v_type == VAR_STRING)
-	    p_str = tv->vval.v_string;
-	else if (tv->v_type == VAR_LIST)
-	    p_li = tv->vval.v_list->lv_first;
+	p = vim_strnsave(run, runlen);
+	if (p != NULL)
+	{
+	    vim_free(fmt_ptr->lit);
+	    fmt_ptr->lit = p;
+	}
     }
+}
 
-    /*
-     * Read the lines in the error file one by one.
-     * Try to recognize one of the error formats in each line.
-     */
-    while (!got_int)
-    {
-	/* Get the next line. */
-	if (fd == NULL)
+/*
+ * Return TRUE if "line" contains "lit", ignoring case.
+ */
+    static int
+qf_efm_has_lit(line, lit)
+    char_u	*line;
+    char_u	*lit;
+{
+    char_u	*p;
+    int		i;
+
+    for (p = line; *p != NUL; ++p)
+	if (TOLOWER_ASC(*p) == *lit)
 	{
-	    if (tv != NULL)
-	    {
-		if (tv->v_type == VAR_STRING)
-		{
-		    /* Get the next line from the supplied string */
-		    char_u *p;
+	    for (i = 1; lit[i] != NUL && TOLOWER_ASC(p[i]) == lit[i]; ++i)
+		;
+	    if (lit[i] == NUL)
+		return TRUE;
+	}
+    return FALSE;
+}
 
-		    if (!*p_str) /* Reached the end of the string */
-			break;
+/*
+ * Free the list of efm_T items "fmt_first".
+ */
+    static void
+qf_free_efm(fmt_first)
+    efm_T	*fmt_first;
+{
+    efm_T	*fmt_ptr;
 
-		    p = vim_strchr(p_str, '\n');
-		    if (p)
-			len = (int)(p - p_str + 1);
-		    else
-			len = (int)STRLEN(p_str);
-
-		    if (len > CMDBUFFSIZE - 2)
-			vim_strncpy(IObuff, p_str, CMDBUFFSIZE - 2);
-		    else
-			vim_strncpy(IObuff, p_str, len);
+    for (fmt_ptr = fmt_first; fmt_ptr != NULL; fmt_ptr = fmt_first)
+    {
+	fmt_first = fmt_ptr->next;
+	vim_regfree(fmt_ptr->prog);
+	vim_free(fmt_ptr->lit);
+	vim_free(fmt_ptr);
+    }
+}
 
-		    p_str += len;
-		}
-		else if (tv->v_type == VAR_LIST)
-		{
-		    /* Get the next line from the supplied list */
-		    while (p_li && p_li->li_tv.v_type != VAR_STRING)
-			p_li = p_li->li_next;	/* Skip non-string items */
+/*
+ * Return a number for the settings that influence compiling 'errorformat'.
+ */
+    static int
+qf_efm_cache_key()
+{
+    int		key = (int)p_re;
 
-		    if (!p_li)			/* End of the list */
-			break;
+    if (vim_strchr(p_cpo, CPO_LITERAL) != NULL)
+	key += 4;
+    if (vim_strchr(p_cpo, CPO_BACKSL) != NULL)
+	key += 8;
+#ifdef FEAT_MBYTE
+    key += enc_utf8 * 16 + enc_dbcs * 32;
+#endif
+    return key;
+}
 
-		    len = (int)STRLEN(p_li->li_tv.vval.v_string);
-		    if (len > CMDBUFFSIZE - 2)
-			len = CMDBUFFSIZE - 2;
+/*
+ * Prepare "qs" for parsing lines with 'errorformat' "efm" into quickfix list
+ * "qi".  qf_state_newlist() must be called before parsing lines.
+ * Returns FAIL when "efm" is invalid or out of memory.
+ */
+    static int
+qf_state_init(qs, qi, efm)
+    qfstate_T	*qs;
+    qf_info_T	*qi;
+    char_u	*efm;
+{
+    vim_memset(qs, 0, sizeof(qfstate_T));
+    qs->qs_qi = qi;
+    qs->qs_namebuf = alloc(CMDBUFFSIZE + 1);
+    qs->qs_errmsg = alloc(CMDBUFFSIZE + 1);
+    qs->qs_pattern = alloc(CMDBUFFSIZE + 1);
+    if (qs->qs_namebuf != NULL && qs->qs_errmsg != NULL
+						    && qs->qs_pattern != NULL)
+    {
+	if (!fmt_cache_busy && fmt_cache != NULL
+		&& fmt_cache_key == qf_efm_cache_key()
+		&& STRCMP(fmt_cache_efm, efm) == 0)
+	    qs->qs_fmt_first = fmt_cache;
+	else
+	    qs->qs_fmt_first = qf_compile_efm(efm);
 
-		    vim_strncpy(IObuff, p_li->li_tv.vval.v_string, len);
+	/* Keep the compiled 'errorformat' for next time, unless the cache is
+	 * in use (an autocommand may parse an errorfile while parsing). */
+	if (qs->qs_fmt_first != NULL && !fmt_cache_busy)
+	{
+	    if (qs->qs_fmt_first != fmt_cache)
+	    {
+		char_u	*p = vim_strsave(efm);
 
-		    p_li = p_li->li_next;	/* next item */
+		if (p != NULL)
+		{
+		    qf_free_efm(fmt_cache);
+		    vim_free(fmt_cache_efm);
+		    fmt_cache = qs->qs_fmt_first;
+		    fmt_cache_efm = p;
+		    fmt_cache_key = qf_efm_cache_key();
 		}
 	    }
-	    else
+	    if (qs->qs_fmt_first == fmt_cache)
 	    {
-		/* Get the next line from the supplied buffer */
-		if (buflnum > lnumlast)
-		    break;
-		vim_strncpy(IObuff, ml_get_buf(buf, buflnum++, FALSE),
-			    CMDBUFFSIZE - 2);
+		fmt_cache_busy = TRUE;
+		qs->qs_fmt_cached = TRUE;
 	    }
 	}
-	else if (fgets((char *)IObuff, CMDBUFFSIZE - 2, fd) == NULL)
-	    break;
+    }
+    if (qs->qs_fmt_first == NULL)
+    {
+	qf_state_free(qs);
+	return FAIL;
+    }
+    return OK;
+}
+
+/*
+ * Make a new list for "qs" when "newlist" is TRUE or there is no current
+ * list, otherwise add to the current list.
+ */
+    static void
+qf_state_newlist(qs, newlist, qf_title)
+    qfstate_T	*qs;
+    int		newlist;	/* TRUE: start a new error list */
+    char_u	*qf_title;
+{
+    qf_info_T	*qi = qs->qs_qi;
 
-	IObuff[CMDBUFFSIZE - 2] = NUL;  /* for very long lines */
+    if (newlist || qi->qf_curlist == qi->qf_listcount)
+	/* make place for a new list */
+	qf_new_list(qi, qf_title);
+}
+
+/*
+ * Parse the line in IObuff with the 'errorformat' of "qs" and add an entry
+ * to the quickfix list for it.
+ * Returns FAIL for an error.
+ */
+    static int
+qf_parse_line(qs)
+    qfstate_T	    *qs;
+{
+    qf_info_T	    *qi = qs->qs_qi;
+    char_u	    *namebuf = qs->qs_namebuf;
+    char_u	    *errmsg = qs->qs_errmsg;
+    char_u	    *pattern = qs->qs_pattern;
+    char_u	    *efmp;
+    efm_T	    *fmt_ptr;
+    char_u	    *ptr;
+    char_u	    *tail = NULL;
+    int		    col = 0;
+    char_u	    use_viscol = FALSE;
+    int		    type = 0;
+    int		    valid;
+    long	    lnum = 0L;
+    int		    enr = 0;
+    int		    len;
+    int		    i;
+    int		    idx = 0;
+    int		    multiscan = FALSE;
+    regmatch_T	    regmatch;
+
+    IObuff[CMDBUFFSIZE - 2] = NUL;  /* for very long lines */
 #ifdef FEAT_MBYTE
-	remove_bom(IObuff);
+    remove_bom(IObuff);
 #endif
 
-	if ((efmp = vim_strrchr(IObuff, '\n')) != NULL)
-	    *efmp = NUL;
+    if ((efmp = vim_strrchr(IObuff, '\n')) != NULL)
+	*efmp = NUL;
 #ifdef USE_CRNL
-	if ((efmp = vim_strrchr(IObuff, '\r')) != NULL)
-	    *efmp = NUL;
+    if ((efmp = vim_strrchr(IObuff, '\r')) != NULL)
+	*efmp = NUL;
 #endif
 
-	/* If there was no %> item start at the first pattern */
-	if (fmt_start == NULL)
-	    fmt_ptr = fmt_first;
-	else
-	{
-	    fmt_ptr = fmt_start;
-	    fmt_start = NULL;
-	}
+    /* Always ignore case when looking for a matching error. */
+    regmatch.rm_ic = TRUE;
 
-	/*
-	 * Try to match each part of 'errorformat' until we find a complete
-	 * match or no match.
-	 */
-	valid = TRUE;
+    /* If there was no %> item start at the first pattern */
+    if (qs->qs_fmt_start == NULL)
+	fmt_ptr = qs->qs_fmt_first;
+    else
+    {
+	fmt_ptr = qs->qs_fmt_start;
+	qs->qs_fmt_start = NULL;
+    }
+
+    /*
+     * Try to match each part of 'errorformat' until we find a complete
+     * match or no match.
+     */
+    valid = TRUE;
 restofline:
-	for ( ; fmt_ptr != NULL; fmt_ptr = fmt_ptr->next)
-	{
-	    int r;
+    for ( ; fmt_ptr != NULL; fmt_ptr = fmt_ptr->next)
+    {
+	int r;
 
-	    idx = fmt_ptr->prefix;
-	    if (multiscan && vim_strchr((char_u *)"OPQ", idx) == NULL)
+	idx = fmt_ptr->prefix;
+	if (multiscan && vim_strchr((char_u *)"OPQ", idx) == NULL)
+	    continue;
+	namebuf[0] = NUL;
+	pattern[0] = NUL;
+	if (!multiscan)
+	    errmsg[0] = NUL;
+	lnum = 0;
+	col = 0;
+	use_viscol = FALSE;
+	enr = -1;
+	type = 0;
+	tail = NULL;
+
+	/* Skip the regexp when the line can't match. */
+	if ((fmt_ptr->firstc != NUL
+			       && TOLOWER_ASC(*IObuff) != fmt_ptr->firstc)
+		|| (fmt_ptr->lit != NULL
+				   && !qf_efm_has_lit(IObuff, fmt_ptr->lit)))
+	    continue;
+
+	regmatch.regprog = fmt_ptr->prog;
+	r = vim_regexec(&regmatch, IObuff, (colnr_T)0);
+	fmt_ptr->prog = regmatch.regprog;
+	if (r)
+	{
+	    if ((idx == 'C' || idx == 'Z') && !qs->qs_multiline)
 		continue;
-	    namebuf[0] = NUL;
-	    pattern[0] = NUL;
-	    if (!multiscan)
-		errmsg[0] = NUL;
-	    lnum = 0;
-	    col = 0;
-	    use_viscol = FALSE;
-	    enr = -1;
-	    type = 0;
-	    tail = NULL;
-
-	    regmatch.regprog = fmt_ptr->prog;
-	    r = vim_regexec(&regmatch, IObuff, (colnr_T)0);
-	    fmt_ptr->prog = regmatch.regprog;
-	    if (r)
+	    if (vim_strchr((char_u *)"EWI", idx) != NULL)
+		type = idx;
+	    else
+		type = 0;
+	    /*
+	     * Extract error message data from matched line.
+	     * We check for an actual submatch, because "\[" and "\]" in
+	     * the 'errorformat' may cause the wrong submatch to be used.
+	     */
+	    if ((i = (int)fmt_ptr->addr[0]) > 0)		/* %f */
 	    {
-		if ((idx == 'C' || idx == 'Z') && !multiline)
-		    continue;
-		if (vim_strchr((char_u *)"EWI", idx) != NULL)
-		    type = idx;
-		else
-		    type = 0;
-		/*
-		 * Extract error message data from matched line.
-		 * We check for an actual submatch, because "\[" and "\]" in
-		 * the 'errorformat' may cause the wrong submatch to be used.
-		 */
-		if ((i = (int)fmt_ptr->addr[0]) > 0)		/* %f */
-		{
-		    int c;
+		int c;
 
-		    if (regmatch.startp[i] == NULL || regmatch.endp[i] == NULL)
-			continue;
+		if (regmatch.startp[i] == NULL || regmatch.endp[i] == NULL)
+		    continue;
 
-		    /* Expand ~/file and $HOME/file to full path. */
-		    c = *regmatch.endp[i];
-		    *regmatch.endp[i] = NUL;
-		    expand_env(regmatch.startp[i], namebuf, CMDBUFFSIZE);
-		    *regmatch.endp[i] = c;
+		/* Expand ~/file and $HOME/file to full path. */
+		c = *regmatch.endp[i];
+		*regmatch.endp[i] = NUL;
+		expand_env(regmatch.startp[i], namebuf, CMDBUFFSIZE);
+		*regmatch.endp[i] = c;
 
-		    if (vim_strchr((char_u *)"OPQ", idx) != NULL
+		if (vim_strchr((char_u *)"OPQ", idx) != NULL
 						&& mch_getperm(namebuf) == -1)
-			continue;
-		}
-		if ((i = (int)fmt_ptr->addr[1]) > 0)		/* %n */
-		{
-		    if (regmatch.startp[i] == NULL)
-			continue;
-		    enr = (int)atol((char *)regmatch.startp[i]);
-		}
-		if ((i = (int)fmt_ptr->addr[2]) > 0)		/* %l */
-		{
-		    if (regmatch.startp[i] == NULL)
-			continue;
-		    lnum = atol((char *)regmatch.startp[i]);
-		}
-		if ((i = (int)fmt_ptr->addr[3]) > 0)		/* %c */
-		{
-		    if (regmatch.startp[i] == NULL)
-			continue;
-		    col = (int)atol((char *)regmatch.startp[i]);
-		}
-		if ((i = (int)fmt_ptr->addr[4]) > 0)		/* %t */
-		{
-		    if (regmatch.startp[i] == NULL)
-			continue;
-		    type = *regmatch.startp[i];
-		}
-		if (fmt_ptr->flags == '+' && !multiscan)	/* %+ */
-		    STRCPY(errmsg, IObuff);
-		else if ((i = (int)fmt_ptr->addr[5]) > 0)	/* %m */
-		{
-		    if (regmatch.startp[i] == NULL || regmatch.endp[i] == NULL)
-			continue;
-		    len = (int)(regmatch.endp[i] - regmatch.startp[i]);
-		    vim_strncpy(errmsg, regmatch.startp[i], len);
-		}
-		if ((i = (int)fmt_ptr->addr[6]) > 0)		/* %r */
-		{
-		    if (regmatch.startp[i] == NULL)
-			continue;
-		    tail = regmatch.startp[i];
-		}
-		if ((i = (int)fmt_ptr->addr[7]) > 0)		/* %p */
-		{
-		    char_u	*match_ptr;
+		    continue;
+	    }
+	    if ((i = (int)fmt_ptr->addr[1]) > 0)		/* %n */
+	    {
+		if (regmatch.startp[i] == NULL)
+		    continue;
+		enr = (int)atol((char *)regmatch.startp[i]);
+	    }
+	    if ((i = (int)fmt_ptr->addr[2]) > 0)		/* %l */
+	    {
+		if (regmatch.startp[i] == NULL)
+		    continue;
+		lnum = atol((char *)regmatch.startp[i]);
+	    }
+	    if ((i = (int)fmt_ptr->addr[3]) > 0)		/* %c */
+	    {
+		if (regmatch.startp[i] == NULL)
+		    continue;
+		col = (int)atol((char *)regmatch.startp[i]);
+	    }
+	    if ((i = (int)fmt_ptr->addr[4]) > 0)		/* %t */
+	    {
+		if (regmatch.startp[i] == NULL)
+		    continue;
+		type = *regmatch.startp[i];
+	    }
+	    if (fmt_ptr->flags == '+' && !multiscan)	/* %+ */
+		STRCPY(errmsg, IObuff);
+	    else if ((i = (int)fmt_ptr->addr[5]) > 0)	/* %m */
+	    {
+		if (regmatch.startp[i] == NULL || regmatch.endp[i] == NULL)
+		    continue;
+		len = (int)(regmatch.endp[i] - regmatch.startp[i]);
+		vim_strncpy(errmsg, regmatch.startp[i], len);
+	    }
+	    if ((i = (int)fmt_ptr->addr[6]) > 0)		/* %r */
+	    {
+		if (regmatch.startp[i] == NULL)
+		    continue;
+		tail = regmatch.startp[i];
+	    }
+	    if ((i = (int)fmt_ptr->addr[7]) > 0)		/* %p */
+	    {
+		char_u	*match_ptr;
 
-		    if (regmatch.startp[i] == NULL || regmatch.endp[i] == NULL)
-			continue;
-		    col = 0;
-		    for (match_ptr = regmatch.startp[i];
+		if (regmatch.startp[i] == NULL || regmatch.endp[i] == NULL)
+		    continue;
+		col = 0;
+		for (match_ptr = regmatch.startp[i];
 				   match_ptr != regmatch.endp[i]; ++match_ptr)
+		{
+		    ++col;
+		    if (*match_ptr == TAB)
 		    {
-			++col;
-			if (*match_ptr == TAB)
-			{
-			    col += 7;
-			    col -= col % 8;
-			}
+			col += 7;
+			col -= col % 8;
 		    }
-		    ++col;
-		    use_viscol = TRUE;
-		}
-		if ((i = (int)fmt_ptr->addr[8]) > 0)		/* %v */
-		{
-		    if (regmatch.startp[i] == NULL)
-			continue;
-		    col = (int)atol((char *)regmatch.startp[i]);
-		    use_viscol = TRUE;
-		}
-		if ((i = (int)fmt_ptr->addr[9]) > 0)		/* %s */
-		{
-		    if (regmatch.startp[i] == NULL || regmatch.endp[i] == NULL)
-			continue;
-		    len = (int)(regmatch.endp[i] - regmatch.startp[i]);
-		    if (len > CMDBUFFSIZE - 5)
-			len = CMDBUFFSIZE - 5;
-		    STRCPY(pattern, "^\\V");
-		    STRNCAT(pattern, regmatch.startp[i], len);
-		    pattern[len + 3] = '\\';
-		    pattern[len + 4] = '$';
-		    pattern[len + 5] = NUL;
 		}
-		break;
+		++col;
+		use_viscol = TRUE;
+	    }
+	    if ((i = (int)fmt_ptr->addr[8]) > 0)		/* %v */
+	    {
+		if (regmatch.startp[i] == NULL)
+		    continue;
+		col = (int)atol((char *)regmatch.startp[i]);
+		use_viscol = TRUE;
 	    }
+	    if ((i = (int)fmt_ptr->addr[9]) > 0)		/* %s */
+	    {
+		if (regmatch.startp[i] == NULL || regmatch.endp[i] == NULL)
+		    continue;
+		len = (int)(regmatch.endp[i] - regmatch.startp[i]);
+		if (len > CMDBUFFSIZE - 5)
+		    len = CMDBUFFSIZE - 5;
+		STRCPY(pattern, "^\\V");
+		STRNCAT(pattern, regmatch.startp[i], len);
+		pattern[len + 3] = '\\';
+		pattern[len + 4] = '$';
+		pattern[len + 5] = NUL;
+	    }
+	    break;
 	}
-	multiscan = FALSE;
+    }
+    multiscan = FALSE;
 
-	if (fmt_ptr == NULL || idx == 'D' || idx == 'X')
+    if (fmt_ptr == NULL || idx == 'D' || idx == 'X')
+    {
+	if (fmt_ptr != NULL)
 	{
-	    if (fmt_ptr != NULL)
+	    if (idx == 'D')				/* enter directory */
 	    {
-		if (idx == 'D')				/* enter directory */
+		if (*namebuf == NUL)
 		{
-		    if (*namebuf == NUL)
-		    {
-			EMSG(_("E379: Missing or empty directory name"));
-			goto error2;
-		    }
-		    if ((directory = qf_push_dir(namebuf, &dir_stack)) == NULL)
-			goto error2;
+		    EMSG(_("E379: Missing or empty directory name"));
+		    return FAIL;
 		}
-		else if (idx == 'X')			/* leave directory */
-		    directory = qf_pop_dir(&dir_stack);
+		if ((qs->qs_directory = qf_push_dir(namebuf, &dir_stack))
+								       == NULL)
+		    return FAIL;
 	    }
-	    namebuf[0] = NUL;		/* no match found, remove file name */
-	    lnum = 0;			/* don't jump to this line */
-	    valid = FALSE;
-	    STRCPY(errmsg, IObuff);	/* copy whole line to error message */
-	    if (fmt_ptr == NULL)
-		multiline = multiignore = FALSE;
+	    else if (idx == 'X')			/* leave directory */
+		qs->qs_directory = qf_pop_dir(&dir_stack);
 	}
-	else if (fmt_ptr != NULL)
-	{
-	    /* honor %> item */
-	    if (fmt_ptr->conthere)
-		fmt_start = fmt_ptr;
+	namebuf[0] = NUL;		/* no match found, remove file name */
+	lnum = 0;			/* don't jump to this line */
+	valid = FALSE;
+	STRCPY(errmsg, IObuff);		/* copy whole line to error message */
+	if (fmt_ptr == NULL)
+	    qs->qs_multiline = qs->qs_multiignore = FALSE;
+    }
+    else if (fmt_ptr != NULL)
+    {
+	/* honor %> item */
+	if (fmt_ptr->conthere)
+	    qs->qs_fmt_start = fmt_ptr;
 
-	    if (vim_strchr((char_u *)"AEWI", idx) != NULL)
+	if (vim_strchr((char_u *)"AEWI", idx) != NULL)
+	{
+	    qs->qs_multiline = TRUE;	/* start of a multi-line message */
+	    qs->qs_multiignore = FALSE;	/* reset continuation */
+	}
+	else if (vim_strchr((char_u *)"CZ", idx) != NULL)
+	{				/* continuation of multi-line msg */
+	    qf_list_T	*qfl = &qi->qf_lists[qi->qf_curlist];
+	    qfline_T	*qfprev;
+
+	    if (qfl->qf_count == 0)
+		return FAIL;
+	    qfprev = QF_ENTRY(qfl, qfl->qf_count);
+	    if (*errmsg && !qs->qs_multiignore)
 	    {
-		multiline = TRUE;	/* start of a multi-line message */
-		multiignore = FALSE;	/* reset continuation */
-	    }
-	    else if (vim_strchr((char_u *)"CZ", idx) != NULL)
-	    {				/* continuation of multi-line msg */
-		if (qfprev == NULL)
-		    goto error2;
-		if (*errmsg && !multiignore)
+		qfblock_T   *qb = qfl->qf_blocks;
+		int	    extra = (int)STRLEN(errmsg) + 1;
+
+		len = (int)STRLEN(qfprev->qf_text);
+		if (qfprev->qf_text + len + 1 == qb->qb_data + qb->qb_used
+				       && qb->qb_used + extra <= qb->qb_size)
 		{
-		    len = (int)STRLEN(qfprev->qf_text);
-		    if ((ptr = alloc((unsigned)(len + STRLEN(errmsg) + 2)))
+		    /* The text is at the end of the last block and there is
+		     * room after it: append the line in place. */
+		    qb->qb_used += extra;
+		    ptr = qfprev->qf_text;
+		}
+		else
+		{
+		    if ((ptr = qf_getroom(qfl, (size_t)(len + extra + 1)))
 								    == NULL)
-			goto error2;
+			return FAIL;
 		    STRCPY(ptr, qfprev->qf_text);
-		    vim_free(qfprev->qf_text);
 		    qfprev->qf_text = ptr;
-		    *(ptr += len) = '\n';
-		    STRCPY(++ptr, errmsg);
 		}
-		if (qfprev->qf_nr == -1)
-		    qfprev->qf_nr = enr;
-		if (vim_isprintc(type) && !qfprev->qf_type)
-		    qfprev->qf_type = type;  /* only printable chars allowed */
-		if (!qfprev->qf_lnum)
-		    qfprev->qf_lnum = lnum;
-		if (!qfprev->qf_col)
-		    qfprev->qf_col = col;
-		qfprev->qf_viscol = use_viscol;
-		if (!qfprev->qf_fnum)
-		    qfprev->qf_fnum = qf_get_fnum(directory,
-					*namebuf || directory ? namebuf
-					  : currfile && valid ? currfile : 0);
-		if (idx == 'Z')
-		    multiline = multiignore = FALSE;
-		line_breakcheck();
-		continue;
+		*(ptr += len) = '\n';
+		STRCPY(++ptr, errmsg);
 	    }
-	    else if (vim_strchr((char_u *)"OPQ", idx) != NULL)
+	    if (qfprev->qf_nr == -1)
+		qfprev->qf_nr = enr;
+	    if (vim_isprintc(type) && !qfprev->qf_type)
+		qfprev->qf_type = type;  /* only printable chars allowed */
+	    if (!qfprev->qf_lnum)
+		qfprev->qf_lnum = lnum;
+	    if (!qfprev->qf_col)
+		qfprev->qf_col = col;
+	    qfprev->qf_viscol = use_viscol;
+	    if (!qfprev->qf_fnum)
+		qfprev->qf_fnum = qf_get_fnum(qs->qs_directory,
+				*namebuf || qs->qs_directory ? namebuf
+				  : qs->qs_currfile && valid ? qs->qs_currfile
+									 : 0);
+	    if (idx == 'Z')
+		qs->qs_multiline = qs->qs_multiignore = FALSE;
+	    return OK;
+	}
+	else if (vim_strchr((char_u *)"OPQ", idx) != NULL)
+	{
+	    /* global file names */
+	    valid = FALSE;
+	    if (*namebuf == NUL || mch_getperm(namebuf) >= 0)
 	    {
-		/* global file names */
-		valid = FALSE;
-		if (*namebuf == NUL || mch_getperm(namebuf) >= 0)
+		if (*namebuf && idx == 'P')
+		    qs->qs_currfile = qf_push_dir(namebuf, &qs->qs_file_stack);
+		else if (idx == 'Q')
+		    qs->qs_currfile = qf_pop_dir(&qs->qs_file_stack);
+		*namebuf = NUL;
+		if (tail && *tail)
 		{
-		    if (*namebuf && idx == 'P')
-			currfile = qf_push_dir(namebuf, &file_stack);
-		    else if (idx == 'Q')
-			currfile = qf_pop_dir(&file_stack);
-		    *namebuf = NUL;
-		    if (tail && *tail)
-		    {
-			STRMOVE(IObuff, skipwhite(tail));
-			multiscan = TRUE;
-			goto restofline;
-		    }
+		    STRMOVE(IObuff, skipwhite(tail));
+		    multiscan = TRUE;
+		    goto restofline;
 		}
 	    }
-	    if (fmt_ptr->flags == '-')	/* generally exclude this line */
-	    {
-		if (multiline)
-		    multiignore = TRUE;	/* also exclude continuation lines */
-		continue;
-	    }
 	}
-
-	if (qf_add_entry(qi, &qfprev,
-			directory,
-			(*namebuf || directory)
-			    ? namebuf
-			    : ((currfile && valid) ? currfile : (char_u *)NULL),
-			0,
-			errmsg,
-			lnum,
-			col,
-			use_viscol,
-			pattern,
-			enr,
-			type,
-			valid) == FAIL)
-	    goto error2;
-	line_breakcheck();
+	if (fmt_ptr->flags == '-')	/* generally exclude this line */
+	{
+	    if (qs->qs_multiline)
+		qs->qs_multiignore = TRUE; /* also exclude continuation lines */
+	    return OK;
+	}
     }
-    if (fd == NULL || !ferror(fd))
+
+    return qf_add_entry(qi,
+		    qs->qs_directory,
+		    (*namebuf || qs->qs_directory)
+			? namebuf
+			: ((qs->qs_currfile && valid) ? qs->qs_currfile
+							     : (char_u *)NULL),
+		    0,
+		    errmsg,
+		    lnum,
+		    col,
+		    use_viscol,
+		    pattern,
+		    enr,
+		    type,
+		    valid);
+}
+
+/*
+ * Finish parsing with "qs".  When "ok" is FALSE there was an error and the
+ * list is dropped.
+ * Return -1 for error, number of errors for success.
+ */
+    static int
+qf_state_done(qs, ok)
+    qfstate_T	*qs;
+    int		ok;
+{
+    qf_info_T	*qi = qs->qs_qi;
+    int		retval = -1;
+
+    if (ok)
     {
 	if (qi->qf_lists[qi->qf_curlist].qf_index == 0)
 	{
 	    /* no valid entry found */
-	    qi->qf_lists[qi->qf_curlist].qf_ptr =
-		qi->qf_lists[qi->qf_curlist].qf_start;
 	    qi->qf_lists[qi->qf_curlist].qf_index = 1;
 	    qi->qf_lists[qi->qf_curlist].qf_nonevalid = TRUE;
 	}
 	else
-	{
 	    qi->qf_lists[qi->qf_curlist].qf_nonevalid = FALSE;
-	    if (qi->qf_lists[qi->qf_curlist].qf_ptr == NULL)
-		qi->qf_lists[qi->qf_curlist].qf_ptr =
-		    qi->qf_lists[qi->qf_curlist].qf_start;
-	}
 	/* return number of matches */
 	retval = qi->qf_lists[qi->qf_curlist].qf_count;
-	goto qf_init_ok;
     }
-    EMSG(_(e_readerrf));
-error2:
-    qf_free(qi, qi->qf_curlist);
-    qi->qf_listcount--;
-    if (qi->qf_curlist > 0)
-	--qi->qf_curlist;
-qf_init_ok:
-    if (fd != NULL)
-	fclose(fd);
-    for (fmt_ptr = fmt_first; fmt_ptr != NULL; fmt_ptr = fmt_first)
+    else
     {
-	fmt_first = fmt_ptr->next;
-	vim_regfree(fmt_ptr->prog);
-	vim_free(fmt_ptr);
+	qf_free(qi, qi->qf_curlist);
+	qi->qf_listcount--;
+	if (qi->qf_curlist > 0)
+	    --qi->qf_curlist;
     }
-    qf_clean_dir_stack(&dir_stack);
-    qf_clean_dir_stack(&file_stack);
-qf_init_end:
-    vim_free(namebuf);
-    vim_free(errmsg);
-    vim_free(pattern);
-    vim_free(fmtstr);
-
-#ifdef FEAT_WINDOWS
-    qf_update_buffer(qi);
-#endif
 
+    qf_state_free(qs);
     return retval;
 }
 
+/*
+ * Free the memory used by "qs".
+ */
+    static void
+qf_state_free(qs)
+    qfstate_T	*qs;
+{
+    if (qs->qs_fmt_cached)
+	fmt_cache_busy = FALSE;
+    else
+	qf_free_efm(qs->qs_fmt_first);
+    qs->qs_fmt_first = NULL;
+    qs->qs_fmt_cached = FALSE;
+    qf_clean_dir_stack(&dir_stack);
+    qf_clean_dir_stack(&qs->qs_file_stack);
+    vim_free(qs->qs_namebuf);
+    vim_free(qs->qs_errmsg);
+    vim_free(qs->qs_pattern);
+}
+
     static void
 qf_store_title(qi, title)
     qf_info_T	*qi;
@@ -936,6 +1361,7 @@ qf_new_list(qi, qf_title)
     else
 	qi->qf_curlist = qi->qf_listcount++;
     vim_memset(&qi->qf_lists[qi->qf_curlist], 0, (size_t)(sizeof(qf_list_T)));
+    qi->qf_lists[qi->qf_curlist].qf_id = ++last_qf_id;
     qf_store_title(qi, qf_title);
 }
 
@@ -978,9 +1404,69 @@ qf_free_all(wp)
 	ll_free_all(&wp->w_llist_ref);
     }
     else
+    {
 	/* quickfix list */
 	for (i = 0; i < qi->qf_listcount; ++i)
 	    qf_free(qi, i);
+	if (!fmt_cache_busy)
+	{
+	    qf_free_efm(fmt_cache);
+	    fmt_cache = NULL;
+	    vim_free(fmt_cache_efm);
+	    fmt_cache_efm = NULL;
+	}
+    }
+}
+
+/*
+ * Get room for "len" bytes in the text blocks of list "qfl".
+ * Returns NULL when out of memory.
+ */
+    static char_u *
+qf_getroom(qfl, len)
+    qf_list_T	*qfl;
+    size_t	len;
+{
+    qfblock_T	*qb = qfl->qf_blocks;
+    long	size;
+    char_u	*p;
+
+    if (qb == NULL || qb->qb_used + (long)len > qb->qb_size)
+    {
+	size = qb == NULL ? QF_BLOCKSIZE_MIN : qb->qb_size * 2;
+	if (size > QF_BLOCKSIZE_MAX)
+	    size = QF_BLOCKSIZE_MAX;
+	if (size < (long)len)
+	    size = (long)len;
+	qb = (qfblock_T *)alloc((unsigned)(sizeof(qfblock_T) + size));
+	if (qb == NULL)
+	    return NULL;
+	qb->qb_next = qfl->qf_blocks;
+	qb->qb_size = size;
+	qb->qb_used = 0;
+	qfl->qf_blocks = qb;
+    }
+
+    p = qb->qb_data + qb->qb_used;
+    qb->qb_used += (long)len;
+    return p;
+}
+
+/*
+ * Make a copy of "s" in the text blocks of list "qfl".
+ * Returns NULL when out of memory.
+ */
+    static char_u *
+qf_getroom_save(qfl, s)
+    qf_list_T	*qfl;
+    char_u	*s;
+{
+    char_u	*sc;
+
+    sc = qf_getroom(qfl, STRLEN(s) + 1);
+    if (sc != NULL)
+	STRCPY(sc, s);
+    return sc;
 }
 
 /*
@@ -988,10 +1474,9 @@ qf_free_all(wp)
  * Returns OK or FAIL.
  */
     static int
-qf_add_entry(qi, prevp, dir, fname, bufnum, mesg, lnum, col, vis_col, pattern,
+qf_add_entry(qi, dir, fname, bufnum, mesg, lnum, col, vis_col, pattern,
 	     nr, type, valid)
     qf_info_T	*qi;		/* quickfix list */
-    qfline_T	**prevp;	/* pointer to previously added entry or NULL */
     char_u	*dir;		/* optional directory name */
     char_u	*fname;		/* file name or NULL */
     int		bufnum;		/* buffer number or zero */
@@ -1004,58 +1489,53 @@ qf_add_entry(qi, prevp, dir, fname, bufnum, mesg, lnum, col, vis_col, pattern,
     int		type;		/* type character */
     int		valid;		/* valid entry */
 {
+    qf_list_T	*qfl = &qi->qf_lists[qi->qf_curlist];
     qfline_T	*qfp;
+    int		fnum;
+    char_u	*text;
+    char_u	*pat = NULL;
 
-    if ((qfp = (qfline_T *)alloc((unsigned)sizeof(qfline_T))) == NULL)
-	return FAIL;
     if (bufnum != 0)
-	qfp->qf_fnum = bufnum;
+	fnum = bufnum;
     else
-	qfp->qf_fnum = qf_get_fnum(dir, fname);
-    if ((qfp->qf_text = vim_strsave(mesg)) == NULL)
-    {
-	vim_free(qfp);
+	fnum = qf_get_fnum(dir, fname);
+    if ((text = qf_getroom_save(qfl, mesg)) == NULL)
 	return FAIL;
+    if (pattern != NULL && *pattern != NUL
+			       && (pat = qf_getroom_save(qfl, pattern)) == NULL)
+	return FAIL;
+
+    if (qfl->qf_count == qfl->qf_maxcount)
+    {
+	int	newmax = qfl->qf_maxcount == 0 ? 100 : qfl->qf_maxcount * 2;
+	size_t	newsize = newmax * sizeof(qfline_T);
+
+	/* Double the size of the array, so that adding many entries only
+	 * moves it a few times. */
+	qfp = (qfline_T *)(qfl->qf_lines == NULL ? alloc((unsigned)newsize)
+				       : vim_realloc(qfl->qf_lines, newsize));
+	if (qfp == NULL)
+	    return FAIL;
+	qfl->qf_lines = qfp;
+	qfl->qf_maxcount = newmax;
     }
+
+    qfp = &qfl->qf_lines[qfl->qf_count++];
+    qfp->qf_fnum = fnum;
+    qfp->qf_text = text;
     qfp->qf_lnum = lnum;
     qfp->qf_col = col;
     qfp->qf_viscol = vis_col;
-    if (pattern == NULL || *pattern == NUL)
-	qfp->qf_pattern = NULL;
-    else if ((qfp->qf_pattern = vim_strsave(pattern)) == NULL)
-    {
-	vim_free(qfp->qf_text);
-	vim_free(qfp);
-	return FAIL;
-    }
+    qfp->qf_pattern = pat;
     qfp->qf_nr = nr;
     if (type != 1 && !vim_isprintc(type)) /* only printable chars allowed */
 	type = 0;
     qfp->qf_type = type;
     qfp->qf_valid = valid;
-
-    if (qi->qf_lists[qi->qf_curlist].qf_count == 0)
-				/* first element in the list */
-    {
-	qi->qf_lists[qi->qf_curlist].qf_start = qfp;
-	qfp->qf_prev = qfp;	/* first element points to itself */
-    }
-    else
-    {
-	qfp->qf_prev = *prevp;
-	(*prevp)->qf_next = qfp;
-    }
-    qfp->qf_next = qfp;	/* last element points to itself */
     qfp->qf_cleared = FALSE;
-    *prevp = qfp;
-    ++qi->qf_lists[qi->qf_curlist].qf_count;
-    if (qi->qf_lists[qi->qf_curlist].qf_index == 0 && qfp->qf_valid)
-				/* first valid entry */
-    {
-	qi->qf_lists[qi->qf_curlist].qf_index =
-	    qi->qf_lists[qi->qf_curlist].qf_count;
-	qi->qf_lists[qi->qf_curlist].qf_ptr = qfp;
-    }
+    if (qfl->qf_index == 0 && qfp->qf_valid)
+	/* first valid entry */
+	qfl->qf_index = qfl->qf_count;
 
     return OK;
 }
@@ -1147,8 +1627,7 @@ copy_loclist(from, to)
 	to_qfl->qf_nonevalid = from_qfl->qf_nonevalid;
 	to_qfl->qf_count = 0;
 	to_qfl->qf_index = 0;
-	to_qfl->qf_start = NULL;
-	to_qfl->qf_ptr = NULL;
+	to_qfl->qf_id = ++last_qf_id;
 	if (from_qfl->qf_title != NULL)
 	    to_qfl->qf_title = vim_strsave(from_qfl->qf_title);
 	else
@@ -1157,13 +1636,13 @@ copy_loclist(from, to)
 	if (from_qfl->qf_count)
 	{
 	    qfline_T    *from_qfp;
-	    qfline_T    *prevp = NULL;
+	    qfline_T    *to_qfp;
 
 	    /* copy all the location entries in this list */
-	    for (i = 0, from_qfp = from_qfl->qf_start; i < from_qfl->qf_count;
-		 ++i, from_qfp = from_qfp->qf_next)
+	    for (i = 1; i <= from_qfl->qf_count; ++i)
 	    {
-		if (qf_add_entry(to->w_llist, &prevp,
+		from_qfp = QF_ENTRY(from_qfl, i);
+		if (qf_add_entry(to->w_llist,
 				 NULL,
 				 NULL,
 				 0,
@@ -1184,22 +1663,18 @@ copy_loclist(from, to)
 		 * directory and file names are not supplied. So the qf_fnum
 		 * field is copied here.
 		 */
-		prevp->qf_fnum = from_qfp->qf_fnum; /* file number */
-		prevp->qf_type = from_qfp->qf_type; /* error type */
-		if (from_qfl->qf_ptr == from_qfp)
-		    to_qfl->qf_ptr = prevp;	    /* current location */
+		to_qfp = QF_ENTRY(to_qfl, i);
+		to_qfp->qf_fnum = from_qfp->qf_fnum; /* file number */
+		to_qfp->qf_type = from_qfp->qf_type; /* error type */
 	    }
 	}
 
 	to_qfl->qf_index = from_qfl->qf_index;	/* current index in the list */
 
-	/* When no valid entries are present in the list, qf_ptr points to
-	 * the first item in the list */
+	/* When no valid entries are present in the list, the first item in
+	 * the list is the current one */
 	if (to_qfl->qf_nonevalid)
-	{
-	    to_qfl->qf_ptr = to_qfl->qf_start;
 	    to_qfl->qf_index = 1;
-	}
     }
 
     to->w_llist->qf_curlist = qi->qf_curlist;	/* current list */
@@ -1246,12 +1721,41 @@ qf_get_fnum(directory, fname)
 		    ptr = vim_strsave(fname);
 	    }
 	    /* Use concatenated directory name and file name */
-	    fnum = buflist_add(ptr, 0);
+	    fnum = qf_buflist_add(ptr);
 	    vim_free(ptr);
 	    return fnum;
 	}
+	return qf_buflist_add(fname);
+    }
+}
+
+/*
+ * Add file "fname" to the buffer list.  While the errorfile is parsed with
+ * autocommands blocked remember the buffer, so that the BufNew and BufAdd
+ * autocommands can be triggered later.
+ * Returns the buffer number.
+ */
+    static int
+qf_buflist_add(fname)
+    char_u	*fname;
+{
+    buf_T	*buf;
+    int		fnum;
+
+    if (!qf_stream.qst_blocked)
 	return buflist_add(fname, 0);
+
+    buf = buflist_findname_exp(fname);
+    fnum = buflist_add(fname, 0);
+    if (fnum != 0 && (buf == NULL || !buf->b_p_bl))
+    {
+	garray_T    *gap = buf == NULL ? &qf_stream.qst_newbufs
+					     : &qf_stream.qst_listedbufs;
+
+	if (ga_grow(gap, 1) == OK)
+	    ((int *)gap->ga_data)[gap->ga_len++] = fnum;
     }
+    return fnum;
 }
 
 /*
@@ -1452,6 +1956,7 @@ qf_jump(qi, dir, errornr, forceit)
     qf_info_T		*ll_ref;
     qfline_T		*qf_ptr;
     qfline_T		*old_qf_ptr;
+    qfline_T		qf_entry;
     int			qf_index;
     int			old_qf_fnum;
     int			old_qf_index;
@@ -1491,10 +1996,9 @@ qf_jump(qi, dir, errornr, forceit)
 	return;
     }
 
-    qf_ptr = qi->qf_lists[qi->qf_curlist].qf_ptr;
-    old_qf_ptr = qf_ptr;
     qf_index = qi->qf_lists[qi->qf_curlist].qf_index;
     old_qf_index = qf_index;
+    qf_ptr = QF_ENTRY(&qi->qf_lists[qi->qf_curlist], qf_index);
     if (dir == FORWARD || dir == FORWARD_FILE)	    /* next valid entry */
     {
 	while (errornr--)
@@ -1504,8 +2008,7 @@ qf_jump(qi, dir, errornr, forceit)
 	    old_qf_fnum = qf_ptr->qf_fnum;
 	    do
 	    {
-		if (qf_index == qi->qf_lists[qi->qf_curlist].qf_count
-						   || qf_ptr->qf_next == NULL)
+		if (qf_index == qi->qf_lists[qi->qf_curlist].qf_count)
 		{
 		    qf_ptr = old_qf_ptr;
 		    qf_index = prev_index;
@@ -1518,7 +2021,7 @@ qf_jump(qi, dir, errornr, forceit)
 		    break;
 		}
 		++qf_index;
-		qf_ptr = qf_ptr->qf_next;
+		++qf_ptr;
 	    } while ((!qi->qf_lists[qi->qf_curlist].qf_nonevalid
 		      && !qf_ptr->qf_valid)
 		  || (dir == FORWARD_FILE && qf_ptr->qf_fnum == old_qf_fnum));
@@ -1534,7 +2037,7 @@ qf_jump(qi, dir, errornr, forceit)
 	    old_qf_fnum = qf_ptr->qf_fnum;
 	    do
 	    {
-		if (qf_index == 1 || qf_ptr->qf_prev == NULL)
+		if (qf_index == 1)
 		{
 		    qf_ptr = old_qf_ptr;
 		    qf_index = prev_index;
@@ -1547,7 +2050,7 @@ qf_jump(qi, dir, errornr, forceit)
 		    break;
 		}
 		--qf_index;
-		qf_ptr = qf_ptr->qf_prev;
+		--qf_ptr;
 	    } while ((!qi->qf_lists[qi->qf_curlist].qf_nonevalid
 		      && !qf_ptr->qf_valid)
 		  || (dir == BACKWARD_FILE && qf_ptr->qf_fnum == old_qf_fnum));
@@ -1556,20 +2059,19 @@ qf_jump(qi, dir, errornr, forceit)
     }
     else if (errornr != 0)	/* go to specified number */
     {
-	while (errornr < qf_index && qf_index > 1 && qf_ptr->qf_prev != NULL)
-	{
-	    --qf_index;
-	    qf_ptr = qf_ptr->qf_prev;
-	}
-	while (errornr > qf_index && qf_index <
-				    qi->qf_lists[qi->qf_curlist].qf_count
-						   && qf_ptr->qf_next != NULL)
-	{
-	    ++qf_index;
-	    qf_ptr = qf_ptr->qf_next;
-	}
+	if (errornr < 1)
+	    qf_index = 1;
+	else if (errornr > qi->qf_lists[qi->qf_curlist].qf_count)
+	    qf_index = qi->qf_lists[qi->qf_curlist].qf_count;
+	else
+	    qf_index = errornr;
     }
 
+    /* Autocommands may add errors to the list, which can move the array.
+     * Use a copy of the entry from here on. */
+    qf_entry = *QF_ENTRY(&qi->qf_lists[qi->qf_curlist], qf_index);
+    qf_ptr = &qf_entry;
+
 #ifdef FEAT_WINDOWS
     qi->qf_lists[qi->qf_curlist].qf_index = qf_index;
     if (qf_win_pos_update(qi, old_qf_index))
@@ -1926,12 +2428,10 @@ win_found:
 #ifdef FEAT_WINDOWS
 failed:
 #endif
-	    qf_ptr = old_qf_ptr;
 	    qf_index = old_qf_index;
 	}
     }
 theend:
-    qi->qf_lists[qi->qf_curlist].qf_ptr = qf_ptr;
     qi->qf_lists[qi->qf_curlist].qf_index = qf_index;
 #ifdef FEAT_WINDOWS
     if (p_swb != old_swb && opened_window)
@@ -1997,9 +2497,9 @@ qf_list(eap)
 
     if (qi->qf_lists[qi->qf_curlist].qf_nonevalid)
 	all = TRUE;
-    qfp = qi->qf_lists[qi->qf_curlist].qf_start;
     for (i = 1; !got_int && i <= qi->qf_lists[qi->qf_curlist].qf_count; )
     {
+	qfp = QF_ENTRY(&qi->qf_lists[qi->qf_curlist], i);
 	if ((qfp->qf_valid || all) && idx1 <= i && i <= idx2)
 	{
 	    msg_putchar('\n');
@@ -2049,7 +2549,6 @@ qf_list(eap)
 	    out_flush();		/* show one line at a time */
 	}
 
-	qfp = qfp->qf_next;
 	++i;
 	ui_breakcheck();
     }
@@ -2154,26 +2653,18 @@ qf_free(qi, idx)
     qf_info_T	*qi;
     int		idx;
 {
-    qfline_T	*qfp;
-    int		stop = FALSE;
-
-    while (qi->qf_lists[idx].qf_count)
+    qf_list_T	*qfl = &qi->qf_lists[idx];
+    qfblock_T	*qb;
+
+    vim_free(qfl->qf_lines);
+    qfl->qf_lines = NULL;
+    qfl->qf_maxcount = 0;
+    qfl->qf_count = 0;
+    while (qfl->qf_blocks != NULL)
     {
-	qfp = qi->qf_lists[idx].qf_start->qf_next;
-	if (qi->qf_lists[idx].qf_title != NULL && !stop)
-	{
-	    vim_free(qi->qf_lists[idx].qf_start->qf_text);
-	    stop = (qi->qf_lists[idx].qf_start == qfp);
-	    vim_free(qi->qf_lists[idx].qf_start->qf_pattern);
-	    vim_free(qi->qf_lists[idx].qf_start);
-	    if (stop)
-		/* Somehow qf_count may have an incorrect value, set it to 1
-		 * to avoid crashing when it's wrong.
-		 * TODO: Avoid qf_count being incorrect. */
-		qi->qf_lists[idx].qf_count = 1;
-	}
-	qi->qf_lists[idx].qf_start = qfp;
-	--qi->qf_lists[idx].qf_count;
+	qb = qfl->qf_blocks;
+	qfl->qf_blocks = qb->qb_next;
+	vim_free(qb);
     }
     vim_free(qi->qf_lists[idx].qf_title);
     qi->qf_lists[idx].qf_title = NULL;
@@ -2204,21 +2695,20 @@ qf_mark_adjust(wp, line1, line2, amount, amount_after)
     }
 
     for (idx = 0; idx < qi->qf_listcount; ++idx)
-	if (qi->qf_lists[idx].qf_count)
-	    for (i = 0, qfp = qi->qf_lists[idx].qf_start;
-		       i < qi->qf_lists[idx].qf_count; ++i, qfp = qfp->qf_next)
-		if (qfp->qf_fnum == curbuf->b_fnum)
+	for (i = 0, qfp = qi->qf_lists[idx].qf_lines;
+				    i < qi->qf_lists[idx].qf_count; ++i, ++qfp)
+	    if (qfp->qf_fnum == curbuf->b_fnum)
+	    {
+		if (qfp->qf_lnum >= line1 && qfp->qf_lnum <= line2)
 		{
-		    if (qfp->qf_lnum >= line1 && qfp->qf_lnum <= line2)
-		    {
-			if (amount == MAXLNUM)
-			    qfp->qf_cleared = TRUE;
-			else
-			    qfp->qf_lnum += amount;
-		    }
-		    else if (amount_after && qfp->qf_lnum > line2)
-			qfp->qf_lnum += amount_after;
+		    if (amount == MAXLNUM)
+			qfp->qf_cleared = TRUE;
+		    else
+			qfp->qf_lnum += amount;
 		}
+		else if (amount_after && qfp->qf_lnum > line2)
+		    qfp->qf_lnum += amount_after;
+	    }
 }
 
 /*
@@ -2655,7 +3145,7 @@ qf_fill_buffer(qi)
     if (qi->qf_curlist < qi->qf_listcount)
     {
 	/* Add one line for each error */
-	qfp = qi->qf_lists[qi->qf_curlist].qf_start;
+	qfp = qi->qf_lists[qi->qf_curlist].qf_lines;
 	for (lnum = 0; lnum < qi->qf_lists[qi->qf_curlist].qf_count; ++lnum)
 	{
 	    if (qfp->qf_fnum != 0
@@ -2704,7 +3194,7 @@ qf_fill_buffer(qi)
 	    if (ml_append(lnum, IObuff, (colnr_T)STRLEN(IObuff) + 1, FALSE)
 								      == FAIL)
 		break;
-	    qfp = qfp->qf_next;
+	    ++qfp;
 	}
 	/* Delete the empty line which is now at the end */
 	(void)ml_delete(lnum + 1, FALSE);
@@ -2828,6 +3318,9 @@ ex_make(eap)
     win_T	*wp = NULL;
     qf_info_T	*qi = &ql_info;
     int		res;
+    char_u	*efm;
+    int		newlist;
+    int		streaming;
 #ifdef FEAT_AUTOCMD
     char_u	*au_name = NULL;
 
@@ -2892,6 +3385,14 @@ ex_make(eap)
     MSG_PUTS(":!");
     msg_outtrans(cmd);		/* show what we are doing */
 
+    efm = (eap->cmdidx != CMD_make && eap->cmdidx != CMD_lmake)
+							     ? p_gefm : p_efm;
+    newlist = (eap->cmdidx != CMD_grepadd && eap->cmdidx != CMD_lgrepadd);
+
+    /* Parse the errorfile while the command is writing it. */
+    streaming = *p_sp != NUL
+	       && qf_stream_start(wp, fname, efm, newlist, *eap->cmdlinep) == OK;
+
     /* let the shell know if we are redirecting output or not */
     do_shell(cmd, *p_sp != NUL ? SHELL_DOOUT : 0);
 
@@ -2901,11 +3402,10 @@ ex_make(eap)
     (void)char_avail();
 #endif
 
-    res = qf_init(wp, fname, (eap->cmdidx != CMD_make
-			    && eap->cmdidx != CMD_lmake) ? p_gefm : p_efm,
-					   (eap->cmdidx != CMD_grepadd
-					    && eap->cmdidx != CMD_lgrepadd),
-					   *eap->cmdlinep);
+    if (streaming)
+	res = qf_stream_finish();
+    else
+	res = qf_init(wp, fname, efm, newlist, *eap->cmdlinep);
     if (wp != NULL)
 	qi = GET_LOC_LIST(wp);
 #ifdef FEAT_AUTOCMD
@@ -2927,6 +3427,249 @@ ex_make(eap)
     vim_free(cmd);
 }
 
+#define QF_STREAM_READ 8192	/* bytes read from the errorfile at a time */
+
+/*
+ * Prepare for parsing errorfile "fname" of ":make" while the command is
+ * running, see qf_stream_poll().  The other arguments are as for qf_init().
+ * Returns FAIL when this is not possible, errors are given when the
+ * errorfile is parsed with qf_init() later.
+ */
+    static int
+qf_stream_start(wp, fname, errorformat, newlist, qf_title)
+    win_T	*wp;
+    char_u	*fname;
+    char_u	*errorformat;
+    int		newlist;
+    char_u	*qf_title;
+{
+    qf_info_T	*qi = &ql_info;
+    char_u	*efm;
+    int		r;
+
+    if (wp != NULL)
+    {
+	qi = ll_get_or_alloc_list(wp);
+	if (qi == NULL)
+	    return FAIL;
+    }
+
+    /* Use the local value of 'errorformat' if it's set. */
+    if (errorformat == p_efm && *curbuf->b_p_efm != NUL)
+	efm = curbuf->b_p_efm;
+    else
+	efm = errorformat;
+    ++emsg_off;
+    r = qf_state_init(&qf_stream.qst_state, qi, efm);
+    --emsg_off;
+    if (r == FAIL)
+	return FAIL;
+
+    qf_stream.qst_fname = fname;
+    qf_stream.qst_fd = -1;
+    qf_stream.qst_newlist = newlist;
+    qf_stream.qst_title = qf_title;
+    qf_stream.qst_stopped = FALSE;
+    ga_init2(&qf_stream.qst_pending, 1, QF_STREAM_READ);
+    ga_init2(&qf_stream.qst_newbufs, (int)sizeof(int), 10);
+    ga_init2(&qf_stream.qst_listedbufs, (int)sizeof(int), 10);
+    qf_stream.qst_active = TRUE;
+    return OK;
+}
+
+/*
+ * Read what was added to the errorfile of ":make" and parse the complete
+ * lines.  When "final" is TRUE the command has finished, also parse an
+ * incomplete last line.
+ * Returns FAIL when parsing a line failed, the line is kept then.
+ */
+    static int
+qf_stream_read(final)
+    int		final;
+{
+    garray_T	*gap = &qf_stream.qst_pending;
+    char_u	*p;
+    char_u	*end;
+    char_u	*nl;
+    long	n;
+    int		len;
+    int		eof = FALSE;
+    int		retval = OK;
+
+    if (qf_stream.qst_fd < 0)
+    {
+	qf_stream.qst_fd = mch_open((char *)qf_stream.qst_fname,
+						       O_RDONLY | O_EXTRA, 0);
+	if (qf_stream.qst_fd < 0)
+	{
+	    if (final)
+	    {
+		EMSG2(_(e_openerrf), qf_stream.qst_fname);
+		return FAIL;
+	    }
+	    return OK;		/* not created yet */
+	}
+	qf_state_newlist(&qf_stream.qst_state, qf_stream.qst_newlist,
+							 qf_stream.qst_title);
+    }
+
+    while (!eof && retval == OK)
+    {
+	if (ga_grow(gap, QF_STREAM_READ) == FAIL)
+	    return FAIL;
+	n = read_eintr(qf_stream.qst_fd, (char_u *)gap->ga_data + gap->ga_len,
+							      QF_STREAM_READ);
+	if (n < 0)
+	{
+	    if (final)
+		EMSG(_(e_readerrf));
+	    return FAIL;
+	}
+	if (n == 0)
+	{
+	    if (!final)
+		break;
+	    eof = TRUE;
+	}
+	gap->ga_len += n;
+
+	/* Split the text in lines the same way as fgets() in qf_init_ext()
+	 * does. */
+	p = (char_u *)gap->ga_data;
+	end = p + gap->ga_len;
+	while (p < end)
+	{
+	    len = end - p < CMDBUFFSIZE - 3 ? (int)(end - p) : CMDBUFFSIZE - 3;
+	    nl = memchr(p, '\n', (size_t)len);
+	    if (nl != NULL)
+		len = (int)(nl - p) + 1;
+	    else if (len < CMDBUFFSIZE - 3 && !eof)
+		break;		/* incomplete line */
+	    mch_memmove(IObuff, p, (size_t)len);
+	    IObuff[len] = NUL;
+	    if (qf_parse_line(&qf_stream.qst_state) == FAIL)
+	    {
+		retval = FAIL;
+		break;
+	    }
+	    p += len;
+	    if (final)
+	    {
+		line_breakcheck();
+		if (got_int)
+		{
+		    eof = TRUE;
+		    break;
+		}
+	    }
+	}
+	gap->ga_len -= (int)(p - (char_u *)gap->ga_data);
+	mch_memmove(gap->ga_data, p, (size_t)gap->ga_len);
+    }
+    return retval;
+}
+
+/*
+ * Called while the ":make" command is running: parse what it has written to
+ * the errorfile so far.  Autocommands are blocked and errors not given,
+ * when a line can't be parsed it is done again when the command finished.
+ */
+    void
+qf_stream_poll()
+{
+    if (!qf_stream.qst_active || qf_stream.qst_stopped || got_int)
+	return;
+
+#ifdef FEAT_AUTOCMD
+    block_autocmds();
+#endif
+    ++emsg_off;
+    qf_stream.qst_blocked = TRUE;
+    if (qf_stream_read(FALSE) == FAIL)
+	qf_stream.qst_stopped = TRUE;
+    qf_stream.qst_blocked = FALSE;
+    --emsg_off;
+#ifdef FEAT_AUTOCMD
+    unblock_autocmds();
+#endif
+}
+
+/*
+ * Called when the ":make" command has finished: parse the rest of the
+ * errorfile and trigger the autocommands that were blocked.
+ * Return -1 for error, number of errors for success.
+ */
+    static int
+qf_stream_finish()
+{
+    qf_info_T	*qi = qf_stream.qst_state.qs_qi;
+    int		ok;
+    int		retval = -1;
+    garray_T	newbufs;
+    garray_T	listedbufs;
+#ifdef FEAT_AUTOCMD
+    buf_T	*buf;
+    int		i;
+#endif
+
+    qf_stream.qst_active = FALSE;
+
+    /*
+     * got_int is reset here, because it was probably set when killing the
+     * ":make" command, but we still want to read the errorfile then.
+     */
+    got_int = FALSE;
+
+    /* Autocommands are also blocked for the last lines, they are triggered
+     * when qf_stream is not used anymore.  They may execute ":make". */
+#ifdef FEAT_AUTOCMD
+    block_autocmds();
+#endif
+    qf_stream.qst_blocked = TRUE;
+    ok = qf_stream_read(TRUE) == OK;
+    qf_stream.qst_blocked = FALSE;
+#ifdef FEAT_AUTOCMD
+    unblock_autocmds();
+#endif
+    if (qf_stream.qst_fd < 0)
+	/* errorfile was not created */
+	qf_state_free(&qf_stream.qst_state);
+    else
+    {
+	retval = qf_state_done(&qf_stream.qst_state, ok);
+	close(qf_stream.qst_fd);
+    }
+    ga_clear(&qf_stream.qst_pending);
+    newbufs = qf_stream.qst_newbufs;
+    listedbufs = qf_stream.qst_listedbufs;
+    vim_memset(&qf_stream, 0, sizeof(qfstream_T));
+    qf_stream.qst_fd = -1;
+
+#ifdef FEAT_WINDOWS
+    qf_update_buffer(qi);
+#endif
+
+#ifdef FEAT_AUTOCMD
+    for (i = 0; i < newbufs.ga_len; ++i)
+    {
+	buf = buflist_findnr(((int *)newbufs.ga_data)[i]);
+	if (buf != NULL)
+	    apply_autocmds(EVENT_BUFNEW, NULL, NULL, FALSE, buf);
+	if (buf != NULL && buf_valid(buf) && buf->b_p_bl)
+	    apply_autocmds(EVENT_BUFADD, NULL, NULL, FALSE, buf);
+    }
+    for (i = 0; i < listedbufs.ga_len; ++i)
+    {
+	buf = buflist_findnr(((int *)listedbufs.ga_data)[i]);
+	if (buf != NULL && buf->b_p_bl)
+	    apply_autocmds(EVENT_BUFADD, NULL, NULL, FALSE, buf);
+    }
+#endif
+    ga_clear(&newbufs);
+    ga_clear(&listedbufs);
+    return retval;
+}
+
 /*
  * Return the name for the errorfile, in allocated memory.
  * Find a new unique name when 'makeef' contains "##".
@@ -3136,6 +3879,294 @@ ex_cfile(eap)
     }
 }
 
+/*
+ * Flags for checking a file for ":vimgrep" without loading it into a buffer.
+ */
+#define VGR_SCAN	1	/* the file can be checked */
+#define VGR_SAME_ENC	2	/* non-ASCII text is read without conversion */
+#define VGR_CR_BREAK	4	/* a CR may be a line break */
+
+#define VGR_SCAN_SIZE	65536	/* initial size of the read buffer */
+
+/*
+ * Return VGR_ flags for checking files for pattern "prog" without loading
+ * them.  This is only possible when the pattern matches within a line and
+ * does not depend on the buffer, and reading the file keeps ASCII text as it
+ * is.  Returns zero when files must be loaded.
+ */
+    static int
+vgr_scan_flags(prog)
+    regprog_T	*prog;
+{
+    int		flags = VGR_SCAN | VGR_SAME_ENC;
+    long	n;
+    char_u	*s = NULL;
+    int		same;
+#ifdef FEAT_MBYTE
+    char_u	*p;
+    char_u	*name;
+    char_u	buf[100];
+    int		first = TRUE;
+    int		props;
+#endif
+
+#if !defined(FEAT_EVAL) && !defined(FEAT_TCL) && !defined(FEAT_MZSCHEME)
+    /* Cannot get the global option values. */
+    return 0;
+#else
+    if (re_multiline(prog) || re_position(prog))
+	return 0;
+
+# if defined(FEAT_AUTOCMD) && !defined(FEAT_SYN_HL)
+    /* FileType autocommands are not ignored when loading the file, they may
+     * change options such as 'iskeyword'. */
+    if (has_filetype_autocmd())
+	return 0;
+# endif
+
+    /* A new buffer uses the global 'iskeyword', the pattern is checked in
+     * the current buffer. */
+    if (get_option_value((char_u *)"isk", &n, &s, OPT_GLOBAL) != 0
+								   || s == NULL)
+	return 0;
+    same = STRCMP(s, curbuf->b_p_isk) == 0;
+    vim_free(s);
+    if (!same)
+	return 0;
+
+    s = NULL;
+    if (*p_ffs != NUL)
+    {
+	if (vim_strchr(p_ffs, 'm') != NULL)
+	    flags |= VGR_CR_BREAK;
+    }
+    else if (get_option_value((char_u *)"ff", &n, &s, OPT_GLOBAL) == 0
+							       && s != NULL)
+    {
+	if (*s == 'm')
+	    flags |= VGR_CR_BREAK;
+	vim_free(s);
+    }
+
+#ifdef FEAT_MBYTE
+    if (get_option_value((char_u *)"bin", &n, NULL, OPT_GLOBAL) == 1 && n)
+	return flags;
+
+    /* Without 'fileencodings' a new buffer uses the global 'fileencoding'. */
+    s = NULL;
+    p = p_fencs;
+    if (*p == NUL)
+    {
+	if (get_option_value((char_u *)"fenc", &n, &s, OPT_GLOBAL) != 0
+								   || s == NULL)
+	    return 0;
+	p = s;
+    }
+    while (*p != NUL)
+    {
+	(void)copy_option_part(&p, buf, sizeof(buf), ",");
+	name = enc_canonize(buf);
+	if (name == NULL)
+	{
+	    flags = 0;
+	    break;
+	}
+	/* A file with a BOM is not checked. */
+	if (STRCMP(name, "ucs-bom") != 0)
+	{
+	    if (first && STRCMP(name, p_enc) != 0)
+		flags &= ~VGR_SAME_ENC;
+	    first = FALSE;
+	    props = enc_canon_props(name);
+	    if (STRCMP(name, "default") != 0
+		    && (props == 0
+			|| (props & (ENC_2BYTE | ENC_4BYTE | ENC_2WORD))))
+	    {
+		/* unknown encoding or ASCII is converted */
+		vim_free(name);
+		flags = 0;
+		break;
+	    }
+	}
+	vim_free(name);
+    }
+    vim_free(s);
+#endif
+    return flags;
+#endif
+}
+
+/*
+ * Check one line of a file that is not loaded for ":vimgrep".  The line is
+ * from "line" to "end", where "end" can be overwritten.
+ * Returns TRUE when the line matches or it is not known how it would be read
+ * into a buffer.
+ */
+    static int
+vgr_scan_line(rmp, line, end, flags)
+    regmmatch_T	*rmp;
+    char_u	*line;
+    char_u	*end;
+    int		flags;
+{
+    regmatch_T	regmatch;
+    char_u	*p;
+    int		r;
+
+    for (p = line; p < end; ++p)
+    {
+	/* A NUL is read as a NL, CTRL-Z may be removed and a CR may be a line
+	 * break.  Can't tell what the line will look like then. */
+	if (*p == NUL || *p == Ctrl_Z || (*p == CAR && (flags & VGR_CR_BREAK)))
+	    return TRUE;
+	if (*p >= 0x80)
+	{
+	    if (!(flags & VGR_SAME_ENC))
+		return TRUE;
+#ifdef FEAT_MBYTE
+	    if (enc_utf8)
+	    {
+		/* An illegal byte makes Vim try another encoding. */
+		r = utf_ptr2len_len(p, (int)(end - p));
+		if (r == 1 || r > end - p)
+		    return TRUE;
+		p += r - 1;
+	    }
+#endif
+	}
+    }
+
+    regmatch.regprog = rmp->regprog;
+    regmatch.rm_ic = rmp->rmm_ic;
+    *end = NUL;
+    r = vim_regexec(&regmatch, line, (colnr_T)0);
+    if (!r && end > line && end[-1] == CAR)
+    {
+	/* The CR is removed when the 'fileformat' is "dos". */
+	end[-1] = NUL;
+	r = vim_regexec(&regmatch, line, (colnr_T)0);
+    }
+    rmp->regprog = regmatch.regprog;
+    return r;
+}
+
+/*
+ * Check file "fname" for ":vimgrep" without loading it into a buffer.
+ * "flags" is what vgr_scan_flags() returned.
+ * Returns FALSE when no line can match, TRUE when some line may match.
+ */
+    static int
+vgr_scan_file(rmp, fname, flags)
+    regmmatch_T	*rmp;
+    char_u	*fname;
+    int		flags;
+{
+    int		fd;
+    char_u	*buf;
+    char_u	*newbuf;
+    char_u	*start;
+    char_u	*nl;
+    long	size = VGR_SCAN_SIZE;
+    long	len = 0;
+    long	n;
+    int		first = TRUE;
+    int		eof = FALSE;
+    int		result = FALSE;
+
+    if (mch_isdir(fname))
+	return TRUE;
+#ifdef FEAT_AUTOCMD
+    /* Autocommands may read the file in another way, e.g. decompress it,
+     * or change the text or options after reading.  Filetype detection only
+     * sets 'filetype', the FileType event is ignored or checked in
+     * vgr_scan_flags(). */
+    if (has_autocmd(EVENT_BUFREADCMD, fname, NULL)
+	    || has_autocmd(EVENT_BUFREADPRE, fname, NULL)
+	    || has_autocmd_except(EVENT_BUFREADPOST, fname, NULL,
+					       (char_u *)"filetypedetect"))
+	return TRUE;
+#endif
+    fd = mch_open((char *)fname, O_RDONLY | O_EXTRA, 0);
+    if (fd < 0)
+	return TRUE;	/* loading it gives the error message */
+    buf = alloc((unsigned)(size + 1));
+    if (buf == NULL)
+    {
+	close(fd);
+	return TRUE;
+    }
+
+    while (!eof)
+    {
+	n = read_eintr(fd, buf + len, (size_t)(size - len));
+	if (n < 0)
+	{
+	    result = TRUE;
+	    break;
+	}
+	eof = (n == 0);
+	len += n;
+
+	/* A file with a BOM or an encrypted file is not checked. */
+	if (first && len > 0)
+	{
+	    first = FALSE;
+	    if ((len >= 3 && buf[0] == 0xef && buf[1] == 0xbb && buf[2] == 0xbf)
+		    || (len >= 2 && ((buf[0] == 0xfe && buf[1] == 0xff)
+				  || (buf[0] == 0xff && buf[1] == 0xfe)))
+		    || (len >= 9 && STRNCMP(buf, "VimCrypt~", 9) == 0))
+	    {
+		result = TRUE;
+		break;
+	    }
+	}
+
+	/* Check all complete lines, and the last line at the end of the
+	 * file. */
+	for (start = buf; start < buf + len; start = nl + 1)
+	{
+	    nl = (char_u *)memchr(start, NL, (size_t)(buf + len - start));
+	    if (nl == NULL)
+	    {
+		if (!eof)
+		    break;
+		nl = buf + len;
+	    }
+	    if (vgr_scan_line(rmp, start, nl, flags))
+	    {
+		result = TRUE;
+		break;
+	    }
+	}
+	if (result || eof)
+	    break;
+	fast_breakcheck();
+	if (got_int)
+	    break;
+
+	/* Keep the incomplete line, make room when it fills the buffer. */
+	len -= (long)(start - buf);
+	mch_memmove(buf, start, (size_t)len);
+	if (len == size)
+	{
+	    newbuf = alloc((unsigned)(size * 2 + 1));
+	    if (newbuf == NULL)
+	    {
+		result = TRUE;
+		break;
+	    }
+	    mch_memmove(newbuf, buf, (size_t)len);
+	    vim_free(buf);
+	    buf = newbuf;
+	    size *= 2;
+	}
+    }
+
+    vim_free(buf);
+    close(fd);
+    return result;
+}
+
 /*
  * ":vimgrep {pattern} file(s)"
  * ":vimgrepadd {pattern} file(s)"
@@ -3155,9 +4186,8 @@ ex_vimgrep(eap)
     int		fi;
     qf_info_T	*qi = &ql_info;
 #ifdef FEAT_AUTOCMD
-    qfline_T	*cur_qf_start;
+    int		cur_qf_id;
 #endif
-    qfline_T	*prevp = NULL;
     long	lnum;
     buf_T	*buf;
     int		duplicate_name = FALSE;
@@ -3172,6 +4202,7 @@ ex_vimgrep(eap)
 #endif
     aco_save_T	aco;
     int		flags = 0;
+    int		scan_flags;
     colnr_T	col;
     long	tomatch;
     char_u	*dirname_start = NULL;
@@ -3255,11 +4286,6 @@ ex_vimgrep(eap)
 					|| qi->qf_curlist == qi->qf_listcount)
 	/* make place for a new list */
 	qf_new_list(qi, *eap->cmdlinep);
-    else if (qi->qf_lists[qi->qf_curlist].qf_count > 0)
-	/* Adding to existing list, find last entry. */
-	for (prevp = qi->qf_lists[qi->qf_curlist].qf_start;
-			    prevp->qf_next != prevp; prevp = prevp->qf_next)
-	    ;
 
     /* parse the list of arguments */
     if (get_arglist_exp(p, &fcount, &fnames, TRUE) == FAIL)
@@ -3280,11 +4306,14 @@ ex_vimgrep(eap)
     mch_dirname(dirname_start, MAXPATHL);
 
 #ifdef FEAT_AUTOCMD
-     /* Remember the value of qf_start, so that we can check for autocommands
+     /* Remember the value of qf_id, so that we can check for autocommands
       * changing the current quickfix list. */
-    cur_qf_start = qi->qf_lists[qi->qf_curlist].qf_start;
+    cur_qf_id = qi->qf_lists[qi->qf_curlist].qf_id;
 #endif
 
+    /* How files that are not loaded can be checked, see below. */
+    scan_flags = vgr_scan_flags(regmatch.regprog);
+
     seconds = (time_t)0;
     for (fi = 0; fi < fcount && !got_int && tomatch > 0; ++fi)
     {
@@ -3313,6 +4342,12 @@ ex_vimgrep(eap)
 	buf = buflist_findname_exp(fnames[fi]);
 	if (buf == NULL || buf->b_ml.ml_mfp == NULL)
 	{
+	    /* Loading a file into a buffer is slow.  First check the file
+	     * contents, skip the file when no line matches. */
+	    if ((scan_flags & VGR_SCAN)
+			&& !vgr_scan_file(&regmatch, fnames[fi], scan_flags))
+		continue;
+
 	    /* Remember that a buffer with this name already exists. */
 	    duplicate_name = (buf != NULL);
 	    using_dummy = TRUE;
@@ -3332,6 +4367,8 @@ ex_vimgrep(eap)
 	    buf = load_dummy_buffer(fname, dirname_start, dirname_now);
 
 	    p_mls = save_mls;
+	    /* Autocommands may have changed the options. */
+	    scan_flags = vgr_scan_flags(regmatch.regprog);
 #if defined(FEAT_AUTOCMD) && defined(FEAT_SYN_HL)
 	    au_event_restore(save_ei);
 #endif
@@ -3341,14 +4378,14 @@ ex_vimgrep(eap)
 	    using_dummy = FALSE;
 
 #ifdef FEAT_AUTOCMD
-	if (cur_qf_start != qi->qf_lists[qi->qf_curlist].qf_start)
+	if (cur_qf_id != qi->qf_lists[qi->qf_curlist].qf_id)
 	{
 	    int idx;
 
 	    /* Autocommands changed the quickfix list.  Find the one we were
 	     * using and restore it. */
 	    for (idx = 0; idx < LISTCOUNT; ++idx)
-		if (cur_qf_start == qi->qf_lists[idx].qf_start)
+		if (cur_qf_id == qi->qf_lists[idx].qf_id)
 		{
 		    qi->qf_curlist = idx;
 		    break;
@@ -3357,7 +4394,7 @@ ex_vimgrep(eap)
 	    {
 		/* List cannot be found, create a new one. */
 		qf_new_list(qi, *eap->cmdlinep);
-		cur_qf_start = qi->qf_lists[qi->qf_curlist].qf_start;
+		cur_qf_id = qi->qf_lists[qi->qf_curlist].qf_id;
 	    }
 	}
 #endif
@@ -3380,7 +4417,7 @@ ex_vimgrep(eap)
 							       col, NULL) > 0)
 		{
 		    ;
-		    if (qf_add_entry(qi, &prevp,
+		    if (qf_add_entry(qi,
 				NULL,       /* dir */
 				fname,
 				0,
@@ -3413,9 +4450,6 @@ ex_vimgrep(eap)
 		if (got_int)
 		    break;
 	    }
-#ifdef FEAT_AUTOCMD
-	    cur_qf_start = qi->qf_lists[qi->qf_curlist].qf_start;
-#endif
 
 	    if (using_dummy)
 	    {
@@ -3479,7 +4513,6 @@ ex_vimgrep(eap)
     FreeWild(fcount, fnames);
 
     qi->qf_lists[qi->qf_curlist].qf_nonevalid = FALSE;
-    qi->qf_lists[qi->qf_curlist].qf_ptr = qi->qf_lists[qi->qf_curlist].qf_start;
     qi->qf_lists[qi->qf_curlist].qf_index = 1;
 
 #ifdef FEAT_WINDOWS
@@ -3786,7 +4819,7 @@ get_errorlist(wp, list)
 	    || qi->qf_lists[qi->qf_curlist].qf_count == 0)
 	return FAIL;
 
-    qfp = qi->qf_lists[qi->qf_curlist].qf_start;
+    qfp = qi->qf_lists[qi->qf_curlist].qf_lines;
     for (i = 1; !got_int && i <= qi->qf_lists[qi->qf_curlist].qf_count; ++i)
     {
 	/* Handle entries with a non-existing buffer number. */
@@ -3814,7 +4847,7 @@ get_errorlist(wp, list)
 	  || dict_add_nr_str(dict, "valid", (long)qfp->qf_valid, NULL) == FAIL)
 	    return FAIL;
 
-	qfp = qfp->qf_next;
+	++qfp;
     }
     return OK;
 }
@@ -3837,7 +4870,6 @@ set_errorlist(wp, list, action, title)
     long	lnum;
     int		col, nr;
     int		vcol;
-    qfline_T	*prevp = NULL;
     int		valid, status;
     int		retval = OK;
     qf_info_T	*qi = &ql_info;
@@ -3853,11 +4885,6 @@ set_errorlist(wp, list, action, title)
     if (action == ' ' || qi->qf_curlist == qi->qf_listcount)
 	/* make place for a new list */
 	qf_new_list(qi, title);
-    else if (action == 'a' && qi->qf_lists[qi->qf_curlist].qf_count > 0)
-	/* Adding to existing list, find last entry. */
-	for (prevp = qi->qf_lists[qi->qf_curlist].qf_start;
-	     prevp->qf_next != prevp; prevp = prevp->qf_next)
-	    ;
     else if (action == 'r')
     {
 	qf_free(qi, qi->qf_curlist);
@@ -3902,7 +4929,7 @@ set_errorlist(wp, list, action, title)
 	    bufnum = 0;
 	}
 
-	status =  qf_add_entry(qi, &prevp,
+	status =  qf_add_entry(qi,
 			       NULL,	    /* dir */
 			       filename,
 			       bufnum,
@@ -3932,7 +4959,6 @@ set_errorlist(wp, list, action, title)
 	qi->qf_lists[qi->qf_curlist].qf_nonevalid = TRUE;
     else
 	qi->qf_lists[qi->qf_curlist].qf_nonevalid = FALSE;
-    qi->qf_lists[qi->qf_curlist].qf_ptr = qi->qf_lists[qi->qf_curlist].qf_start;
     qi->qf_lists[qi->qf_curlist].qf_index = 1;
 
 #ifdef FEAT_WINDOWS
@@ -4064,7 +5090,6 @@ ex_helpgrep(eap)
     char_u	**fnames;
     FILE	*fd;
     int		fi;
-    qfline_T	*prevp = NULL;
     long	lnum;
 #ifdef FEAT_MULTI_LANG
     char_u	*lang;
@@ -4190,7 +5215,7 @@ ex_helpgrep(eap)
 				while (l > 0 && line[l - 1] <= ' ')
 				     line[--l] = NUL;
 
-				if (qf_add_entry(qi, &prevp,
+				if (qf_add_entry(qi,
 					    NULL,	/* dir */
 					    fnames[fi],
 					    0,
@@ -4234,8 +5259,6 @@ ex_helpgrep(eap)
 #endif
 
 	qi->qf_lists[qi->qf_curlist].qf_nonevalid = FALSE;
-	qi->qf_lists[qi->qf_curlist].qf_ptr =
-	    qi->qf_lists[qi->qf_curlist].qf_start;
 	qi->qf_lists[qi->qf_curlist].qf_index = 1;
     }
 
@@ -55,6 +55,34 @@
 # define BT_REGEXP_DEBUG_LOG_NAME	"bt_regexp_debug.log"
 #endif
 
+#ifdef REGEXP_STATS
+/*
+ * Counters for the regexp benchmark, see regexp_bench.c.
+ */
+static struct
+{
+    long	bt_steps;	/* items tried by regmatch() */
+    long	nfa_states;	/* states handled by nfa_regmatch() */
+    long	max_mem;	/* most memory used for matching */
+    long	prog_mem;	/* size of the compiled program */
+} regstat;
+# define REGSTAT_INC(item)	++regstat.item
+# define REGSTAT_MAX(item, n)	do { if ((long)(n) > regstat.item) \
+				    regstat.item = (long)(n); } while (0)
+#else
+# define REGSTAT_INC(item)
+# define REGSTAT_MAX(item, n)
+#endif
+
+/*
+ * Work done by the engines, used to select the faster engine automatically.
+ * A state handled by the NFA engine costs about three times as much as an
+ * item tried by the backtracking engine.
+ */
+static long regexec_work = 0;
+#define REGCOST_BT_STEP		1
+#define REGCOST_NFA_STATE	3
+
 /*
  * The "internal use only" fields in regexp.h are present to pass info from
  * compile to execute that permits the execute phase to run lots faster on
@@ -350,6 +378,14 @@ toggle_Magic(x)
 static int re_multi_type __ARGS((int));
 static int cstrncmp __ARGS((char_u *s1, char_u *s2, int *n));
 static char_u *cstrchr __ARGS((char_u *, int));
+static char_u *reg_find_must __ARGS((char_u *s, char_u *must, int *mlen));
+static int regcache_state __ARGS((void));
+static regprog_T *regcache_find __ARGS((char_u *expr, int re_flags));
+static void regcache_add __ARGS((char_u *expr, int re_flags, regprog_T *prog));
+static void regcache_replace __ARGS((regprog_T *old_prog, regprog_T *new_prog));
+#if defined(EXITFREE) || defined(PROTO)
+static void regcache_clear __ARGS((void));
+#endif
 
 #ifdef BT_REGEXP_DUMP
 static void	regdump __ARGS((char_u *, bt_regprog_T *));
@@ -597,6 +633,9 @@ init_class_tab()
 #define RF_HASNL    4	/* can match a NL */
 #define RF_ICOMBINE 8	/* ignore combining characters */
 #define RF_LOOKBH   16	/* uses "\@<=" or "\@<!" */
+#define RF_POSITION 32	/* uses the line number, the start or end of the
+			   file, a mark, the cursor, the Visual area or the
+			   virtual column */
 
 /*
  * Global work variables for vim_regcomp().
@@ -621,6 +660,7 @@ static int	brace_count[10]; /* Current counts for complex brace repeats */
 #if defined(FEAT_SYN_HL) || defined(PROTO)
 static int	had_eol;	/* TRUE when EOL found by vim_regcomp() */
 #endif
+static int	had_prev_sub;	/* TRUE when "~" found by vim_regcomp() */
 static int	one_exactly = FALSE;	/* only do one char for EXACTLY */
 
 static int	reg_magic;	/* magicness of the pattern: */
@@ -755,6 +795,56 @@ re_lookbehind(prog)
     return (prog->regflags & RF_LOOKBH);
 }
 
+/*
+ * Return TRUE if compiled regular expression "prog" depends on the position
+ * of the text in a buffer or window: the line number, a mark, the cursor, the
+ * Visual area or the virtual column.
+ */
+    int
+re_position(prog)
+    regprog_T *prog;
+{
+    return (prog->regflags & RF_POSITION);
+}
+
+/*
+ * Return the text that every match of "prog" contains, in the line where the
+ * match starts and not before the column where matching starts.  Can be used
+ * to skip a line without trying to match.  The text is owned by "prog".
+ * "ic" is the ignore-case flag used for matching, "*icp" is set to whether
+ * case is ignored when comparing the text, "\c" and "\C" included.
+ * Returns NULL when there is no such text.
+ */
+    char_u *
+vim_regmust(prog, ic, icp)
+    regprog_T	*prog;
+    int		ic;
+    int		*icp;
+{
+    char_u	*must;
+
+    if (prog->regflags & RF_ICOMBINE)
+	return NULL;	    /* text may be split by composing characters */
+    if (prog->engine == &nfa_regengine)
+    {
+	must = ((nfa_regprog_T *)prog)->regmust;
+	if (must == NULL)
+	    must = ((nfa_regprog_T *)prog)->match_text;
+    }
+    else
+	must = ((bt_regprog_T *)prog)->regmust;
+    if (must == NULL || *must == NUL)
+	return NULL;
+
+    if (prog->regflags & RF_ICASE)
+	*icp = TRUE;
+    else if (prog->regflags & RF_NOICASE)
+	*icp = FALSE;
+    else
+	*icp = ic;
+    return must;
+}
+
 /*
  * Check for an equivalence class name "[=a=]".  "pp" points to the '['.
  * Returns a character representing the class. Zero means that no item was
@@ -1359,6 +1449,7 @@ bt_regcomp(expr, re_flags)
     r = (bt_regprog_T *)lalloc(sizeof(bt_regprog_T) + regsize, TRUE);
     if (r == NULL)
 	return NULL;
+    REGSTAT_MAX(prog_mem, sizeof(bt_regprog_T) + regsize);
 
     /*
      * Second pass: emit code.
@@ -1374,6 +1465,12 @@ bt_regcomp(expr, re_flags)
 	return NULL;
     }
 
+    /* Keep the pattern for when the automatic engine selection wants to try
+     * the other engine. */
+    r->pattern = NULL;
+    if (re_flags & RE_AUTO)
+	r->pattern = vim_strsave(expr);
+
     /* Dig out information for optimizations. */
     r->regstart = NUL;		/* Worst-case defaults. */
     r->reganch = 0;
@@ -1465,6 +1562,8 @@ bt_regcomp(expr, re_flags)
 bt_regfree(prog)
     regprog_T   *prog;
 {
+    if (prog != NULL)
+	vim_free(((bt_regprog_T *)prog)->pattern);
     vim_free(prog);
 }
 
@@ -1498,6 +1597,7 @@ regcomp_start(expr, re_flags)
 #if defined(FEAT_SYN_HL) || defined(PROTO)
     had_eol = FALSE;
 #endif
+    had_prev_sub = FALSE;
 }
 
 #if defined(FEAT_SYN_HL) || defined(PROTO)
@@ -2084,6 +2184,7 @@ regatom(flagp)
 	    {
 		char_u	    *lp;
 
+		had_prev_sub = TRUE;
 		ret = regnode(EXACTLY);
 		lp = reg_prev_sub;
 		while (*lp != NUL)
@@ -2201,18 +2302,22 @@ regatom(flagp)
 		 * pattern -- regardless of whether or not it makes sense. */
 		case '^':
 		    ret = regnode(RE_BOF);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case '$':
 		    ret = regnode(RE_EOF);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case '#':
 		    ret = regnode(CURSOR);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case 'V':
 		    ret = regnode(RE_VISUAL);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case 'C':
@@ -2335,6 +2440,7 @@ regatom(flagp)
 				  /* "\%'m", "\%<'m" and "\%>'m": Mark */
 				  c = getchr();
 				  ret = regnode(RE_MARK);
+				  regflags |= RF_POSITION;
 				  if (ret == JUST_CALC_SIZE)
 				      regsize += 2;
 				  else
@@ -2352,6 +2458,8 @@ regatom(flagp)
 				      ret = regnode(RE_COL);
 				  else
 				      ret = regnode(RE_VCOL);
+				  if (c != 'c')
+				      regflags |= RF_POSITION;
 				  if (ret == JUST_CALC_SIZE)
 				      regsize += 5;
 				  else
@@ -3698,6 +3806,7 @@ free_regexp_stuff()
     ga_clear(&backpos);
     vim_free(reg_tofree);
     vim_free(reg_prev_sub);
+    regcache_clear();
 }
 #endif
 
@@ -3875,52 +3984,9 @@ bt_regexec_both(line, col, tm)
 #endif
 
     /* If there is a "must appear" string, look for it. */
-    if (prog->regmust != NULL)
-    {
-	int c;
-
-#ifdef FEAT_MBYTE
-	if (has_mbyte)
-	    c = (*mb_ptr2char)(prog->regmust);
-	else
-#endif
-	    c = *prog->regmust;
-	s = line + col;
-
-	/*
-	 * This is used very often, esp. for ":global".  Use three versions of
-	 * the loop to avoid overhead of conditions.
-	 */
-	if (!ireg_ic
-#ifdef FEAT_MBYTE
-		&& !has_mbyte
-#endif
-		)
-	    while ((s = vim_strbyte(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		/* Found it. */
-		++s;
-	    }
-#ifdef FEAT_MBYTE
-	else if (!ireg_ic || (!enc_utf8 && mb_char2len(c) > 1))
-	    while ((s = vim_strchr(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		/* Found it. */
-		mb_ptr_adv(s);
-	    }
-#endif
-	else
-	    while ((s = cstrchr(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		/* Found it. */
-		mb_ptr_adv(s);
-	    }
-	if (s == NULL)		/* Not present. */
-	    goto theend;
-    }
+    if (prog->regmust != NULL
+	    && reg_find_must(line + col, prog->regmust, &prog->regmlen) == NULL)
+	goto theend;
 
     regline = line;
     reglnum = 0;
@@ -4015,6 +4081,9 @@ bt_regexec_both(line, col, tm)
     }
 
 theend:
+    REGSTAT_MAX(max_mem, regstack.ga_maxlen
+			       + backpos.ga_maxlen * (long)sizeof(backpos_T));
+
     /* Free "reg_tofree" when it's a bit big.
      * Free regstack and backpos if they are bigger than their initial size. */
     if (reg_tofreelen > 400)
@@ -4327,6 +4396,8 @@ regmatch(scan)
 	    break;
 	}
 	status = RA_CONT;
+	REGSTAT_INC(bt_steps);
+	regexec_work += REGCOST_BT_STEP;
 
 #ifdef DEBUG
 	if (regnarrate)
@@ -7219,6 +7290,60 @@ cstrchr(s, c)
     return NULL;
 }
 
+/*
+ * Find the "must appear" string "must", which is "*mlen" bytes long, in "s",
+ * taking 'ignorecase' into account.
+ * Returns a pointer to where it was found, NULL when it is not present.
+ */
+    static char_u *
+reg_find_must(s, must, mlen)
+    char_u	*s;
+    char_u	*must;
+    int		*mlen;
+{
+    int		c;
+
+#ifdef FEAT_MBYTE
+    if (has_mbyte)
+	c = (*mb_ptr2char)(must);
+    else
+#endif
+	c = *must;
+
+    /*
+     * This is used very often, esp. for ":global".  Use three versions of
+     * the loop to avoid overhead of conditions.
+     */
+    if (!ireg_ic
+#ifdef FEAT_MBYTE
+	    && !has_mbyte
+#endif
+	    )
+	while ((s = vim_strbyte(s, c)) != NULL)
+	{
+	    if (cstrncmp(s, must, mlen) == 0)
+		break;		/* Found it. */
+	    ++s;
+	}
+#ifdef FEAT_MBYTE
+    else if (!ireg_ic || (!enc_utf8 && mb_char2len(c) > 1))
+	while ((s = vim_strchr(s, c)) != NULL)
+	{
+	    if (cstrncmp(s, must, mlen) == 0)
+		break;		/* Found it. */
+	    mb_ptr_adv(s);
+	}
+#endif
+    else
+	while ((s = cstrchr(s, c)) != NULL)
+	{
+	    if (cstrncmp(s, must, mlen) == 0)
+		break;		/* Found it. */
+	    mb_ptr_adv(s);
+	}
+    return s;
+}
+
 /***************************************************************
  *		      regsub stuff			       *
  ***************************************************************/
@@ -8036,9 +8161,193 @@ static char_u regname[][30] = {
 			    };
 #endif
 
+/*
+ * Cache of compiled programs.  Using the same pattern again, e.g. with "=~"
+ * in a loop, for an autocommand pattern or for 'hlsearch' on every redraw,
+ * then doesn't compile it again.  The most recently used entry is first.
+ * Each entry holds a reference to its program, see "re_refcount".
+ */
+typedef struct regcache_S regcache_T;
+
+struct regcache_S
+{
+    regcache_T	*rc_next;
+    regprog_T	*rc_prog;
+    hash_T	rc_hash;	/* hash of rc_pat */
+    int		rc_flags;	/* "re_flags" argument of vim_regcomp() */
+    int		rc_state;	/* result of regcache_state() */
+#ifdef FEAT_SYN_HL
+    int		rc_had_eol;	/* "had_eol" after compiling */
+#endif
+    char_u	rc_pat[1];	/* actually longer */
+};
+
+#define REGCACHE_MAX	32	/* maximum number of entries */
+
+static regcache_T   *regcache = NULL;
+static int	    regcache_len = 0;
+
+/*
+ * Return a number for the option values and other state, other than the
+ * arguments, that compiling a pattern depends on.
+ */
+    static int
+regcache_state()
+{
+    int		state = (int)p_re;
+
+    if (vim_strchr(p_cpo, CPO_LITERAL) != NULL)
+	state |= 0x04;
+    if (vim_strchr(p_cpo, CPO_BACKSL) != NULL)
+	state |= 0x08;
+#ifdef FEAT_SYN_HL
+    state |= reg_do_extmatch << 4;
+#endif
+#ifdef FEAT_MBYTE
+    if (has_mbyte)
+	state |= 0x40;
+    if (enc_utf8)
+	state |= 0x80;
+    state |= enc_dbcs << 8;
+#endif
+    return state;
+}
+
+#if defined(FEAT_SEARCH_EXTRA) || defined(PROTO)
+/*
+ * Return a number for the option values and other state, other than the
+ * arguments, that the program returned by the last vim_regcomp() depends on.
+ * Returns -1 when it used the previous substitute string, which may change.
+ */
+    int
+vim_regcomp_state()
+{
+    return had_prev_sub ? -1 : regcache_state();
+}
+#endif
+
+/*
+ * Find pattern "expr" compiled with "re_flags" in the cache.
+ * Returns the program with an extra reference, or NULL when not found.
+ */
+    static regprog_T *
+regcache_find(expr, re_flags)
+    char_u	*expr;
+    int		re_flags;
+{
+    regcache_T	*rc;
+    regcache_T	**prev;
+    hash_T	hash;
+    int		state;
+
+    if (regcache == NULL)
+	return NULL;
+    hash = hash_hash(expr);
+    state = regcache_state();
+    for (prev = &regcache; (rc = *prev) != NULL; prev = &rc->rc_next)
+	if (rc->rc_hash == hash && rc->rc_flags == re_flags
+		&& rc->rc_state == state && STRCMP(rc->rc_pat, expr) == 0)
+	{
+	    /* Move the entry to the front. */
+	    *prev = rc->rc_next;
+	    rc->rc_next = regcache;
+	    regcache = rc;
+#ifdef FEAT_SYN_HL
+	    had_eol = rc->rc_had_eol;
+#endif
+	    had_prev_sub = FALSE;   /* such programs are not cached */
+	    ++rc->rc_prog->re_refcount;
+	    return rc->rc_prog;
+	}
+    return NULL;
+}
+
+/*
+ * Add "prog", just compiled from "expr" with "re_flags", to the cache.
+ * When the cache is full the least recently used entry is dropped.
+ */
+    static void
+regcache_add(expr, re_flags, prog)
+    char_u	*expr;
+    int		re_flags;
+    regprog_T	*prog;
+{
+    regcache_T	*rc;
+    regcache_T	**prev;
+
+    rc = (regcache_T *)alloc((unsigned)(sizeof(regcache_T) + STRLEN(expr)));
+    if (rc == NULL)
+	return;
+    STRCPY(rc->rc_pat, expr);
+    rc->rc_hash = hash_hash(expr);
+    rc->rc_flags = re_flags;
+    rc->rc_state = regcache_state();
+#ifdef FEAT_SYN_HL
+    rc->rc_had_eol = had_eol;
+#endif
+    rc->rc_prog = prog;
+    ++prog->re_refcount;
+    rc->rc_next = regcache;
+    regcache = rc;
+
+    if (++regcache_len > REGCACHE_MAX)
+    {
+	for (prev = &regcache; (*prev)->rc_next != NULL;
+						  prev = &(*prev)->rc_next)
+	    ;
+	rc = *prev;
+	*prev = NULL;
+	--regcache_len;
+	vim_regfree(rc->rc_prog);
+	vim_free(rc);
+    }
+}
+
+/*
+ * Replace "old_prog" with "new_prog" in the cache, used when the automatic
+ * engine selection switched to the other engine.
+ */
+    static void
+regcache_replace(old_prog, new_prog)
+    regprog_T	*old_prog;
+    regprog_T	*new_prog;
+{
+    regcache_T	*rc;
+
+    for (rc = regcache; rc != NULL; rc = rc->rc_next)
+	if (rc->rc_prog == old_prog)
+	{
+	    rc->rc_prog = new_prog;
+	    ++new_prog->re_refcount;
+	    vim_regfree(old_prog);
+	    break;
+	}
+}
+
+#if defined(EXITFREE) || defined(PROTO)
+/*
+ * Drop all the entries from the cache.
+ */
+    static void
+regcache_clear()
+{
+    regcache_T	*rc;
+
+    while (regcache != NULL)
+    {
+	rc = regcache;
+	regcache = rc->rc_next;
+	vim_regfree(rc->rc_prog);
+	vim_free(rc);
+    }
+    regcache_len = 0;
+}
+#endif
+
 /*
  * Compile a regular expression into internal code.
- * Returns the program in allocated memory.
+ * Returns the program in allocated memory, it may be shared with other users
+ * of the same pattern.
  * Use vim_regfree() to free the memory.
  * Returns NULL for an error.
  */
@@ -8049,7 +8358,15 @@ vim_regcomp(expr_arg, re_flags)
 {
     regprog_T   *prog = NULL;
     char_u	*expr = expr_arg;
+    int		save_called_emsg = called_emsg;
+    int		by_cost = FALSE;
+    int		cost_state = REGCOST_OFF;
+
+    prog = regcache_find(expr_arg, re_flags);
+    if (prog != NULL)
+	return prog;
 
+    called_emsg = FALSE;
     regexp_engine = p_re;
 
     /* Check for prefix "\%#=", that sets the regexp engine */
@@ -8074,6 +8391,12 @@ vim_regcomp(expr_arg, re_flags)
 	    regexp_engine = AUTOMATIC_ENGINE;
 	}
     }
+    if (regexp_engine == COST_ENGINE)
+    {
+	/* Automatic selection, also switching when the engine is slow. */
+	by_cost = TRUE;
+	regexp_engine = AUTOMATIC_ENGINE;
+    }
     bt_regengine.expr = expr;
     nfa_regengine.expr = expr;
 
@@ -8082,7 +8405,8 @@ vim_regcomp(expr_arg, re_flags)
      */
     if (regexp_engine != BACKTRACKING_ENGINE)
         prog = nfa_regengine.regcomp(expr,
-		re_flags + (regexp_engine == AUTOMATIC_ENGINE ? RE_AUTO : 0));
+		re_flags + (regexp_engine == AUTOMATIC_ENGINE ? RE_AUTO : 0)
+						       + (by_cost ? RE_COST : 0));
     else
 	prog = bt_regengine.regcomp(expr, re_flags);
 
@@ -8115,6 +8439,26 @@ vim_regcomp(expr_arg, re_flags)
 	    prog = bt_regengine.regcomp(expr, re_flags);
 	}
     }
+    else if (by_cost && !had_prev_sub)
+    {
+	/*
+	 * Both engines can be used.  Start with the backtracking engine when
+	 * the NFA program looks expensive, matching will show which one is
+	 * faster, see regexec_feedback().
+	 */
+	cost_state = REGCOST_FIRST;
+	if (nfa_prefer_bt((nfa_regprog_T *)prog))
+	{
+	    regprog_T	*bt_prog = bt_regengine.regcomp(expr,
+							  re_flags + RE_AUTO);
+
+	    if (bt_prog != NULL)
+	    {
+		nfa_regengine.regfree(prog);
+		prog = bt_prog;
+	    }
+	}
+    }
 
     if (prog != NULL)
     {
@@ -8122,19 +8466,32 @@ vim_regcomp(expr_arg, re_flags)
 	 * out to be very slow when executing it. */
 	prog->re_engine = regexp_engine;
 	prog->re_flags  = re_flags;
+	prog->re_refcount = 1;
+	vim_memset(&prog->re_cost, 0, sizeof(regcost_T));
+	prog->re_cost.cs_state = cost_state;
+#ifdef FEAT_SYN_HL
+	prog->re_cost.cs_extmatch = reg_do_extmatch;
+#endif
+
+	/* Don't cache a pattern that gave a warning or used the previous
+	 * substitute string, which may change. */
+	if (!called_emsg && !had_prev_sub)
+	    regcache_add(expr_arg, re_flags, prog);
     }
+    called_emsg |= save_called_emsg;
 
     return prog;
 }
 
 /*
  * Free a compiled regexp program, returned by vim_regcomp().
+ * It is only freed when it is not used elsewhere and not in the cache.
  */
     void
 vim_regfree(prog)
     regprog_T   *prog;
 {
-    if (prog != NULL)
+    if (prog != NULL && --prog->re_refcount <= 0)
 	prog->engine->regfree(prog);
 }
 
@@ -8155,6 +8512,106 @@ report_re_switch(pat)
 }
 #endif
 
+/*
+ * Automatic engine selection: after matching against REGCOST_SAMPLE bytes of
+ * text the work per byte is checked.  Up to REGCOST_CHEAP the engine is kept,
+ * otherwise the other engine is tried.
+ */
+#define REGCOST_SAMPLE	    10000L
+#define REGCOST_CHEAP	    4L
+
+#define REGCOST_MEASURE(prog) ((prog)->re_cost.cs_state == REGCOST_FIRST \
+				|| (prog)->re_cost.cs_state == REGCOST_SECOND)
+
+static int regexec_switch __ARGS((regprog_T **progp, int state, long other));
+static void regexec_feedback __ARGS((regprog_T **progp, long bytes));
+
+/*
+ * Replace "*progp" with its pattern compiled by the other engine.  When
+ * selecting by cost also in the cache, so that other users of the pattern get
+ * the same engine.
+ * "state" is the cost state for the new program and "other" the work per
+ * byte of the current engine.
+ * Returns FAIL when the other engine can't compile the pattern.
+ */
+    static int
+regexec_switch(progp, state, other)
+    regprog_T	**progp;
+    int		state;
+    long	other;
+{
+    regprog_T	*prog = *progp;
+    regprog_T	*new_prog;
+#ifdef FEAT_SYN_HL
+    int		save_extmatch = reg_do_extmatch;
+
+    /* "\z(" and "\z1" are only allowed when compiling for syntax regions */
+    reg_do_extmatch = prog->re_cost.cs_extmatch;
+#endif
+
+    if (prog->engine == &nfa_regengine)
+	new_prog = bt_regengine.regcomp(((nfa_regprog_T *)prog)->pattern,
+						   prog->re_flags + RE_AUTO);
+    else if (((bt_regprog_T *)prog)->pattern != NULL)
+	new_prog = nfa_regengine.regcomp(((bt_regprog_T *)prog)->pattern,
+					 prog->re_flags + RE_AUTO + RE_COST);
+    else
+	new_prog = NULL;
+#ifdef FEAT_SYN_HL
+    reg_do_extmatch = save_extmatch;
+#endif
+    if (new_prog == NULL)
+	return FAIL;
+
+    new_prog->re_engine = AUTOMATIC_ENGINE;
+    new_prog->re_flags = prog->re_flags;
+    new_prog->re_refcount = 1;
+    new_prog->re_cost = prog->re_cost;
+    new_prog->re_cost.cs_state = state;
+    new_prog->re_cost.cs_bytes = 0;
+    new_prog->re_cost.cs_work = 0;
+    new_prog->re_cost.cs_other = other;
+
+    if (prog->re_cost.cs_state != REGCOST_OFF)
+	regcache_replace(prog, new_prog);
+    vim_regfree(prog);
+    *progp = new_prog;
+    return OK;
+}
+
+/*
+ * Called after matching "*progp" against "bytes" bytes of text while its
+ * engine is being measured.  The work done is in "regexec_work".
+ * When the engine does little work per byte it is kept.  Otherwise the other
+ * engine is tried on the same amount of text and the engine that did less
+ * work per byte is kept.
+ * Note: "*progp" may be freed and changed.
+ */
+    static void
+regexec_feedback(progp, bytes)
+    regprog_T	**progp;
+    long	bytes;
+{
+    regcost_T	*cs = &(*progp)->re_cost;
+    long	cost;
+
+    cs->cs_bytes += bytes;
+    cs->cs_work += regexec_work;
+    if (cs->cs_bytes < REGCOST_SAMPLE)
+	return;
+
+    cost = cs->cs_work / cs->cs_bytes;
+    if (cs->cs_state == REGCOST_FIRST)
+    {
+	if (cost <= REGCOST_CHEAP
+		|| regexec_switch(progp, REGCOST_SECOND, cost) == FAIL)
+	    cs->cs_state = REGCOST_DONE;
+    }
+    else if (cost <= cs->cs_other
+		|| regexec_switch(progp, REGCOST_DONE, 0L) == FAIL)
+	cs->cs_state = REGCOST_DONE;
+}
+
 static int vim_regexec_both __ARGS((regmatch_T *rmp, char_u *line, colnr_T col, int nl));
 
 /*
@@ -8173,31 +8630,28 @@ vim_regexec_both(rmp, line, col, nl)
     colnr_T	col;    /* column to start looking for match */
     int		nl;
 {
-    int result = rmp->regprog->engine->regexec_nl(rmp, line, col, nl);
+    long	bytes = 0;
+    int		result;
+
+    if (REGCOST_MEASURE(rmp->regprog))
+    {
+	bytes = (long)STRLEN(line + col) + 1;
+	regexec_work = 0;
+    }
+    result = rmp->regprog->engine->regexec_nl(rmp, line, col, nl);
 
     /* NFA engine aborted because it's very slow. */
     if (rmp->regprog->re_engine == AUTOMATIC_ENGINE
 					       && result == NFA_TOO_EXPENSIVE)
     {
-	int    save_p_re = p_re;
-	int    re_flags = rmp->regprog->re_flags;
-	char_u *pat = vim_strsave(((nfa_regprog_T *)rmp->regprog)->pattern);
-
-	p_re = BACKTRACKING_ENGINE;
-	vim_regfree(rmp->regprog);
-	if (pat != NULL)
-	{
 #ifdef FEAT_EVAL
-	    report_re_switch(pat);
+	report_re_switch(((nfa_regprog_T *)rmp->regprog)->pattern);
 #endif
-	    rmp->regprog = vim_regcomp(pat, re_flags);
-	    if (rmp->regprog != NULL)
-		result = rmp->regprog->engine->regexec_nl(rmp, line, col, nl);
-	    vim_free(pat);
-	}
-
-	p_re = save_p_re;
+	if (regexec_switch(&rmp->regprog, REGCOST_DONE, 0L) == OK)
+	    result = rmp->regprog->engine->regexec_nl(rmp, line, col, nl);
     }
+    else if (bytes > 0)
+	regexec_feedback(&rmp->regprog, bytes);
     return result > 0;
 }
 
@@ -8270,32 +8724,29 @@ vim_regexec_multi(rmp, win, buf, lnum, col, tm)
     colnr_T     col;            /* column to start looking for match */
     proftime_T	*tm;		/* timeout limit or NULL */
 {
-    int result = rmp->regprog->engine->regexec_multi(
-						rmp, win, buf, lnum, col, tm);
+    long	bytes = 0;
+    int		result;
+
+    if (REGCOST_MEASURE(rmp->regprog))
+    {
+	bytes = (long)STRLEN(ml_get_buf(buf, lnum, FALSE)) + 1;
+	regexec_work = 0;
+    }
+    result = rmp->regprog->engine->regexec_multi(rmp, win, buf, lnum, col, tm);
 
     /* NFA engine aborted because it's very slow. */
     if (rmp->regprog->re_engine == AUTOMATIC_ENGINE
 					       && result == NFA_TOO_EXPENSIVE)
     {
-	int    save_p_re = p_re;
-	int    re_flags = rmp->regprog->re_flags;
-	char_u *pat = vim_strsave(((nfa_regprog_T *)rmp->regprog)->pattern);
-
-	p_re = BACKTRACKING_ENGINE;
-	vim_regfree(rmp->regprog);
-	if (pat != NULL)
-	{
 #ifdef FEAT_EVAL
-	    report_re_switch(pat);
+	report_re_switch(((nfa_regprog_T *)rmp->regprog)->pattern);
 #endif
-	    rmp->regprog = vim_regcomp(pat, re_flags);
-	    if (rmp->regprog != NULL)
-		result = rmp->regprog->engine->regexec_multi(
+	if (regexec_switch(&rmp->regprog, REGCOST_DONE, 0L) == OK)
+	    result = rmp->regprog->engine->regexec_multi(
 						rmp, win, buf, lnum, col, tm);
-	    vim_free(pat);
-	}
-	p_re = save_p_re;
     }
+    else if (bytes > 0)
+	regexec_feedback(&rmp->regprog, bytes);
 
     return result <= 0 ? 0 : result;
 }
@@ -38,9 +38,30 @@
 #define	    AUTOMATIC_ENGINE	0
 #define	    BACKTRACKING_ENGINE	1
 #define	    NFA_ENGINE		2
+#define	    COST_ENGINE		3	/* automatic, also selecting by cost */
 
 typedef struct regengine regengine_T;
 
+/*
+ * Used for the automatic engine selection: the work done by the engine that
+ * is being tried, see regexec_feedback().
+ */
+typedef struct
+{
+    int			cs_state;    /* REGCOST_ value */
+    long		cs_bytes;    /* bytes of text matched against */
+    long		cs_work;     /* work done for those bytes */
+    long		cs_other;    /* work per byte of the other engine */
+#ifdef FEAT_SYN_HL
+    int			cs_extmatch; /* "reg_do_extmatch" when compiled */
+#endif
+} regcost_T;
+
+#define REGCOST_OFF	0	/* engine was not selected automatically */
+#define REGCOST_FIRST	1	/* trying the engine selected when compiling */
+#define REGCOST_SECOND	2	/* trying the other engine */
+#define REGCOST_DONE	3	/* engine has been selected */
+
 /*
  * Structure returned by vim_regcomp() to pass on to vim_regexec().
  * This is the general structure. For the actual matcher, two specific
@@ -52,6 +73,8 @@ typedef struct regprog
     unsigned		regflags;
     unsigned		re_engine;   /* automatic, backtracking or nfa engine */
     unsigned		re_flags;    /* second argument for vim_regcomp() */
+    int			re_refcount; /* number of users, see vim_regfree() */
+    regcost_T		re_cost;     /* used when re_engine is automatic */
 } regprog_T;
 
 /*
@@ -61,11 +84,13 @@ typedef struct regprog
  */
 typedef struct
 {
-    /* These four members implement regprog_T */
+    /* These six members implement regprog_T */
     regengine_T		*engine;
     unsigned		regflags;
     unsigned		re_engine;
     unsigned		re_flags;    /* second argument for vim_regcomp() */
+    int			re_refcount;
+    regcost_T		re_cost;
 
     int			regstart;
     char_u		reganch;
@@ -74,6 +99,7 @@ typedef struct
 #ifdef FEAT_SYN_HL
     char_u		reghasz;
 #endif
+    char_u		*pattern;	/* only set for the automatic engine */
     char_u		program[1];	/* actually longer.. */
 } bt_regprog_T;
 
@@ -92,22 +118,64 @@ struct nfa_state
     int			val;
 };
 
+/*
+ * State of the DFA that is built lazily from the NFA, see nfa_dfa_check().
+ * "ids" holds the indexes of the NFA states that consume a character or wait
+ * for the end of the line, sorted.
+ */
+typedef struct nfa_dstate_S nfa_dstate_T;
+struct nfa_dstate_S
+{
+    nfa_dstate_T	*hnext;		/* next state in the same hash bucket */
+    nfa_dstate_T	*next[256];	/* state after a character, NULL when
+					   not computed yet */
+    int			match;		/* TRUE when a match ends here */
+    int			eolmatch;	/* -1 when not computed yet, TRUE when a
+					   match ends at the end of the line */
+    int			nids;
+    int			ids[1];		/* actually longer.. */
+};
+
+#define NFA_DFA_HASHSIZE 64
+
+/*
+ * The DFA cache of one NFA program.
+ */
+typedef struct
+{
+    int			disabled;	/* TRUE when it used too much memory */
+    int			key;		/* options the states were built for */
+    long		size;		/* memory used by the states */
+    nfa_dstate_T	*start_bol;	/* state at the start of the line */
+    nfa_dstate_T	*start;		/* state at another column */
+    nfa_dstate_T	*hashtab[NFA_DFA_HASHSIZE];
+    int			markid;
+    int			*mark;		/* "markid" per NFA state */
+    int			nids;
+    int			*ids;		/* NFA state indexes being collected */
+} nfa_dfa_T;
+
 /*
  * Structure used by the NFA matcher.
  */
 typedef struct
 {
-    /* These three members implement regprog_T */
+    /* These six members implement regprog_T */
     regengine_T		*engine;
     unsigned		regflags;
     unsigned		re_engine;
     unsigned		re_flags;    /* second argument for vim_regcomp() */
+    int			re_refcount;
+    regcost_T		re_cost;
 
     nfa_state_T		*start;		/* points into state[] */
 
     int			reganch;	/* pattern starts with ^ */
     int			regstart;	/* char at start of pattern */
     char_u		*match_text;	/* plain text to match with */
+    char_u		*regmust;	/* text that must appear in a match */
+    int			regmlen;	/* length of regmust */
+    nfa_dfa_T		*dfa;		/* NULL when a DFA can't be used */
 
     int			has_zend;	/* pattern contains \ze */
     int			has_backref;	/* pattern contains \1 .. \9 */
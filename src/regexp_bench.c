@@ -0,0 +1,427 @@
+/* vi:set ts=8 sts=4 sw=4:
+ *
+ * VIM - Vi IMproved	by Bram Moolenaar
+ *
+ * Do ":help uganda"  in Vim to read copying and usage conditions.
+ * Do ":help credits" in Vim to see a list of people who contributed.
+ * See README.txt for an overview of the Vim source code.
+ */
+
+/*
+ * regexp_bench.c: Benchmark for the regexp engines.
+ *
+ * Runs a list of patterns, taken from syntax files, typical searches and
+ * some pathological ones, with the backtracking engine, the NFA engine, the
+ * automatic selection of the engine ('regexpengine' zero) and the selection
+ * by cost ('regexpengine' three).  Each
+ * pattern is matched against every line of the sample files, or against its
+ * own text.  For every pattern and engine one line is written, with these
+ * fields separated by a Tab:
+ *	name	    name of the pattern
+ *	engine	    "bt", "nfa", "auto" or "cost"
+ *	bytes	    number of bytes matched against
+ *	matches	    number of lines with a match
+ *	ns/byte	    time used per byte, in nanoseconds
+ *	steps	    items tried by the backtracking engine
+ *	states	    states handled by the NFA engine
+ *	progmem	    size of the compiled program in bytes
+ *	matchmem    most memory used for matching one line, in bytes
+ * Lines starting with '#' are comments.
+ *
+ * Usage: regexp_bench [-b baseline] [file ...]
+ *
+ * Without a file name "regexp.c" and "eval.c" are used.  With "-b" the
+ * ns/byte values are compared with a previous output of the benchmark, the
+ * ratio is added as a column and "REGRESSION" when the pattern became more
+ * than 25% slower.  The exit status is then 1.
+ */
+
+#define REGEXP_STATS
+
+/* Must include main.c because it contains much more than just main() */
+#define NO_VIM_MAIN
+#include "main.c"
+
+/* This file has to be included because the counters are static */
+#include "regexp.c"
+
+#include <time.h>
+
+#define BENCH_MIN_CLOCK	    (CLOCKS_PER_SEC / 5)    /* minimal time per run */
+#define BENCH_MAX_ROUNDS    50
+#define BENCH_TEXT_BYTES    10000   /* bytes of text for a pattern */
+#define BENCH_REGRESSION    1.25
+
+typedef struct
+{
+    char	*name;
+    char	*pattern;
+    char	*text;	    /* text to match against, NULL for the files */
+    int		repeat;	    /* number of times "text" is repeated in a line */
+} bench_pat_T;
+
+static bench_pat_T bench_pats[] =
+{
+    /* syntax items */
+    {"c_number",    "\\<\\(0x\\x\\+\\|\\d\\+\\)[uUlL]*\\>", NULL, 0},
+    {"c_string",    "\"\\([^\"\\\\]\\|\\\\.\\)*\"", NULL, 0},
+    {"c_comment",   "/\\*.\\{-}\\*/", NULL, 0},
+    {"c_preproc",   "^\\s*#\\s*\\(include\\|define\\|ifdef\\|endif\\)\\>", NULL, 0},
+    {"c_function",  "\\<\\h\\w*\\ze\\s*(", NULL, 0},
+    {"c_todo",	    "\\<\\(TODO\\|FIXME\\|XXX\\)\\>", NULL, 0},
+    {"c_operator",  "[-+*/%<>=!&|^]=\\=", NULL, 0},
+
+    /* searches */
+    {"word",	    "\\<vim_regcomp\\>", NULL, 0},
+    {"ignorecase",  "\\cNFA_REGMATCH", NULL, 0},
+    {"keyword",	    "\\<\\k\\+_free\\>", NULL, 0},
+    {"upper",	    "[A-Z_]\\{6,}", NULL, 0},
+    {"trailing",    "\\s\\+$", NULL, 0},
+    {"no_literal",  "[a-c]\\d\\d[x-z]", NULL, 0},
+    {"lookahead",   "\\<\\h\\w*\\(_T\\>\\)\\@=", NULL, 0},
+
+    /* pathological */
+    {"nested_star", "\\(a*\\)*[bc]", "aaaaaaaaaaaaaaaaaaaa", 1},
+    {"alternation", "\\(a\\|aa\\)*[cd]", "aaaaaaaaaaaaaa", 1},
+    {"many_dots",   "\\(.*\\)\\{4}x", "abcdefghijklmnopqrstuvwxyz0123456789", 1},
+    {"word_repeat", "\\(\\w\\+\\s*\\)\\{8}!",
+			"one two three four five six seven eight nine ten", 1},
+    {"backref",	    "\\(\\w\\+\\) \\1\\>",
+		    "the quick brown fox jumps over the lazy lazy dog", 1},
+    {"long_line",   "x\\d\\+y", "x0123456", 2000},
+    {NULL, NULL, NULL, 0}
+};
+
+typedef struct
+{
+    char_u	**lines;
+    int		count;
+    long	bytes;
+} bench_text_T;
+
+typedef struct
+{
+    char	name[40];
+    char	engine[8];
+    double	ns_per_byte;
+} bench_base_T;
+
+static bench_base_T *bench_base = NULL;
+static int bench_base_count = 0;
+
+static void bench_init __ARGS((void));
+static void bench_add_line __ARGS((bench_text_T *text, char_u *line));
+static char_u *bench_make_text __ARGS((bench_text_T *text, bench_pat_T *bp));
+static int bench_read_file __ARGS((bench_text_T *text, char *fname));
+static void bench_read_baseline __ARGS((char *fname));
+static double bench_find_baseline __ARGS((char *name, char *engine));
+static int bench_run __ARGS((bench_pat_T *bp, int engine, bench_text_T *text));
+
+/*
+ * Do the part of the Vim startup that is needed for matching: options,
+ * 'iskeyword' and friends and the current buffer.
+ */
+    static void
+bench_init()
+{
+    mch_early_init();
+#ifdef FEAT_MBYTE
+    (void)mb_init();
+#endif
+    if ((IObuff = alloc(IOSIZE)) == NULL
+	    || (NameBuff = alloc(MAXPATHL)) == NULL)
+	exit(2);
+    if (win_alloc_first() == FAIL)
+	exit(2);
+    set_init_1();
+
+    /* Don't let errors for pathological patterns disturb the output. */
+    ++emsg_silent;
+}
+
+    static void
+bench_add_line(text, line)
+    bench_text_T    *text;
+    char_u	    *line;
+{
+    if (text->count % 1024 == 0)
+    {
+	text->lines = (char_u **)vim_realloc(text->lines,
+				   (text->count + 1024) * sizeof(char_u *));
+	if (text->lines == NULL)
+	    exit(2);
+    }
+    text->lines[text->count++] = line;
+    text->bytes += (long)STRLEN(line);
+}
+
+/*
+ * Fill "text" with lines made of the text of pattern "bp".
+ * Returns the allocated memory for the lines.
+ */
+    static char_u *
+bench_make_text(text, bp)
+    bench_text_T    *text;
+    bench_pat_T	    *bp;
+{
+    int		len = (int)STRLEN(bp->text);
+    char_u	*line;
+    int		i;
+
+    line = alloc(len * bp->repeat + 1);
+    if (line == NULL)
+	exit(2);
+    for (i = 0; i < bp->repeat; ++i)
+	mch_memmove(line + i * len, bp->text, (size_t)len);
+    line[len * bp->repeat] = NUL;
+
+    vim_memset(text, 0, sizeof(bench_text_T));
+    do
+	bench_add_line(text, line);
+    while (text->bytes < BENCH_TEXT_BYTES);
+    return line;
+}
+
+/*
+ * Read file "fname" and add its lines to "text".
+ * Returns FAIL when it can't be read.
+ */
+    static int
+bench_read_file(text, fname)
+    bench_text_T    *text;
+    char	    *fname;
+{
+    FILE	*fd;
+    long	len;
+    char_u	*buf;
+    char_u	*p;
+    char_u	*s;
+
+    fd = mch_fopen(fname, "r");
+    if (fd == NULL)
+	return FAIL;
+    fseek(fd, 0L, SEEK_END);
+    len = ftell(fd);
+    fseek(fd, 0L, SEEK_SET);
+    buf = alloc((unsigned)len + 1);
+    if (buf == NULL)
+	exit(2);
+    len = (long)fread(buf, 1, (size_t)len, fd);
+    fclose(fd);
+    buf[len] = NUL;
+
+    for (s = buf; *s != NUL; s = p + 1)
+    {
+	p = vim_strchr(s, '\n');
+	if (p == NULL)
+	{
+	    bench_add_line(text, s);
+	    break;
+	}
+	*p = NUL;
+	if (p > s && p[-1] == '\r')
+	    p[-1] = NUL;
+	bench_add_line(text, s);
+    }
+    return OK;
+}
+
+/*
+ * Read the output of a previous run from "fname" to compare with.
+ */
+    static void
+bench_read_baseline(fname)
+    char	*fname;
+{
+    FILE	*fd;
+    char	line[200];
+    double	ns;
+
+    fd = mch_fopen(fname, "r");
+    if (fd == NULL)
+    {
+	fprintf(stderr, "Cannot read baseline \"%s\"\n", fname);
+	exit(2);
+    }
+    while (fgets(line, (int)sizeof(line), fd) != NULL)
+    {
+	bench_base_T	*bb;
+
+	if (line[0] == '#')
+	    continue;
+	if (bench_base_count % 64 == 0)
+	{
+	    bench_base = (bench_base_T *)vim_realloc(bench_base,
+			     (bench_base_count + 64) * sizeof(bench_base_T));
+	    if (bench_base == NULL)
+		exit(2);
+	}
+	bb = &bench_base[bench_base_count];
+	if (sscanf(line, "%39s %7s %*s %*s %lf", bb->name, bb->engine, &ns)
+									 == 3)
+	{
+	    bb->ns_per_byte = ns;
+	    ++bench_base_count;
+	}
+    }
+    fclose(fd);
+}
+
+/*
+ * Return the ns/byte of the baseline for "name" and "engine", zero when not
+ * found.
+ */
+    static double
+bench_find_baseline(name, engine)
+    char	*name;
+    char	*engine;
+{
+    int		i;
+
+    for (i = 0; i < bench_base_count; ++i)
+	if (strcmp(bench_base[i].name, name) == 0
+		&& strcmp(bench_base[i].engine, engine) == 0)
+	    return bench_base[i].ns_per_byte;
+    return 0.0;
+}
+
+/*
+ * Run pattern "bp" with "engine" on "text" and write the results.
+ * Returns TRUE when it is a regression.
+ */
+    static int
+bench_run(bp, engine, text)
+    bench_pat_T	    *bp;
+    int		    engine;
+    bench_text_T    *text;
+{
+    char	*engine_name = engine == NFA_ENGINE ? "nfa"
+				: engine == BACKTRACKING_ENGINE ? "bt"
+				: engine == COST_ENGINE ? "cost" : "auto";
+    regmatch_T	regmatch;
+    clock_t	start;
+    clock_t	used;
+    long	progmem;
+    long	matches = 0;
+    long	rounds;
+    int		i;
+    double	ns;
+    double	base;
+
+    p_re = engine;
+    vim_memset(&regstat, 0, sizeof(regstat));
+    regmatch.regprog = vim_regcomp((char_u *)bp->pattern, RE_MAGIC);
+    regmatch.rm_ic = FALSE;
+    if (regmatch.regprog == NULL)
+    {
+	printf("# %s: cannot compile \"%s\"\n", bp->name, bp->pattern);
+	return FALSE;
+    }
+    start = clock();
+    for (rounds = 1; ; ++rounds)
+    {
+	for (i = 0; i < text->count; ++i)
+	{
+	    if (vim_regexec(&regmatch, text->lines[i], (colnr_T)0))
+		++matches;
+	    /* Set when 'maxmempattern' was exceeded, don't let it stop
+	     * matching the next lines. */
+	    got_int = FALSE;
+	}
+	used = clock() - start;
+	if (used >= BENCH_MIN_CLOCK || rounds == BENCH_MAX_ROUNDS)
+	    break;
+    }
+    progmem = regstat.prog_mem;
+    if (regmatch.regprog->engine == &nfa_regengine)
+    {
+	nfa_dfa_T   *dfa = ((nfa_regprog_T *)regmatch.regprog)->dfa;
+
+	/* include the DFA states built while matching */
+	if (dfa != NULL)
+	    progmem += sizeof(nfa_dfa_T) + dfa->size;
+    }
+    vim_regfree(regmatch.regprog);
+
+    ns = (double)used * 1000000000.0 / CLOCKS_PER_SEC
+					   / ((double)text->bytes * rounds);
+    printf("%s\t%s\t%ld\t%ld\t%.2f\t%ld\t%ld\t%ld\t%ld",
+	    bp->name, engine_name, text->bytes, matches / rounds, ns,
+	    regstat.bt_steps / rounds, regstat.nfa_states / rounds,
+	    progmem, regstat.max_mem);
+    if (bench_base_count > 0)
+    {
+	base = bench_find_baseline(bp->name, engine_name);
+	if (base > 0.0)
+	{
+	    printf("\t%.2f", ns / base);
+	    if (ns / base > BENCH_REGRESSION)
+	    {
+		printf("\tREGRESSION\n");
+		return TRUE;
+	    }
+	}
+    }
+    printf("\n");
+    return FALSE;
+}
+
+    int
+main(argc, argv)
+    int		argc;
+    char	**argv;
+{
+    bench_text_T    files;
+    bench_text_T    own;
+    bench_text_T    *text;
+    bench_pat_T	    *bp;
+    char_u	    *line = NULL;
+    int		    regressions = 0;
+    int		    nfiles = 0;
+    int		    i;
+
+    bench_init();
+    vim_memset(&files, 0, sizeof(files));
+
+    for (i = 1; i < argc; ++i)
+    {
+	if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+	    bench_read_baseline(argv[++i]);
+	else if (bench_read_file(&files, argv[i]) == FAIL)
+	{
+	    fprintf(stderr, "Cannot read \"%s\"\n", argv[i]);
+	    return 2;
+	}
+	else
+	    ++nfiles;
+    }
+    if (nfiles == 0 && (bench_read_file(&files, "regexp.c") == FAIL
+		|| bench_read_file(&files, "eval.c") == FAIL))
+    {
+	fprintf(stderr, "Cannot read regexp.c and eval.c\n");
+	return 2;
+    }
+
+    printf("# name\tengine\tbytes\tmatches\tns/byte\tsteps\tstates\tprogmem\tmatchmem%s\n",
+				     bench_base_count > 0 ? "\tchange" : "");
+    for (bp = bench_pats; bp->name != NULL; ++bp)
+    {
+	text = &files;
+	if (bp->text != NULL)
+	{
+	    line = bench_make_text(&own, bp);
+	    text = &own;
+	}
+	regressions += bench_run(bp, BACKTRACKING_ENGINE, text);
+	regressions += bench_run(bp, NFA_ENGINE, text);
+	regressions += bench_run(bp, AUTOMATIC_ENGINE, text);
+	regressions += bench_run(bp, COST_ENGINE, text);
+	if (text == &own)
+	{
+	    vim_free(own.lines);
+	    vim_free(line);
+	}
+	fflush(stdout);
+    }
+    return regressions > 0 ? 1 : 0;
+}
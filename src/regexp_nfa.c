@@ -286,6 +286,10 @@ static int nfa_regcomp_start __ARGS((char_u *expr, int re_flags));
 static int nfa_get_reganch __ARGS((nfa_state_T *start, int depth));
 static int nfa_get_regstart __ARGS((nfa_state_T *start, int depth));
 static char_u *nfa_get_match_text __ARGS((nfa_state_T *start));
+static nfa_state_T *nfa_must_next __ARGS((nfa_state_T *p));
+static int nfa_leads_to __ARGS((nfa_state_T *p, nfa_state_T *target));
+static char_u *nfa_get_regmust __ARGS((nfa_state_T *start, int *lenp));
+static int nfa_can_find_must __ARGS((char_u *must, char_u *s));
 static int realloc_post_list __ARGS((void));
 static int nfa_recognize_char_class __ARGS((char_u *start, char_u *end, int extra_newl));
 static int nfa_emit_equi_class __ARGS((int c));
@@ -312,9 +316,22 @@ static void nfa_save_listids __ARGS((nfa_regprog_T *prog, int *list));
 static void nfa_restore_listids __ARGS((nfa_regprog_T *prog, int *list));
 static int nfa_re_num_cmp __ARGS((long_u val, int op, long_u pos));
 static long nfa_regtry __ARGS((nfa_regprog_T *prog, colnr_T col, proftime_T *tm));
+static int nfa_dfa_possible __ARGS((nfa_regprog_T *prog));
+static nfa_dfa_T *nfa_dfa_alloc __ARGS((int nstate));
+static void nfa_dfa_clear __ARGS((nfa_dfa_T *dfa));
+static void nfa_dfa_free __ARGS((nfa_dfa_T *dfa));
+static void nfa_dfa_addstate __ARGS((nfa_regprog_T *prog, nfa_state_T *state, int atbol, int ateol, int *matchp));
+static int nfa_dfa_match_char __ARGS((nfa_state_T *state, int c));
+static nfa_dstate_T *nfa_dfa_find __ARGS((nfa_regprog_T *prog, int match));
+static void nfa_dfa_startlist __ARGS((nfa_regprog_T *prog));
+static nfa_dstate_T *nfa_dfa_start __ARGS((nfa_regprog_T *prog, int atbol));
+static nfa_dstate_T *nfa_dfa_next __ARGS((nfa_regprog_T *prog, nfa_dstate_T *d, int c));
+static int nfa_dfa_eolmatch __ARGS((nfa_regprog_T *prog, nfa_dstate_T *d));
+static int nfa_dfa_check __ARGS((nfa_regprog_T *prog, char_u *line, colnr_T col));
 static long nfa_regexec_both __ARGS((char_u *line, colnr_T col, proftime_T *tm));
 static regprog_T *nfa_regcomp __ARGS((char_u *expr, int re_flags));
 static void nfa_regfree __ARGS((regprog_T *prog));
+static int nfa_prefer_bt __ARGS((nfa_regprog_T *prog));
 static int  nfa_regexec_nl __ARGS((regmatch_T *rmp, char_u *line, colnr_T col, int line_lbr));
 static long nfa_regexec_multi __ARGS((regmmatch_T *rmp, win_T *win, buf_T *buf, linenr_T lnum, colnr_T col, proftime_T *tm));
 static int match_follows __ARGS((nfa_state_T *startstate, int depth));
@@ -560,6 +577,203 @@ nfa_get_match_text(start)
     return ret;
 }
 
+/*
+ * Return the state after "p" when "p" matches at most one character that is
+ * not a line break or is zero-width.  Return NULL for anything else.
+ */
+    static nfa_state_T *
+nfa_must_next(p)
+    nfa_state_T *p;
+{
+    if (p->c > 0 || (p->c >= NFA_ANY && p->c <= NFA_NUPPER_IC))
+	return p->out;
+
+    switch (p->c)
+    {
+	case NFA_START_COLL:
+	case NFA_START_NEG_COLL:
+	    /* out1 points to the NFA_END_COLL */
+	    return p->out1->out;
+
+	case NFA_EMPTY:
+	case NFA_BOL:
+	case NFA_BOF:
+	case NFA_BOW:
+	case NFA_EOW:
+	case NFA_ZSTART:
+	case NFA_ZEND:
+	case NFA_CURSOR:
+	case NFA_VISUAL:
+	case NFA_LNUM:
+	case NFA_LNUM_GT:
+	case NFA_LNUM_LT:
+	case NFA_COL:
+	case NFA_COL_GT:
+	case NFA_COL_LT:
+	case NFA_VCOL:
+	case NFA_VCOL_GT:
+	case NFA_VCOL_LT:
+	case NFA_MARK:
+	case NFA_MARK_GT:
+	case NFA_MARK_LT:
+
+	case NFA_MOPEN:
+	case NFA_MOPEN1:
+	case NFA_MOPEN2:
+	case NFA_MOPEN3:
+	case NFA_MOPEN4:
+	case NFA_MOPEN5:
+	case NFA_MOPEN6:
+	case NFA_MOPEN7:
+	case NFA_MOPEN8:
+	case NFA_MOPEN9:
+	case NFA_NOPEN:
+	case NFA_MCLOSE:
+	case NFA_MCLOSE1:
+	case NFA_MCLOSE2:
+	case NFA_MCLOSE3:
+	case NFA_MCLOSE4:
+	case NFA_MCLOSE5:
+	case NFA_MCLOSE6:
+	case NFA_MCLOSE7:
+	case NFA_MCLOSE8:
+	case NFA_MCLOSE9:
+	case NFA_NCLOSE:
+#ifdef FEAT_SYN_HL
+	case NFA_ZOPEN:
+	case NFA_ZOPEN1:
+	case NFA_ZOPEN2:
+	case NFA_ZOPEN3:
+	case NFA_ZOPEN4:
+	case NFA_ZOPEN5:
+	case NFA_ZOPEN6:
+	case NFA_ZOPEN7:
+	case NFA_ZOPEN8:
+	case NFA_ZOPEN9:
+	case NFA_ZCLOSE:
+	case NFA_ZCLOSE1:
+	case NFA_ZCLOSE2:
+	case NFA_ZCLOSE3:
+	case NFA_ZCLOSE4:
+	case NFA_ZCLOSE5:
+	case NFA_ZCLOSE6:
+	case NFA_ZCLOSE7:
+	case NFA_ZCLOSE8:
+	case NFA_ZCLOSE9:
+#endif
+	    return p->out;
+    }
+    return NULL;
+}
+
+/*
+ * Return TRUE when going from state "p" with nfa_must_next() gets to state
+ * "target" in a few steps.
+ */
+    static int
+nfa_leads_to(p, target)
+    nfa_state_T *p;
+    nfa_state_T *target;
+{
+    int		i;
+
+    for (i = 0; i < 20 && p != NULL; ++i)
+    {
+	if (p == target)
+	    return TRUE;
+	p = nfa_must_next(p);
+    }
+    return FALSE;
+}
+
+/*
+ * Find the longest literal text that every match must contain, in the part
+ * of the pattern that can't match a line break.  "x*", "x\+" and "x\="
+ * are skipped when "x" is simple, the text can't continue over them.
+ * Return the text in allocated memory and set "*lenp" to its length in
+ * bytes.  Return NULL if there is no such text.
+ */
+    static char_u *
+nfa_get_regmust(start, lenp)
+    nfa_state_T *start;
+    int		*lenp;
+{
+    nfa_state_T *p = start;
+    nfa_state_T *next;
+    nfa_state_T *run = NULL;	    /* first state of current text */
+    nfa_state_T *best = NULL;	    /* first state of longest text */
+    int		runlen = 0;
+    int		bestlen = 0;
+    int		i;
+    char_u	*ret;
+    char_u	*s;
+
+    for (i = 0; i < 1000 && p != NULL; ++i)
+    {
+	if (p->c > 0)
+	{
+	    if (runlen == 0)
+		run = p;
+	    runlen += MB_CHAR2LEN(p->c);
+	    if (runlen > bestlen)
+	    {
+		best = run;
+		bestlen = runlen;
+	    }
+	    p = p->out;
+	    continue;
+	}
+
+	if (p->c == NFA_SPLIT)
+	{
+	    /* A loop back to the split, or one branch that skips over the
+	     * other: continue after it. */
+	    if (nfa_leads_to(p->out, p) || nfa_leads_to(p->out, p->out1))
+		next = p->out1;
+	    else if (nfa_leads_to(p->out1, p) || nfa_leads_to(p->out1, p->out))
+		next = p->out;
+	    else
+		break;
+	}
+	else
+	{
+	    next = nfa_must_next(p);
+	    if (next == NULL)
+		break;
+	    /* zero-width items don't end the text */
+	    if (!(p->c >= NFA_ANY && p->c <= NFA_NUPPER_IC)
+		    && p->c != NFA_START_COLL && p->c != NFA_START_NEG_COLL)
+	    {
+		p = next;
+		continue;
+	    }
+	}
+	runlen = 0;
+	p = next;
+    }
+
+    if (best == NULL)
+	return NULL;
+    ret = alloc(bestlen + 1);
+    if (ret != NULL)
+    {
+	s = ret;
+	for (p = best; s < ret + bestlen; p = p->out)
+	    if (p->c > 0)
+	    {
+#ifdef FEAT_MBYTE
+		if (has_mbyte)
+		    s += (*mb_char2bytes)(p->c, s);
+		else
+#endif
+		    *s++ = p->c;
+	    }
+	*s = NUL;
+	*lenp = bestlen;
+    }
+    return ret;
+}
+
 /*
  * Allocate more space for post_start.  Called when
  * running above the estimated number of states.
@@ -1297,6 +1511,7 @@ nfa_regatom()
 		    EMSG(_(e_nopresub));
 		    return FAIL;
 		}
+		had_prev_sub = TRUE;
 		for (lp = reg_prev_sub; *lp != NUL; mb_cptr_adv(lp))
 		{
 		    EMIT(PTR2CHAR(lp));
@@ -1412,18 +1627,22 @@ nfa_regatom()
 		 * pattern -- regardless of whether or not it makes sense. */
 		case '^':
 		    EMIT(NFA_BOF);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case '$':
 		    EMIT(NFA_EOF);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case '#':
 		    EMIT(NFA_CURSOR);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case 'V':
 		    EMIT(NFA_VISUAL);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case 'C':
@@ -1476,6 +1695,8 @@ nfa_regatom()
 			}
 			if (c == 'l' || c == 'c' || c == 'v')
 			{
+			    if (c != 'c')
+				regflags |= RF_POSITION;
 			    if (c == 'l')
 				/* \%{n}l  \%{n}<l  \%{n}>l  */
 				EMIT(cmp == '<' ? NFA_LNUM_LT :
@@ -1494,6 +1715,7 @@ nfa_regatom()
 			else if (c == '\'' && n == 0)
 			{
 			    /* \%'m  \%<'m  \%>'m  */
+			    regflags |= RF_POSITION;
 			    EMIT(cmp == '<' ? NFA_MARK_LT :
 				 cmp == '>' ? NFA_MARK_GT : NFA_MARK);
 			    EMIT(getchr());
@@ -2035,8 +2257,11 @@ nfa_regpiece()
 
 	    /* The engine is very inefficient (uses too many states) when the
 	     * maximum is much larger than the minimum.  Bail out if we can
-	     * use the other engine. */
-	    if ((nfa_re_flags & RE_AUTO) && maxval > minval + 200)
+	     * use the other engine.  When selecting by cost and without a
+	     * maximum the atom is only repeated "minval" times,
+	     * nfa_prefer_bt() checks the size. */
+	    if ((nfa_re_flags & RE_AUTO) && maxval > minval + 200
+		    && (maxval != MAX_LIMIT || !(nfa_re_flags & RE_COST)))
 		return FAIL;
 
 	    /* Ignore previous call to nfa_regatom() */
@@ -2656,6 +2881,8 @@ nfa_dump(prog)
 					      prog->regstart, prog->regstart);
 	if (prog->match_text != NULL)
 	    fprintf(debugf, "match_text: \"%s\"\n", prog->match_text);
+	if (prog->regmust != NULL)
+	    fprintf(debugf, "regmust: \"%s\"\n", prog->regmust);
 
 	fclose(debugf);
     }
@@ -5585,11 +5812,13 @@ nfa_regmatch(prog, start, submatch, m)
 	 */
 	if (thislist->n == 0)
 	    break;
+	regexec_work += REGCOST_NFA_STATE * thislist->n;
 
 	/* compute nextlist */
 	for (listidx = 0; listidx < thislist->n; ++listidx)
 	{
 	    t = &thislist->t[listidx];
+	    REGSTAT_INC(nfa_states);
 
 #ifdef NFA_REGEXP_DEBUG_LOG
 	    nfa_set_code(t->state->c);
@@ -6818,6 +7047,9 @@ nextchar:
 #endif
 
 theend:
+    REGSTAT_MAX(max_mem, (list[0].len + list[1].len)
+						 * (long)sizeof(nfa_thread_T));
+
     /* Free memory */
     vim_free(list[0].t);
     vim_free(list[1].t);
@@ -6966,6 +7198,537 @@ nfa_regtry(prog, col, tm)
     return 1 + reglnum;
 }
 
+/*
+ * Lazily built DFA.
+ *
+ * For a pattern that only uses items that match one character of the
+ * current line, zero-width items and "^" and "$", the NFA states that are
+ * active at a position can be combined into one DFA state.  The DFA states
+ * and the transitions between them are computed when they are first needed
+ * and are cached in "prog->dfa".  After that each character takes one table
+ * lookup, while the NFA simulation handles every active state again.
+ *
+ * The DFA only tells whether a line may contain a match, not where the match
+ * and the submatches are.  It is used to skip lines without a match, the
+ * NFA does the real work for the other lines.  Zero-width items that depend
+ * on options or on the position, such as "\<" and "\%23l", are taken to
+ * always match, thus the DFA may find a match where there is none, but it
+ * never misses one.
+ */
+
+/* Maximum number of bytes used for the DFA states of one pattern.  When more
+ * are needed the DFA is not used for this pattern. */
+#define NFA_DFA_MAXMEM	(256 * 1024L)
+
+/*
+ * Return TRUE if the DFA can be used for "prog": it has no back references,
+ * \z(), look-around, line breaks or composing characters.
+ */
+    static int
+nfa_dfa_possible(prog)
+    nfa_regprog_T   *prog;
+{
+    int		i;
+    int		c;
+
+    if (prog->has_backref)
+	return FALSE;
+    for (i = 0; i < prog->nstate; ++i)
+    {
+	c = prog->state[i].c;
+	if (c > 0
+		|| (c >= NFA_ANY && c <= NFA_NUPPER_IC)
+		|| (c >= NFA_MOPEN && c <= NFA_MCLOSE9)
+		|| (c >= NFA_CURSOR && c <= NFA_VISUAL)
+		|| (c >= NFA_CLASS_ALNUM && c <= NFA_CLASS_ESCAPE
+						    && c != NFA_CLASS_PRINT))
+	    continue;
+	switch (c)
+	{
+	    case NFA_SPLIT:
+	    case NFA_MATCH:
+	    case NFA_EMPTY:
+	    case NFA_START_COLL:
+	    case NFA_END_COLL:
+	    case NFA_START_NEG_COLL:
+	    case NFA_END_NEG_COLL:
+	    case NFA_RANGE_MIN:
+	    case NFA_RANGE_MAX:
+	    case NFA_BOL:
+	    case NFA_EOL:
+	    case NFA_BOW:
+	    case NFA_EOW:
+	    case NFA_BOF:
+	    case NFA_EOF:
+	    case NFA_ZSTART:
+	    case NFA_ZEND:
+	    case NFA_NOPEN:
+	    case NFA_NCLOSE:
+		continue;
+	}
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Allocate the DFA cache for a program with "nstate" NFA states.
+ * Returns NULL when out of memory.
+ */
+    static nfa_dfa_T *
+nfa_dfa_alloc(nstate)
+    int		nstate;
+{
+    nfa_dfa_T	*dfa;
+
+    dfa = (nfa_dfa_T *)alloc_clear((unsigned)sizeof(nfa_dfa_T));
+    if (dfa == NULL)
+	return NULL;
+    dfa->mark = (int *)alloc_clear((unsigned)(nstate * sizeof(int)));
+    dfa->ids = (int *)alloc((unsigned)(nstate * sizeof(int)));
+    if (dfa->mark == NULL || dfa->ids == NULL)
+    {
+	nfa_dfa_free(dfa);
+	return NULL;
+    }
+    return dfa;
+}
+
+/*
+ * Free all the DFA states in "dfa".
+ */
+    static void
+nfa_dfa_clear(dfa)
+    nfa_dfa_T	*dfa;
+{
+    nfa_dstate_T    *d;
+    int		    i;
+
+    for (i = 0; i < NFA_DFA_HASHSIZE; ++i)
+	while (dfa->hashtab[i] != NULL)
+	{
+	    d = dfa->hashtab[i];
+	    dfa->hashtab[i] = d->hnext;
+	    vim_free(d);
+	}
+    dfa->start_bol = NULL;
+    dfa->start = NULL;
+    dfa->size = 0;
+}
+
+    static void
+nfa_dfa_free(dfa)
+    nfa_dfa_T	*dfa;
+{
+    if (dfa != NULL)
+    {
+	nfa_dfa_clear(dfa);
+	vim_free(dfa->mark);
+	vim_free(dfa->ids);
+	vim_free(dfa);
+    }
+}
+
+/*
+ * Add "state" and the states reachable from it without consuming a
+ * character to the list of NFA states in "prog->dfa".  "atbol" is TRUE at
+ * the start of the line, "ateol" at the end of the line.
+ * Sets "*matchp" to TRUE when the match ends here.
+ */
+    static void
+nfa_dfa_addstate(prog, state, atbol, ateol, matchp)
+    nfa_regprog_T   *prog;
+    nfa_state_T	    *state;
+    int		    atbol;
+    int		    ateol;
+    int		    *matchp;
+{
+    nfa_dfa_T	*dfa = prog->dfa;
+    int		idx = (int)(state - prog->state);
+
+    if (dfa->mark[idx] == dfa->markid)
+	return;
+    dfa->mark[idx] = dfa->markid;
+
+    switch (state->c)
+    {
+	case NFA_MATCH:
+	    *matchp = TRUE;
+	    return;
+
+	case NFA_SPLIT:
+	    nfa_dfa_addstate(prog, state->out, atbol, ateol, matchp);
+	    nfa_dfa_addstate(prog, state->out1, atbol, ateol, matchp);
+	    return;
+
+	case NFA_BOL:
+	    if (atbol)
+		nfa_dfa_addstate(prog, state->out, atbol, ateol, matchp);
+	    return;
+
+	case NFA_EOL:
+	    /* Before the end of the line remember the state, it matches when
+	     * the end of the line is reached without consuming more. */
+	    if (ateol)
+		nfa_dfa_addstate(prog, state->out, atbol, ateol, matchp);
+	    else
+		dfa->ids[dfa->nids++] = idx;
+	    return;
+
+	case NFA_START_COLL:
+	case NFA_START_NEG_COLL:
+	    break;
+
+	default:
+	    if (state->c > 0
+		    || (state->c >= NFA_ANY && state->c <= NFA_NUPPER_IC))
+		break;
+	    /* Zero-width item, taken to always match. */
+	    nfa_dfa_addstate(prog, state->out, atbol, ateol, matchp);
+	    return;
+    }
+
+    /* The state consumes a character, nothing to do at the end of the
+     * line. */
+    if (!ateol)
+	dfa->ids[dfa->nids++] = idx;
+}
+
+/*
+ * Return TRUE if NFA "state", which consumes a character, matches character
+ * "c", which is not NUL.  Does the same checks as nfa_regmatch(), except
+ * that classes that depend on options, such as "\k", match any character.
+ */
+    static int
+nfa_dfa_match_char(state, c)
+    nfa_state_T	*state;
+    int		c;
+{
+    nfa_state_T	*p;
+    int		c1, c2;
+
+    if (state->c > 0)
+	return c == state->c
+		    || (ireg_ic && MB_TOLOWER(c) == MB_TOLOWER(state->c));
+
+    switch (state->c)
+    {
+	case NFA_START_COLL:
+	case NFA_START_NEG_COLL:
+	    for (p = state->out; p->c != NFA_END_COLL; p = p->out)
+	    {
+		if (p->c == NFA_RANGE_MIN)
+		{
+		    c1 = p->val;
+		    p = p->out; /* advance to NFA_RANGE_MAX */
+		    c2 = p->val;
+		    if (c >= c1 && c <= c2)
+			break;
+		    if (ireg_ic)
+		    {
+			int c_low = MB_TOLOWER(c);
+
+			for ( ; c1 <= c2; ++c1)
+			    if (MB_TOLOWER(c1) == c_low)
+				break;
+			if (c1 <= c2)
+			    break;
+		    }
+		}
+		else if (p->c < 0 ? check_char_class(p->c, c)
+			    : (c == p->c
+				|| (ireg_ic && MB_TOLOWER(c)
+							== MB_TOLOWER(p->c))))
+		    break;
+	    }
+	    return (p->c == NFA_END_COLL) == (state->c == NFA_START_NEG_COLL);
+
+	case NFA_WHITE:	    return vim_iswhite(c);
+	case NFA_NWHITE:    return !vim_iswhite(c);
+	case NFA_DIGIT:	    return ri_digit(c);
+	case NFA_NDIGIT:    return !ri_digit(c);
+	case NFA_HEX:	    return ri_hex(c);
+	case NFA_NHEX:	    return !ri_hex(c);
+	case NFA_OCTAL:	    return ri_octal(c);
+	case NFA_NOCTAL:    return !ri_octal(c);
+	case NFA_WORD:	    return ri_word(c);
+	case NFA_NWORD:	    return !ri_word(c);
+	case NFA_HEAD:	    return ri_head(c);
+	case NFA_NHEAD:	    return !ri_head(c);
+	case NFA_ALPHA:	    return ri_alpha(c);
+	case NFA_NALPHA:    return !ri_alpha(c);
+	case NFA_LOWER:	    return ri_lower(c);
+	case NFA_NLOWER:    return !ri_lower(c);
+	case NFA_UPPER:	    return ri_upper(c);
+	case NFA_NUPPER:    return !ri_upper(c);
+	case NFA_LOWER_IC:  return ri_lower(c) || (ireg_ic && ri_upper(c));
+	case NFA_NLOWER_IC: return !(ri_lower(c) || (ireg_ic && ri_upper(c)));
+	case NFA_UPPER_IC:  return ri_upper(c) || (ireg_ic && ri_lower(c));
+	case NFA_NUPPER_IC: return !(ri_upper(c) || (ireg_ic && ri_lower(c)));
+    }
+
+    /* NFA_ANY and the classes that depend on options. */
+    return TRUE;
+}
+
+/*
+ * Find the DFA state for the NFA states collected in "prog->dfa" and
+ * "match".  Adds a new state when it doesn't exist yet.
+ * Returns NULL when the memory limit is reached, the DFA is then disabled.
+ */
+    static nfa_dstate_T *
+nfa_dfa_find(prog, match)
+    nfa_regprog_T   *prog;
+    int		    match;
+{
+    nfa_dfa_T	    *dfa = prog->dfa;
+    nfa_dstate_T    *d;
+    long_u	    hash;
+    long	    size;
+    int		    i, j;
+    int		    idx;
+
+    /* When there is a match the other states don't matter. */
+    if (match)
+	dfa->nids = 0;
+
+    /* Sort the indexes, there usually are only a few. */
+    for (i = 1; i < dfa->nids; ++i)
+    {
+	idx = dfa->ids[i];
+	for (j = i; j > 0 && dfa->ids[j - 1] > idx; --j)
+	    dfa->ids[j] = dfa->ids[j - 1];
+	dfa->ids[j] = idx;
+    }
+
+    hash = dfa->nids;
+    for (i = 0; i < dfa->nids; ++i)
+	hash = hash * 31 + dfa->ids[i];
+    hash &= NFA_DFA_HASHSIZE - 1;
+
+    for (d = dfa->hashtab[hash]; d != NULL; d = d->hnext)
+	if (d->match == match && d->nids == dfa->nids
+		&& vim_memcmp(d->ids, dfa->ids,
+					(size_t)(dfa->nids * sizeof(int))) == 0)
+	    return d;
+
+    size = (long)(sizeof(nfa_dstate_T) + dfa->nids * sizeof(int));
+    if (dfa->size + size > NFA_DFA_MAXMEM
+	    || (d = (nfa_dstate_T *)lalloc_clear((long_u)size, FALSE)) == NULL)
+    {
+	/* Too many states, only use the NFA from now on. */
+	nfa_dfa_clear(dfa);
+	dfa->disabled = TRUE;
+	return NULL;
+    }
+    dfa->size += size;
+    d->match = match;
+    d->eolmatch = -1;
+    d->nids = dfa->nids;
+    mch_memmove(d->ids, dfa->ids, (size_t)(dfa->nids * sizeof(int)));
+    d->hnext = dfa->hashtab[hash];
+    dfa->hashtab[hash] = d;
+    return d;
+}
+
+/*
+ * Start collecting NFA states in "prog->dfa".
+ */
+    static void
+nfa_dfa_startlist(prog)
+    nfa_regprog_T   *prog;
+{
+    nfa_dfa_T	*dfa = prog->dfa;
+
+    if (++dfa->markid <= 0)
+    {
+	/* wrapped around, clear the marks */
+	vim_memset(dfa->mark, 0, (size_t)(prog->nstate * sizeof(int)));
+	dfa->markid = 1;
+    }
+    dfa->nids = 0;
+}
+
+/*
+ * Return the DFA state where the search starts.  "atbol" is TRUE when
+ * starting at the start of the line.
+ * Returns NULL when the DFA was disabled.
+ */
+    static nfa_dstate_T *
+nfa_dfa_start(prog, atbol)
+    nfa_regprog_T   *prog;
+    int		    atbol;
+{
+    int		match = FALSE;
+
+    nfa_dfa_startlist(prog);
+    nfa_dfa_addstate(prog, prog->start, atbol, FALSE, &match);
+    return nfa_dfa_find(prog, match);
+}
+
+/*
+ * Return the DFA state after "d" consumed character "c", which is not NUL.
+ * Returns NULL when the DFA was disabled.
+ */
+    static nfa_dstate_T *
+nfa_dfa_next(prog, d, c)
+    nfa_regprog_T   *prog;
+    nfa_dstate_T    *d;
+    int		    c;
+{
+    nfa_state_T	    *state;
+    nfa_dstate_T    *next;
+    int		    match = FALSE;
+    int		    i;
+
+    nfa_dfa_startlist(prog);
+    for (i = 0; i < d->nids; ++i)
+    {
+	state = &prog->state[d->ids[i]];
+	if (state->c != NFA_EOL && nfa_dfa_match_char(state, c))
+	    /* For a collection out1 points to the NFA_END_COLL. */
+	    nfa_dfa_addstate(prog, (state->c == NFA_START_COLL
+					|| state->c == NFA_START_NEG_COLL)
+				    ? state->out1->out : state->out,
+						       FALSE, FALSE, &match);
+    }
+    /* A match may also start after this character. */
+    nfa_dfa_addstate(prog, prog->start, FALSE, FALSE, &match);
+
+    next = nfa_dfa_find(prog, match);
+    if (next != NULL && c < 256)
+	d->next[c] = next;
+    return next;
+}
+
+/*
+ * Return TRUE if a match ends at the end of the line when in DFA state "d".
+ */
+    static int
+nfa_dfa_eolmatch(prog, d)
+    nfa_regprog_T   *prog;
+    nfa_dstate_T    *d;
+{
+    int		match = FALSE;
+    int		atbol = (d == prog->dfa->start_bol);
+    int		i;
+
+    if (d->eolmatch < 0)
+    {
+	nfa_dfa_startlist(prog);
+	for (i = 0; i < d->nids; ++i)
+	    if (prog->state[d->ids[i]].c == NFA_EOL)
+		nfa_dfa_addstate(prog, &prog->state[d->ids[i]],
+						       atbol, TRUE, &match);
+	nfa_dfa_addstate(prog, prog->start, atbol, TRUE, &match);
+	d->eolmatch = match;
+    }
+    return d->eolmatch;
+}
+
+/*
+ * Use the DFA of "prog" to check whether "line" may match at or after
+ * column "col".
+ * Returns FALSE when there is no match, TRUE when there may be one.
+ */
+    static int
+nfa_dfa_check(prog, line, col)
+    nfa_regprog_T   *prog;
+    char_u	    *line;
+    colnr_T	    col;
+{
+    nfa_dfa_T	    *dfa = prog->dfa;
+    nfa_dstate_T    *d;
+    char_u	    *p = line + col;
+    int		    c;
+    int		    len;
+    int		    key = ireg_ic;
+
+#ifdef FEAT_MBYTE
+    /* Composing characters are not handled, other multi-byte encodings
+     * neither. */
+    if (ireg_icombine || (has_mbyte && !enc_utf8))
+	return TRUE;
+    key += (enc_utf8 << 1) + (cmp_flags << 2);
+#endif
+    if (dfa->key != key)
+    {
+	/* The states depend on 'ignorecase' and 'casemap'. */
+	nfa_dfa_clear(dfa);
+	dfa->key = key;
+    }
+
+    if (col == 0)
+    {
+	if (dfa->start_bol == NULL)
+	    dfa->start_bol = nfa_dfa_start(prog, TRUE);
+	d = dfa->start_bol;
+    }
+    else
+    {
+	if (dfa->start == NULL)
+	    dfa->start = nfa_dfa_start(prog, FALSE);
+	d = dfa->start;
+    }
+
+    while (d != NULL)
+    {
+	if (d->match)
+	    return TRUE;
+	if (d->nids == 0)
+	    return FALSE;	/* no NFA state can be active */
+
+	c = *p;
+	if (c == NUL)
+	    return nfa_dfa_eolmatch(prog, d);
+	len = 1;
+#ifdef FEAT_MBYTE
+	if (c >= 0x80 && enc_utf8)
+	{
+	    c = utf_ptr2char(p);
+	    len = utf_ptr2len(p);
+	    if (utf_iscomposing(c))
+		return TRUE;
+	}
+#endif
+	if (c < 256 && d->next[c] != NULL)
+	    d = d->next[c];
+	else
+	    d = nfa_dfa_next(prog, d, c);
+	p += len;
+    }
+    return TRUE;
+}
+
+/*
+ * Return TRUE when reg_find_must() can be used to find "must" in "s".
+ * When ignoring case with UTF-8 a character may match a character with a
+ * different number of bytes, e.g. "k" and the Kelvin sign, which
+ * reg_find_must() doesn't find.  Only allow that when both are ASCII.
+ */
+    static int
+nfa_can_find_must(must, s)
+    char_u	*must;
+    char_u	*s;
+{
+#ifdef FEAT_MBYTE
+    char_u	*p;
+
+    if (ireg_icombine)
+	return FALSE;	/* "must" may be split by composing characters */
+    if (ireg_ic && enc_utf8)
+    {
+	for (p = must; *p != NUL; ++p)
+	    if (*p >= 0x80)
+		return FALSE;
+	for (p = s; *p != NUL; ++p)
+	    if (*p >= 0x80)
+		return FALSE;
+    }
+#endif
+    return TRUE;
+}
+
 /*
  * Match a regexp against a string ("line" points to the string) or multiple
  * lines ("line" is NULL, use reg_getline()).
@@ -7029,6 +7792,12 @@ nfa_regexec_both(line, startcol, tm)
     if (prog->reganch && col > 0)
 	return 0L;
 
+    /* If there is a "must appear" string, look for it. */
+    if (prog->regmust != NULL
+	    && nfa_can_find_must(prog->regmust, line + col)
+	    && reg_find_must(line + col, prog->regmust, &prog->regmlen) == NULL)
+	goto theend;
+
     need_clear_subexpr = TRUE;
 #ifdef FEAT_SYN_HL
     /* Clear the external match subpointers if necessary. */
@@ -7062,6 +7831,11 @@ nfa_regexec_both(line, startcol, tm)
     if (ireg_maxcol > 0 && col >= ireg_maxcol)
 	goto theend;
 
+    /* Quickly find out that there is no match with the DFA. */
+    if (prog->dfa != NULL && !prog->dfa->disabled
+				      && !nfa_dfa_check(prog, line, col))
+	goto theend;
+
     nstate = prog->nstate;
     for (i = 0; i < nstate; ++i)
     {
@@ -7141,6 +7915,7 @@ nfa_regcomp(expr, re_flags)
     prog = (nfa_regprog_T *)lalloc(prog_size, TRUE);
     if (prog == NULL)
 	goto fail;
+    REGSTAT_MAX(prog_mem, prog_size);
     state_ptr = prog->state;
 
     /*
@@ -7160,9 +7935,25 @@ nfa_regcomp(expr, re_flags)
 
     nfa_postprocess(prog);
 
+    prog->dfa = NULL;
+    if (nfa_dfa_possible(prog))
+	prog->dfa = nfa_dfa_alloc(prog->nstate);
+
     prog->reganch = nfa_get_reganch(prog->start, 0);
     prog->regstart = nfa_get_regstart(prog->start, 0);
     prog->match_text = nfa_get_match_text(prog->start);
+    /* Only useful when it's more than what regstart and match_text check. */
+    prog->regmust = NULL;
+    if (prog->match_text == NULL)
+    {
+	prog->regmust = nfa_get_regmust(prog->start, &prog->regmlen);
+	if (prog->regmust != NULL && prog->regstart != NUL
+		&& prog->regmlen == MB_CHAR2LEN(prog->regstart))
+	{
+	    vim_free(prog->regmust);
+	    prog->regmust = NULL;
+	}
+    }
 
 #ifdef ENABLE_LOG
     nfa_postfix_dump(expr, OK);
@@ -7201,11 +7992,55 @@ nfa_regfree(prog)
     if (prog != NULL)
     {
 	vim_free(((nfa_regprog_T *)prog)->match_text);
+	vim_free(((nfa_regprog_T *)prog)->regmust);
+	nfa_dfa_free(((nfa_regprog_T *)prog)->dfa);
 	vim_free(((nfa_regprog_T *)prog)->pattern);
 	vim_free(prog);
     }
 }
 
+/*
+ * Estimate from the compiled program whether the backtracking engine is
+ * likely to be faster.  The NFA engine has to keep many threads alive for
+ * back references, look-behind and look-ahead, and a large number of states,
+ * e.g. from "\{n,m}", makes every step expensive.
+ * This is only a first guess, regexec_feedback() corrects it.
+ */
+    static int
+nfa_prefer_bt(prog)
+    nfa_regprog_T   *prog;
+{
+    int		cost = prog->nstate / 100;
+    int		i;
+
+    for (i = 0; i < prog->nstate; ++i)
+	switch (prog->state[i].c)
+	{
+	    case NFA_BACKREF1:
+	    case NFA_BACKREF2:
+	    case NFA_BACKREF3:
+	    case NFA_BACKREF4:
+	    case NFA_BACKREF5:
+	    case NFA_BACKREF6:
+	    case NFA_BACKREF7:
+	    case NFA_BACKREF8:
+	    case NFA_BACKREF9:
+	    case NFA_START_INVISIBLE:
+	    case NFA_START_INVISIBLE_FIRST:
+	    case NFA_START_INVISIBLE_NEG:
+	    case NFA_START_INVISIBLE_NEG_FIRST:
+		cost += 2;
+		break;
+	    case NFA_START_INVISIBLE_BEFORE:
+	    case NFA_START_INVISIBLE_BEFORE_FIRST:
+	    case NFA_START_INVISIBLE_BEFORE_NEG:
+	    case NFA_START_INVISIBLE_BEFORE_NEG_FIRST:
+		cost += 3;
+		break;
+	}
+    return cost >= 2;
+}
+
 /*
  * Match a regexp against a string.
  * "rmp->regprog" is a compiled regexp as returned by nfa_regcomp().
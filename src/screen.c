@@ -3062,7 +3062,7 @@ win_line(wp, lnum, startrow, endrow, nochange)
 	 * error, stop syntax highlighting. */
 	save_did_emsg = did_emsg;
 	did_emsg = FALSE;
-	syntax_start(wp, lnum);
+	syntax_start_draw(wp, lnum);
 	if (did_emsg)
 	    wp->w_s->b_syn_error = TRUE;
 	else
@@ -3437,7 +3437,7 @@ win_line(wp, lnum, startrow, endrow, nochange)
 # ifdef FEAT_SYN_HL
 	    /* Need to restart syntax highlighting for this line. */
 	    if (has_syntax)
-		syntax_start(wp, lnum);
+		syntax_start_draw(wp, lnum);
 # endif
 	}
 #endif
@@ -7512,6 +7512,10 @@ prepare_search_hl(wp, lnum)
 				   in progress */
     int		n;
 
+    /* Make it possible to use the search index for 'hlsearch'. */
+    if (search_hl.rm.regprog != NULL)
+	sidx_prepare(wp->w_buffer, &search_hl.rm);
+
     /*
      * When using a multi-line pattern, start searching at the top
      * of the window or just after a closed fold.
@@ -7663,14 +7667,20 @@ next_search_hl(win, shl, lnum, mincol, cur)
 				&& shl == &cur->hl
 				&& cur->match.regprog == cur->hl.rm.regprog);
 
-	    nmatched = vim_regexec_multi(&shl->rm, win, shl->buf, lnum,
-		    matchcol,
+	    /* For 'hlsearch' skip a line that the search index knows has no
+	     * match. */
+	    if (shl == &search_hl && matchcol == 0
+				&& sidx_nomatch(shl->buf, &shl->rm, lnum))
+		nmatched = 0;
+	    else
+		nmatched = vim_regexec_multi(&shl->rm, win, shl->buf, lnum,
+			matchcol,
 #ifdef FEAT_RELTIME
-		    &(shl->tm)
+			&(shl->tm)
 #else
-		    NULL
+			NULL
 #endif
-		    );
+			);
 	    /* Copy the regprog, in case it got freed and recompiled. */
 	    if (regprog_is_copy)
 		cur->match.regprog = cur->hl.rm.regprog;
@@ -7690,6 +7700,12 @@ next_search_hl(win, shl, lnum, mincol, cur)
 				     message */
 		break;
 	    }
+	    if (shl == &search_hl && matchcol == 0 && nmatched == 0
+#ifdef FEAT_RELTIME
+		    && !profile_passed_limit(&(shl->tm))
+#endif
+		    )
+		sidx_set_nomatch(shl->buf, &shl->rm, lnum);
 	}
 	else if (cur != NULL)
 	    nmatched = next_search_hl_pos(shl, lnum, &(cur->pos), matchcol);
@@ -33,6 +33,10 @@ static void show_pat_in_path __ARGS((char_u *, int,
 #ifdef FEAT_VIMINFO
 static void wvsp_one __ARGS((FILE *fp, int idx, char *s, int sc));
 #endif
+#ifdef FEAT_SEARCH_EXTRA
+static void sidx_set_key __ARGS((regmmatch_T *regmatch, char_u *pat, int magic));
+static void sidx_apply_changes __ARGS((buf_T *buf));
+#endif
 
 /*
  * This file contains various searching-related routines. These fall into
@@ -103,6 +107,27 @@ static char_u	    *mr_pattern = NULL;	/* pattern used by search_regcomp() */
 static int	    mr_pattern_alloced = FALSE; /* mr_pattern was allocated */
 #endif
 
+#ifdef FEAT_SEARCH_EXTRA
+/*
+ * The search index of a buffer remembers in which lines the last compiled
+ * search pattern has no match, so that "n", 'hlsearch', ":s" and ":g" can skip
+ * those lines without executing the pattern.  It is filled while searching
+ * and kept until the pattern, the case folding, 'iskeyword' or something else
+ * that compiling or executing the pattern depends on changes.
+ * The memline functions report changed lines to sidx_changed(), including
+ * lines that ml_get_buf() returns to be changed in place.  Inserted
+ * and deleted lines are collected like b_mod_top and b_mod_bot for
+ * redrawing and applied when the index is used next.
+ * Patterns that can match a line break, look behind or depend on the
+ * position of the text are not indexed.
+ */
+static regprog_T    *sidx_prog = NULL;	/* regprog from search_regcomp() */
+static char_u	    *sidx_pat = NULL;	/* pattern of sidx_prog */
+static int	    sidx_magic;		/* 'magic' used for sidx_pat */
+static int	    sidx_state;		/* vim_regcomp_state() for sidx_pat */
+static int	    sidx_tick = 0;	/* incremented for each sidx_prog */
+#endif
+
 #ifdef FEAT_FIND_ID
 /*
  * Type used by find_pattern_in_path() to remember which included files have
@@ -215,6 +240,9 @@ search_regcomp(pat, pat_save, pat_use, options, regmatch)
     regmatch->regprog = vim_regcomp(pat, magic ? RE_MAGIC : 0);
     if (regmatch->regprog == NULL)
 	return FAIL;
+#ifdef FEAT_SEARCH_EXTRA
+    sidx_set_key(regmatch, pat, magic);
+#endif
     return OK;
 }
 
@@ -348,6 +376,9 @@ free_search_patterns()
 {
     vim_free(spats[0].pat);
     vim_free(spats[1].pat);
+# ifdef FEAT_SEARCH_EXTRA
+    vim_free(sidx_pat);
+# endif
 
 # ifdef FEAT_RIGHTLEFT
     if (mr_pattern_alloced)
@@ -513,6 +544,259 @@ last_pat_prog(regmatch)
 }
 #endif
 
+#if defined(FEAT_SEARCH_EXTRA) || defined(PROTO)
+/*
+ * Remember the pattern that "regmatch" was compiled from, for
+ * sidx_prepare().
+ */
+    static void
+sidx_set_key(regmatch, pat, magic)
+    regmmatch_T	*regmatch;
+    char_u	*pat;
+    int		magic;
+{
+    regprog_T	*prog = regmatch->regprog;
+
+    ++sidx_tick;
+    sidx_prog = NULL;
+    if (re_multiline(prog) || re_lookbehind(prog) || re_position(prog)
+						  || vim_regcomp_state() < 0)
+	return;
+    if (sidx_pat == NULL || STRCMP(sidx_pat, pat) != 0)
+    {
+	vim_free(sidx_pat);
+	sidx_pat = vim_strsave(pat);
+	if (sidx_pat == NULL)
+	    return;
+    }
+    sidx_magic = magic;
+    sidx_state = vim_regcomp_state();
+    sidx_prog = prog;
+}
+
+/*
+ * Prepare for using the search index of "buf" with "regmatch", which must
+ * have just been compiled by search_regcomp().  When the index is for
+ * another pattern it is cleared.
+ * Must be called again after the text of "buf" changed.
+ */
+    void
+sidx_prepare(buf, regmatch)
+    buf_T	*buf;
+    regmmatch_T	*regmatch;
+{
+    searchidx_T	*si = &buf->b_sidx;
+
+    /* Nothing to do when already prepared and the text didn't change. */
+    if (si->si_prog != NULL && si->si_prog == regmatch->regprog
+						   && si->si_tick == sidx_tick)
+	return;
+    si->si_prog = NULL;
+    if (regmatch->regprog == NULL || regmatch->regprog != sidx_prog)
+	return;
+
+    if (si->si_lines != NULL && (si->si_magic != sidx_magic
+		|| si->si_state != sidx_state
+		|| si->si_ic != regmatch->rmm_ic
+		|| STRCMP(si->si_pat, sidx_pat) != 0
+		|| STRCMP(si->si_isk, buf->b_p_isk) != 0
+		|| STRCMP(si->si_isi, p_isi) != 0
+		|| STRCMP(si->si_isf, p_isf) != 0
+		|| STRCMP(si->si_isp, p_isp) != 0
+#ifdef FEAT_MBYTE
+		|| si->si_cmp != cmp_flags
+#endif
+		))
+	sidx_clear(buf);
+    if (si->si_lines != NULL && si->si_mod_set)
+	sidx_apply_changes(buf);
+    if (si->si_lines != NULL && si->si_count != buf->b_ml.ml_line_count)
+	sidx_clear(buf);
+
+    if (si->si_lines == NULL)
+    {
+	si->si_pat = vim_strsave(sidx_pat);
+	si->si_isk = vim_strsave(buf->b_p_isk);
+	si->si_isi = vim_strsave(p_isi);
+	si->si_isf = vim_strsave(p_isf);
+	si->si_isp = vim_strsave(p_isp);
+	si->si_lines = alloc_clear(
+				 (unsigned)(buf->b_ml.ml_line_count + 1));
+	if (si->si_pat == NULL || si->si_isk == NULL || si->si_isi == NULL
+		|| si->si_isf == NULL || si->si_isp == NULL
+		|| si->si_lines == NULL)
+	{
+	    sidx_clear(buf);
+	    return;
+	}
+	si->si_count = buf->b_ml.ml_line_count;
+	si->si_magic = sidx_magic;
+	si->si_state = sidx_state;
+	si->si_ic = regmatch->rmm_ic;
+#ifdef FEAT_MBYTE
+	si->si_cmp = cmp_flags;
+#endif
+    }
+    si->si_prog = regmatch->regprog;
+    si->si_tick = sidx_tick;
+}
+
+/*
+ * Apply the changes collected by sidx_changed() to the search index of
+ * "buf": shift the lines below the change and forget the changed lines.
+ */
+    static void
+sidx_apply_changes(buf)
+    buf_T	*buf;
+{
+    searchidx_T	*si = &buf->b_sidx;
+    linenr_T	top = si->si_mod_top;
+    linenr_T	bot = si->si_mod_bot;
+    long	xtra = si->si_mod_xlines;
+    linenr_T	count = si->si_count + xtra;
+    char_u	*p;
+
+    if (top < 1 || top > bot || bot > count + 1 || bot - xtra < 1
+						 || bot - xtra > si->si_count + 1)
+    {
+	sidx_clear(buf);
+	return;
+    }
+    if (xtra > 0)
+    {
+	p = (char_u *)vim_realloc(si->si_lines, (size_t)(count + 1));
+	if (p == NULL)
+	{
+	    sidx_clear(buf);
+	    return;
+	}
+	si->si_lines = p;
+    }
+    if (xtra != 0)
+	mch_memmove(si->si_lines + bot, si->si_lines + bot - xtra,
+						   (size_t)(count + 1 - bot));
+    vim_memset(si->si_lines + top, 0, (size_t)(bot - top));
+    si->si_count = count;
+    si->si_mod_set = FALSE;
+}
+
+/*
+ * Return TRUE when the search index of "buf" knows that "regmatch" has no
+ * match in line "lnum".
+ */
+    int
+sidx_nomatch(buf, regmatch, lnum)
+    buf_T	*buf;
+    regmmatch_T	*regmatch;
+    linenr_T	lnum;
+{
+    searchidx_T	*si = &buf->b_sidx;
+
+    return si->si_prog != NULL && si->si_prog == regmatch->regprog
+	    && si->si_tick == sidx_tick && lnum <= si->si_count
+	    && si->si_lines[lnum];
+}
+
+/*
+ * Remember in the search index of "buf" that "regmatch" has no match in
+ * line "lnum".  Must only be used after searching the whole line.
+ */
+    void
+sidx_set_nomatch(buf, regmatch, lnum)
+    buf_T	*buf;
+    regmmatch_T	*regmatch;
+    linenr_T	lnum;
+{
+    searchidx_T	*si = &buf->b_sidx;
+
+    /* When interrupted the line may not have been searched completely. */
+    if (si->si_prog != NULL && si->si_prog == regmatch->regprog
+	    && si->si_tick == sidx_tick && lnum <= si->si_count && !got_int)
+	si->si_lines[lnum] = TRUE;
+}
+
+/*
+ * Called by the memline functions when lines "lnum" to "lnume" (not
+ * included) of "buf" changed, with "xtra" lines inserted.
+ */
+    void
+sidx_changed(buf, lnum, lnume, xtra)
+    buf_T	*buf;
+    linenr_T	lnum;
+    linenr_T	lnume;
+    long	xtra;
+{
+    searchidx_T	*si = &buf->b_sidx;
+
+    if (si->si_lines == NULL)
+	return;
+    if (xtra == 0 && lnume == lnum + 1)
+    {
+	/* One line replaced: forget about it, using the line number from
+	 * before the collected changes. */
+	if (!si->si_mod_set || lnum < si->si_mod_top)
+	{
+	    if (lnum <= si->si_count)
+		si->si_lines[lnum] = FALSE;
+	    return;
+	}
+	if (lnum >= si->si_mod_bot)
+	{
+	    if (lnum - si->si_mod_xlines >= 1
+				   && lnum - si->si_mod_xlines <= si->si_count)
+		si->si_lines[lnum - si->si_mod_xlines] = FALSE;
+	    return;
+	}
+	/* inside the changed lines, already forgotten */
+	return;
+    }
+
+    /* Lines inserted or deleted: the index can't be used until the changes
+     * have been applied by sidx_prepare(). */
+    si->si_prog = NULL;
+    if (si->si_mod_set)
+    {
+	/* same as for b_mod_top and b_mod_bot in changed_lines_buf() */
+	if (lnum < si->si_mod_top)
+	    si->si_mod_top = lnum;
+	if (lnum < si->si_mod_bot)
+	{
+	    si->si_mod_bot += xtra;
+	    if (si->si_mod_bot < lnum)
+		si->si_mod_bot = lnum;
+	}
+	if (lnume + xtra > si->si_mod_bot)
+	    si->si_mod_bot = lnume + xtra;
+	si->si_mod_xlines += xtra;
+    }
+    else
+    {
+	si->si_mod_set = TRUE;
+	si->si_mod_top = lnum;
+	si->si_mod_bot = lnume + xtra;
+	si->si_mod_xlines = xtra;
+    }
+}
+
+/*
+ * Free the search index of "buf".
+ */
+    void
+sidx_clear(buf)
+    buf_T	*buf;
+{
+    searchidx_T	*si = &buf->b_sidx;
+
+    vim_free(si->si_lines);
+    vim_free(si->si_pat);
+    vim_free(si->si_isk);
+    vim_free(si->si_isi);
+    vim_free(si->si_isf);
+    vim_free(si->si_isp);
+    vim_memset(si, 0, sizeof(searchidx_T));
+}
+#endif
+
 /*
  * Lowest level search function.
  * Search for 'count'th occurrence of pattern 'pat' in direction 'dir'.
@@ -574,6 +858,10 @@ searchit(win, buf, pos, dir, pat, count, options, pat_use, stop_lnum, tm)
 	return FAIL;
     }
 
+#ifdef FEAT_SEARCH_EXTRA
+    sidx_prepare(buf, &regmatch);
+#endif
+
     /*
      * find the string
      */
@@ -642,6 +930,12 @@ searchit(win, buf, pos, dir, pat, count, options, pat_use, stop_lnum, tm)
 		    break;
 #endif
 
+#ifdef FEAT_SEARCH_EXTRA
+		/* Skip a line the search index knows has no match. */
+		if (sidx_nomatch(buf, &regmatch, lnum))
+		    continue;
+#endif
+
 		/*
 		 * Look for a match somewhere in line "lnum".
 		 */
@@ -656,6 +950,14 @@ searchit(win, buf, pos, dir, pat, count, options, pat_use, stop_lnum, tm)
 		/* Abort searching on an error (e.g., out of stack). */
 		if (called_emsg)
 		    break;
+#ifdef FEAT_SEARCH_EXTRA
+		if (nmatched == 0
+# ifdef FEAT_RELTIME
+			&& (tm == NULL || !profile_passed_limit(tm))
+# endif
+			)
+		    sidx_set_nomatch(buf, &regmatch, lnum);
+#endif
 		if (nmatched > 0)
 		{
 		    /* match may actually be in another line when using \zs */
@@ -317,6 +317,8 @@ struct u_entry
     linenr_T	ue_lcount;	/* linecount when u_save called */
     char_u	**ue_array;	/* array of lines in undo block */
     long	ue_size;	/* number of lines in ue_array */
+    long	ue_alloc;	/* allocated size of ue_array when it was
+				   grown by u_savecommon(), zero otherwise */
 #ifdef U_DEBUG
     int		ue_magic;	/* magic number to check allocation */
 #endif
@@ -401,44 +403,53 @@ typedef struct memfile	    memfile_T;
 typedef long		    blocknr_T;
 
 /*
- * mf_hashtab_T is a chained hashtable with blocknr_T key and arbitrary
- * structures as items.  This is an intrusive data structure: we require
- * that items begin with mf_hashitem_T which contains the key and linked
- * list pointers.  List of items in each bucket is doubly-linked.
+ * mf_hashtab_T is an open addressing hashtable with blocknr_T key and
+ * arbitrary structures as items.  This is an intrusive data structure: we
+ * require that items begin with mf_hashitem_T which contains the key.
+ * Collisions are resolved with linear probing.  Each slot keeps a copy of the
+ * key, so that a lookup only touches the slot array and the item it finds.
+ * The table is kept at most half full.
  */
 
 typedef struct mf_hashitem_S mf_hashitem_T;
 
 struct mf_hashitem_S
 {
-    mf_hashitem_T   *mhi_next;
-    mf_hashitem_T   *mhi_prev;
     blocknr_T	    mhi_key;
 };
 
+typedef struct mf_hashslot_S
+{
+    blocknr_T	    mhs_key;	    /* copy of mhs_item->mhi_key */
+    mf_hashitem_T   *mhs_item;	    /* NULL for an empty slot */
+} mf_hashslot_T;
+
 #define MHT_INIT_SIZE   64
 
 typedef struct mf_hashtab_S
 {
-    long_u	    mht_mask;	    /* mask used for hash value (nr of items
+    long_u	    mht_mask;	    /* mask used for hash value (nr of slots
 				     * in array is "mht_mask" + 1) */
     long_u	    mht_count;	    /* nr of items inserted into hashtable */
-    mf_hashitem_T   **mht_buckets;  /* points to mht_small_buckets or
-				     *dynamically allocated array */
-    mf_hashitem_T   *mht_small_buckets[MHT_INIT_SIZE];   /* initial buckets */
+    mf_hashslot_T   *mht_slots;	    /* points to mht_small_slots or
+				     * dynamically allocated array */
+    mf_hashslot_T   mht_small_slots[MHT_INIT_SIZE];   /* initial slots */
     char	    mht_fixed;	    /* non-zero value forbids growth */
 } mf_hashtab_T;
 
 /*
  * for each (previously) used block in the memfile there is one block header.
  *
- * The block may be linked in the used list OR in the free list.
- * The used blocks are also kept in hash lists.
+ * The block may be linked in the used ring OR in the free list.
+ * The used blocks are also kept in the hash table.
  *
- * The used list is a doubly linked list, most recently used block first.
- *	The blocks in the used list have a block of memory allocated.
- *	mf_used_count is the number of pages in the used list.
- * The hash lists are used to quickly find a block in the used list.
+ * The used ring is a circular doubly linked list.  Blocks are released with
+ * the CLOCK algorithm: mf_used_hand points to the next block to consider,
+ * new blocks are inserted just before it.  A block that was used again since
+ * the hand passed it has BH_REF set and gets a second chance.
+ *	The blocks in the used ring have a block of memory allocated.
+ *	mf_used_count is the number of pages in the used ring.
+ * The hash table is used to quickly find a block in the used ring.
  * The free list is a single linked list, not sorted.
  *	The blocks in the free list have no block of memory allocated and
  *	the contents of the block in the file (if any) is irrelevant.
@@ -449,21 +460,23 @@ struct block_hdr
     mf_hashitem_T bh_hashitem;      /* header for hash table and key */
 #define bh_bnum bh_hashitem.mhi_key /* block number, part of bh_hashitem */
 
-    bhdr_T	*bh_next;	    /* next block_hdr in free or used list */
-    bhdr_T	*bh_prev;	    /* previous block_hdr in used list */
+    bhdr_T	*bh_next;	    /* next block_hdr in free list or used ring */
+    bhdr_T	*bh_prev;	    /* previous block_hdr in used ring */
     char_u	*bh_data;	    /* pointer to memory (for used block) */
     int		bh_page_count;	    /* number of pages in this block */
 
 #define BH_DIRTY    1
 #define BH_LOCKED   2
-    char	bh_flags;	    /* BH_DIRTY or BH_LOCKED */
+#define BH_REF	    4		    /* used since the clock hand passed */
+#define BH_SYNC	    8		    /* to be written by mf_sync(MFS_SLICE) */
+    char	bh_flags;	    /* BH_DIRTY, BH_LOCKED, BH_REF or BH_SYNC */
 };
 
 /*
  * when a block with a negative number is flushed to the file, it gets
  * a positive number. Because the reference to the block is still the negative
  * number, we remember the translation to the new positive number in the
- * double linked trans lists. The structure is the same as the hash lists.
+ * trans hash table. The items are kept like the block headers.
  */
 typedef struct nr_trans NR_TRANS;
 
@@ -565,18 +578,19 @@ struct memfile
     char_u	*mf_ffname;		/* idem, full path */
     int		mf_fd;			/* file descriptor */
     bhdr_T	*mf_free_first;		/* first block_hdr in free list */
-    bhdr_T	*mf_used_first;		/* mru block_hdr in used list */
-    bhdr_T	*mf_used_last;		/* lru block_hdr in used list */
-    unsigned	mf_used_count;		/* number of pages in used list */
+    bhdr_T	*mf_used_hand;		/* clock hand in ring of used blocks */
+    unsigned	mf_used_count;		/* number of pages in used ring */
     unsigned	mf_used_count_max;	/* maximum number of pages in memory */
-    mf_hashtab_T mf_hash;		/* hash lists */
-    mf_hashtab_T mf_trans;		/* trans lists */
+    mf_hashtab_T mf_hash;		/* blocks in memory by number */
+    mf_hashtab_T mf_trans;		/* trans table */
     blocknr_T	mf_blocknr_max;		/* highest positive block number + 1*/
     blocknr_T	mf_blocknr_min;		/* lowest negative block number - 1 */
     blocknr_T	mf_neg_count;		/* number of negative blocks numbers */
     blocknr_T	mf_infile_count;	/* number of pages in the file */
     unsigned	mf_page_size;		/* number of bytes in a page */
     int		mf_dirty;		/* TRUE if there are dirty blocks */
+    int		mf_sync_todo;		/* TRUE if there are blocks marked by
+					   mf_sync_start() to be written */
 #ifdef FEAT_CRYPT
     buf_T	*mf_buffer;		/* buffer this memfile is for */
     char_u	mf_seed[MF_SEED_LEN];	/* seed for encryption */
@@ -619,6 +633,34 @@ typedef struct ml_chunksize
 #define ML_CHNK_UPDLINE 3
 #endif
 
+/*
+ * When a file was read with 'largefile' set, data blocks that were not
+ * changed can be released without writing them to the swap file.  Their text
+ * is read back from the original file.  To find it, the byte offset of every
+ * ML_LAZY_STEP'th line is remembered.
+ */
+typedef struct ml_lazy_S
+{
+    int		mlz_fd;		/* file descriptor for the original file */
+    off_t	mlz_size;	/* size of the file when it was read */
+    time_t	mlz_mtime;	/* modification time when it was read */
+    int		mlz_fileformat;	/* EOL_UNIX or EOL_DOS */
+    garray_T	mlz_offsets;	/* offsets of lines 1, ML_LAZY_STEP + 1, etc. */
+} mllazy_T;
+
+/*
+ * Entry in the cache of recently used data blocks, see ml_find_line().
+ */
+typedef struct ml_cache_S
+{
+    blocknr_T	mlc_bnum;	/* block number */
+    int		mlc_page_count;	/* number of pages in the block */
+    linenr_T	mlc_low;	/* first line in the block */
+    linenr_T	mlc_high;	/* last line in the block */
+} mlcache_T;
+
+#define ML_CACHE_SIZE 8		/* number of entries in ml_cache */
+
 /*
  * the memline structure holds all the information about a memline
  */
@@ -632,6 +674,8 @@ typedef struct memline
 #define ML_LINE_DIRTY	2	/* cached line was changed and allocated */
 #define ML_LOCKED_DIRTY	4	/* ml_locked was changed */
 #define ML_LOCKED_POS	8	/* ml_locked needs positive block number */
+#define ML_LAZY_LOAD	16	/* reading a file for ml_lazy */
+#define ML_LOCKED_NOSTACK 32	/* ml_locked was found without the stack */
     int		ml_flags;
 
     infoptr_T	*ml_stack;	/* stack of pointer blocks (array of IPTRs) */
@@ -645,11 +689,23 @@ typedef struct memline
     linenr_T	ml_locked_low;	/* first line in ml_locked */
     linenr_T	ml_locked_high;	/* last line in ml_locked */
     int		ml_locked_lineadd;  /* number of lines inserted in ml_locked */
+
+    mlcache_T	ml_cache[ML_CACHE_SIZE]; /* recently used data blocks, most
+					    recently used first */
+    int		ml_cache_len;	/* number of valid entries in ml_cache */
+
+    long	ml_stat_line;	/* ml_get() found the cached line */
+    long	ml_stat_locked;	/* line was in the locked block */
+    long	ml_stat_cache;	/* line was in a block in ml_cache */
+    long	ml_stat_walk;	/* searched the tree of pointer blocks */
 #ifdef FEAT_BYTEOFF
     chunksize_T *ml_chunksize;
     int		ml_numchunks;
     int		ml_usedchunks;
+    chunksize_T *ml_chunktree;	/* Fenwick tree with sums of ml_chunksize,
+				   NULL when it must be rebuilt */
 #endif
+    mllazy_T	*ml_lazy;	/* info for reading back text or NULL */
 } memline_T;
 
 #if defined(FEAT_SIGNS) || defined(PROTO)
@@ -1262,7 +1318,16 @@ typedef struct {
     proftime_T	slowest;	/* time of slowest call */
     long	count;		/* nr of times used */
     long	match;		/* nr of times matched */
+    proftime_T	sync;		/* part of "total" used while syncing */
 } syn_time_T;
+
+/*
+ * Used for :syntime: time spent on syntax patterns in one line.
+ */
+typedef struct {
+    proftime_T	total;		/* total time used */
+    long	count;		/* nr of patterns tried */
+} syn_linetime_T;
 #endif
 
 #ifdef FEAT_CRYPT
@@ -1295,6 +1360,9 @@ typedef struct {
     int		b_syn_ic;		/* ignore case for :syn cmds */
     int		b_syn_spell;		/* SYNSPL_ values */
     garray_T	b_syn_patterns;		/* table for syntax patterns */
+    struct synlit_S *b_syn_lit;		/* text index for b_syn_patterns */
+    struct synkw_S *b_syn_kw;		/* perfect hash for b_keywtab and
+					   b_keywtab_ic */
     garray_T	b_syn_clusters;		/* table for syntax clusters */
     int		b_spell_cluster_id;	/* @Spell cluster ID or 0 */
     int		b_nospell_cluster_id;	/* @NoSpell cluster ID or 0 */
@@ -1309,6 +1377,7 @@ typedef struct {
     regprog_T	*b_syn_linecont_prog;	/* line continuation program */
 #ifdef FEAT_PROFILE
     syn_time_T  b_syn_linecont_time;
+    garray_T	b_syn_time_lines;	/* syn_linetime_T for each line */
 #endif
     int		b_syn_linecont_ic;	/* ignore-case flag for above */
     int		b_syn_topgrp;		/* for ":syntax include" */
@@ -1340,6 +1409,11 @@ typedef struct {
     int		b_sst_freecount;
     linenr_T	b_sst_check_lnum;
     short_u	b_sst_lasttick;	/* last display tick */
+    linenr_T	b_sst_ahead;	/* parse up to this line when idle, see
+				   'syntaxahead' */
+# ifdef FEAT_PERSISTENT_UNDO
+    int		b_sst_file_tried; /* tried reading 'synstatefile' */
+# endif
 #endif /* FEAT_SYN_HL */
 
 #ifdef FEAT_SPELL
@@ -1363,6 +1437,37 @@ typedef struct {
 } synblock_T;
 
 
+#ifdef FEAT_SEARCH_EXTRA
+/*
+ * Search index: remembers in which lines of a buffer the last used search
+ * pattern has no match.  See sidx_prepare() in search.c.
+ */
+typedef struct
+{
+    char_u	*si_lines;	/* for each line TRUE when there is no match,
+				   indexed by line number; NULL when unused */
+    linenr_T	si_count;	/* number of lines si_lines is for */
+    char_u	*si_pat;	/* pattern the index is for */
+    int		si_magic;	/* 'magic' used for si_pat */
+    int		si_state;	/* vim_regcomp_state() for si_pat */
+    int		si_ic;		/* ignore case used for si_pat */
+    char_u	*si_isk;	/* 'iskeyword' used for si_pat */
+    char_u	*si_isi;	/* 'isident' used for si_pat */
+    char_u	*si_isf;	/* 'isfname' used for si_pat */
+    char_u	*si_isp;	/* 'isprint' used for si_pat */
+#ifdef FEAT_MBYTE
+    unsigned	si_cmp;		/* 'casemap' flags used for si_pat */
+#endif
+    regprog_T	*si_prog;	/* regprog that may use the index */
+    int		si_tick;	/* sidx_tick when si_prog was set */
+    int		si_mod_set;	/* TRUE when lines were changed */
+    linenr_T	si_mod_top;	/* topmost changed line */
+    linenr_T	si_mod_bot;	/* line below the changed lines */
+    long	si_mod_xlines;	/* number of extra lines inserted */
+} searchidx_T;
+#endif
+
+
 /*
  * buffer: structure that holds information about one file
  *
@@ -1518,6 +1623,10 @@ struct file_buffer
     int		b_scanned;	/* ^N/^P have scanned this buffer */
 #endif
 
+#ifdef FEAT_SEARCH_EXTRA
+    searchidx_T	b_sidx;		/* search index */
+#endif
+
     /* flags for use of ":lmap" and IM control */
     long	b_p_iminsert;	/* input mode for insert */
     long	b_p_imsearch;	/* input mode for search */
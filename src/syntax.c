@@ -182,6 +182,76 @@ typedef struct syn_pattern
 
 #define NONE_IDX	-2	/* value of sp_sync_idx for "NONE" */
 
+/*
+ * Index of the text that must appear in a match of the "match" and region
+ * start patterns, see vim_regmust().  An Aho-Corasick automaton finds the
+ * text of all patterns in one pass over a line, so that the patterns whose
+ * text is not in the rest of the line don't need to be tried.
+ * The automaton works on bytes with ASCII case folded.  A node is found from
+ * its parent by following sn_child and then sn_sibling.
+ */
+typedef struct
+{
+    int		sn_child;	/* first child node, zero for none */
+    int		sn_sibling;	/* next child of the same parent, or zero */
+    int		sn_fail;	/* node for the longest proper suffix */
+    int		sn_dict;	/* next node on the fail chain with sn_lit */
+    int		sn_lit;		/* first text ending in this node, or -1 */
+    int		sn_byte;	/* byte leading to this node */
+} synlitnode_T;
+
+typedef struct
+{
+    int		sl_idx;		/* index in b_syn_patterns */
+    int		sl_len;		/* length of sl_text in bytes */
+    int		sl_ic;		/* ignore case */
+    int		sl_next;	/* next text ending in the same node or -1 */
+    char_u	*sl_text;	/* allocated */
+} synlittext_T;
+
+typedef struct synlit_S
+{
+    garray_T	sl_nodes;	/* synlitnode_T, node zero is the root */
+    garray_T	sl_texts;	/* synlittext_T */
+    int		sl_has_ic;	/* one of the texts ignores case */
+    int		*sl_lastcol;	/* per pattern: last start of its text in the
+				   line, -1 when not found, MAXCOL when it
+				   could not be checked */
+    int		sl_line_id;	/* current_line_id for sl_lastcol[] */
+    linenr_T	sl_lnum;	/* line number for sl_lastcol[] */
+    long	sl_changedtick;	/* b_changedtick for sl_lastcol[] */
+} synlit_T;
+
+#define SYN_LIT_NODES(sl)   ((synlitnode_T *)((sl)->sl_nodes.ga_data))
+#define SYN_LIT_TEXTS(sl)   ((synlittext_T *)((sl)->sl_texts.ga_data))
+
+/*
+ * Keyword table with perfect hashing, built from b_keywtab or b_keywtab_ic
+ * when keywords are first looked up.  A word hashes to a bucket, the
+ * displacement of the bucket selects the slot.  No two keywords use the same
+ * slot, thus one compare tells whether a word is a keyword.
+ * A bloom filter on the length and the first and last byte rejects most
+ * other words before the whole word is hashed.
+ */
+#define SYN_KW_BLOOM	2048	/* number of bits in the bloom filter */
+#define SYN_KW_MAXBUCKET 16	/* max. number of keywords in a bucket */
+
+typedef struct
+{
+    int		kt_mask;	/* number of slots minus one */
+    int		kt_bmask;	/* number of buckets minus one */
+    UINT32_T	kt_seed;	/* seed for the hash function */
+    int		*kt_disp;	/* displacement for each bucket */
+    keyentry_T	**kt_slots;	/* keyword for each slot; NULL when there is
+				   no table: use the hashtable */
+    char_u	kt_bloom[SYN_KW_BLOOM / 8];
+} synkwtab_T;
+
+typedef struct synkw_S
+{
+    synkwtab_T	sk_tab[2];	/* for b_keywtab and b_keywtab_ic */
+} synkw_T;
+
 /*
  * Flags for b_syn_sync_flags:
  */
@@ -372,6 +442,13 @@ static garray_T current_state		/* current stack of state_items */
 static short	*current_next_list = NULL; /* when non-zero, nextgroup list */
 static int	current_next_flags = 0; /* flags for current_next_list */
 static int	current_line_id = 0;	/* unique number for current line */
+#ifdef FEAT_RELTIME
+static int	current_ahead = FALSE;	/* current line is drawn without
+					   highlighting, see 'syntaxahead' */
+static proftime_T syn_ahead_tm;		/* time limit for drawing */
+static disptick_T syn_ahead_tick;	/* display_tick of syn_ahead_tm */
+static int	syn_ahead_tm_valid = FALSE; /* syn_ahead_tm was set */
+#endif
 
 #define CUR_STATE(idx)	((stateitem_T *)(current_state.ga_data))[idx]
 
@@ -380,6 +457,16 @@ static int syn_match_linecont __ARGS((linenr_T lnum));
 static void syn_start_line __ARGS((void));
 static void syn_update_ends __ARGS((int startofline));
 static void syn_stack_alloc __ARGS((void));
+#ifdef FEAT_PERSISTENT_UNDO
+static char_u *syn_state_file_name __ARGS((char_u *ffname, int reading));
+static void syn_state_hash_nr __ARGS((context_sha256_T *ctx, long nr));
+static void syn_state_hash_id __ARGS((context_sha256_T *ctx, synblock_T *block, int id));
+static void syn_state_hash_list __ARGS((context_sha256_T *ctx, synblock_T *block, short *list));
+static void syn_state_hash_keywords __ARGS((context_sha256_T *ctx, synblock_T *block, hashtab_T *ht));
+static void syn_state_hash_syntax __ARGS((buf_T *buf, synblock_T *block, char_u *hash));
+static void syn_state_hash_text __ARGS((buf_T *buf, char_u *hash));
+static void syn_state_read __ARGS((void));
+#endif
 static int syn_stack_cleanup __ARGS((void));
 static void syn_stack_free_entry __ARGS((synblock_T *block, synstate_T *p));
 static synstate_T *syn_stack_find_entry __ARGS((linenr_T lnum));
@@ -409,7 +496,17 @@ static int _RTLENTRYF syn_compare_syntime __ARGS((const void *v1, const void *v2
 static int syn_compare_syntime __ARGS((const void *v1, const void *v2));
 #endif
 static void syntime_report __ARGS((void));
+static void syntime_groups __ARGS((garray_T *gap));
+static void syntime_report_groups __ARGS((void));
+static void syntime_report_lines __ARGS((void));
+static void syn_time_add_line __ARGS((linenr_T lnum, proftime_T *tm));
+# ifdef FEAT_EVAL
+static void syntime_tv __ARGS((typval_T *tv, proftime_T *tm));
+static void syntime_dict_add __ARGS((dict_T *d, char *key, proftime_T *tm));
+# endif
 static int syn_time_on = FALSE;
+static int syn_time_syncing = FALSE;	/* parsing lines before the one that
+					   is displayed */
 # define IF_SYN_TIME(p) (p)
 #else
 # define IF_SYN_TIME(p) NULL
@@ -427,6 +524,20 @@ static void syn_add_end_off __ARGS((lpos_T *result, regmmatch_T *regmatch, synpa
 static void syn_add_start_off __ARGS((lpos_T *result, regmmatch_T *regmatch, synpat_T *spp, int idx, int extra));
 static char_u *syn_getcurline __ARGS((void));
 static int syn_regexec __ARGS((regmmatch_T *rmp, linenr_T lnum, colnr_T col, syn_time_T *st));
+static int syn_lit_child __ARGS((synlit_T *sl, int node, int c));
+static int syn_lit_add __ARGS((synlit_T *sl, int idx, char_u *text, int ic));
+static synlit_T *syn_lit_build __ARGS((synblock_T *block));
+static void syn_lit_scan __ARGS((synlit_T *sl, char_u *line));
+static synlit_T *syn_lit_get __ARGS((void));
+static void syn_lit_clear __ARGS((synblock_T *block));
+static UINT32_T syn_kw_mix __ARGS((UINT32_T h));
+static UINT32_T syn_kw_hash __ARGS((UINT32_T seed, char_u *word, int len, int fold));
+static int syn_kw_slot __ARGS((synkwtab_T *kt, UINT32_T h, int disp));
+static int syn_kw_bloom_bit __ARGS((int len, int first, int last, int round));
+static void syn_kw_build_tab __ARGS((synkwtab_T *kt, hashtab_T *ht));
+static synkw_T *syn_kw_get __ARGS((void));
+static keyentry_T *syn_kw_find __ARGS((synkwtab_T *kt, char_u *word, int len, int fold));
+static void syn_kw_clear __ARGS((synblock_T *block));
 static int check_keyword_id __ARGS((char_u *line, int startcol, int *endcol, long *flags, short **next_list, stateitem_T *cur_si, int *ccharp));
 static void syn_cmd_case __ARGS((exarg_T *eap, int syncing));
 static void syn_cmd_spell __ARGS((exarg_T *eap, int syncing));
@@ -477,6 +588,7 @@ static void syn_cmd_sync __ARGS((exarg_T *eap, int syncing));
 static int get_id_list __ARGS((char_u **arg, int keylen, short **list));
 static void syn_combine_list __ARGS((short **clstr1, short **clstr2, int list_op));
 static void syn_incl_toplevel __ARGS((int id, int *flagsp));
+static void syn_start_parse __ARGS((win_T *wp, linenr_T lnum, proftime_T *tm));
 
 /*
  * Start the syntax recognition for a line.  This function is normally called
@@ -489,6 +601,47 @@ static void syn_incl_toplevel __ARGS((int id, int *flagsp));
 syntax_start(wp, lnum)
     win_T	*wp;
     linenr_T	lnum;
+{
+    syn_start_parse(wp, lnum, NULL);
+}
+
+/*
+ * Like syntax_start(), but for drawing line "lnum" in window "wp".
+ * When 'syntaxahead' is set and parsing for the current screen update takes
+ * longer than that, the line is drawn without highlighting.  The rest of the
+ * parsing is then done by syntax_ahead().
+ */
+    void
+syntax_start_draw(wp, lnum)
+    win_T	*wp;
+    linenr_T	lnum;
+{
+#ifdef FEAT_RELTIME
+    if (p_sya > 0)
+    {
+	if (!syn_ahead_tm_valid || syn_ahead_tick != display_tick)
+	{
+	    profile_setlimit(p_sya, &syn_ahead_tm);
+	    syn_ahead_tick = display_tick;
+	    syn_ahead_tm_valid = TRUE;
+	}
+	syn_start_parse(wp, lnum, &syn_ahead_tm);
+	return;
+    }
+#endif
+    syn_start_parse(wp, lnum, NULL);
+}
+
+/*
+ * Parse from a saved state or a sync point until the start of line "lnum".
+ * When "tm" is not NULL stop when that time limit has passed, store the
+ * state reached and remember "lnum" in b_sst_ahead.
+ */
+    static void
+syn_start_parse(wp, lnum, tm)
+    win_T	*wp;
+    linenr_T	lnum;
+    proftime_T	*tm UNUSED;
 {
     synstate_T	*p;
     synstate_T	*last_valid = NULL;
@@ -502,6 +655,9 @@ syntax_start(wp, lnum)
 #ifdef FEAT_CONCEAL
     current_sub_char = NUL;
 #endif
+#ifdef FEAT_RELTIME
+    current_ahead = FALSE;
+#endif
 
     /*
      * After switching buffers, invalidate current_state.
@@ -524,6 +680,9 @@ syntax_start(wp, lnum)
     if (syn_block->b_sst_array == NULL)
 	return;		/* out of memory */
     syn_block->b_sst_lasttick = display_tick;
+#ifdef FEAT_PROFILE
+    syn_time_syncing = TRUE;
+#endif
 
     /*
      * If the state of the end of the previous line is useful, store it.
@@ -655,9 +814,98 @@ syntax_start(wp, lnum)
 	    current_lnum = lnum;
 	    break;
 	}
+
+#ifdef FEAT_RELTIME
+	/* Out of time: store the state, so that syntax_ahead() can continue
+	 * from here.  Can't stop at a line where the state can't be stored. */
+	if (tm != NULL && current_lnum < lnum && current_lnum >= first_stored
+		&& profile_passed_limit(tm) && store_current_state() != NULL)
+	{
+	    if (syn_block->b_sst_ahead < lnum)
+		syn_block->b_sst_ahead = lnum;
+	    invalidate_current_state();
+	    current_ahead = TRUE;
+	    break;
+	}
+#endif
     }
 
-    syn_start_line();
+#ifdef FEAT_PROFILE
+    syn_time_syncing = FALSE;
+#endif
+#ifdef FEAT_RELTIME
+    if (!current_ahead)
+#endif
+	syn_start_line();
+}
+
+/*
+ * Continue parsing for lines that were drawn without highlighting because of
+ * 'syntaxahead'.  Called when waiting for the user to type a character.
+ * Works in steps of 'syntaxahead' msec until a character is available.
+ * Windows for which the parsing is done are redrawn later.
+ */
+    void
+syntax_ahead()
+{
+#ifdef FEAT_RELTIME
+    win_T	*wp;
+    win_T	*wp2;
+    synblock_T	*block;
+    linenr_T	lnum;
+    proftime_T	tm;
+    int		save_did_emsg;
+
+    /* The next screen update gets a new time limit. */
+    syn_ahead_tm_valid = FALSE;
+    if (p_sya <= 0)
+	return;
+    /* Not when executing commands from a mapping, script or ":normal", the
+     * text or the windows may be about to change. */
+    if (textlock != 0 || ex_normal_busy || !stuff_empty())
+	return;
+
+    FOR_ALL_WINDOWS(wp)
+    {
+	block = wp->w_s;
+	while (block->b_sst_ahead != 0)
+	{
+	    if (ui_char_avail())
+		return;
+	    lnum = block->b_sst_ahead;
+	    block->b_sst_ahead = 0;
+	    if (!syntax_present(wp) || block->b_syn_error)
+		break;
+	    if (lnum > wp->w_buffer->b_ml.ml_line_count)
+		lnum = wp->w_buffer->b_ml.ml_line_count;
+
+	    profile_setlimit(p_sya, &tm);
+	    save_did_emsg = did_emsg;
+	    did_emsg = FALSE;
+	    syn_start_parse(wp, lnum, &tm);
+	    if (did_emsg)
+	    {
+		block->b_syn_error = TRUE;
+		block->b_sst_ahead = 0;
+	    }
+	    did_emsg |= save_did_emsg;
+	    if (got_int)
+	    {
+		/* CTRL-C typed: the state is wrong, leave it to the next
+		 * screen update. */
+		block->b_sst_ahead = 0;
+		invalidate_current_state();
+		return;
+	    }
+	    /* Done: the main loop redraws the windows, a redraw is not
+	     * possible here, e.g. in getchar() or input(). */
+	    if (block->b_sst_ahead == 0)
+		FOR_ALL_WINDOWS(wp2)
+		    if (wp2->w_s == block)
+			redraw_win_later(wp2, NOT_VALID);
+	}
+    }
+#endif
 }
 
 /*
@@ -1149,6 +1397,7 @@ syn_stack_free_block(block)
 	block->b_sst_array = NULL;
 	block->b_sst_len = 0;
     }
+    block->b_sst_ahead = 0;
 }
 /*
  * Free b_sst_array[] for buffer "buf".
@@ -1249,9 +1498,564 @@ syn_stack_alloc()
 	vim_free(syn_block->b_sst_array);
 	syn_block->b_sst_array = sstp;
 	syn_block->b_sst_len = len;
+
+#ifdef FEAT_PERSISTENT_UNDO
+	/* Use the states saved when the buffer was unloaded, once. */
+	if (syn_block->b_sst_first == NULL && p_ssf
+					      && !syn_block->b_sst_file_tried)
+	{
+	    syn_block->b_sst_file_tried = TRUE;
+	    syn_state_read();
+	}
+#endif
+    }
+}
+
+#if defined(FEAT_PERSISTENT_UNDO) || defined(PROTO)
+/*
+ * Saving the states in b_sst_array[] in a file, for 'synstatefile'.
+ * The file is named like the undo file of "{file}.syn".  It contains:
+ *	SSF_START_MAGIC and SSF_VERSION (2 bytes)
+ *	hash of the text and hash of the syntax items (UNDO_HASH_SIZE each)
+ *	number of lines (4 bytes)
+ * For each state:
+ *	line number, index of the pattern with sst_next_list plus one or
+ *	zero, sst_next_flags (4 bytes each) and the stack size (2 bytes)
+ *	for each stack entry: bs_idx, bs_flags, bs_seqnr, bs_cchar (4 bytes
+ *	each), the number of external matches (1 byte) and for each match
+ *	its length plus one or zero (4 bytes) and the text
+ * A zero line number (4 bytes) ends the file.
+ */
+# define SSF_START_MAGIC	"Vim\237SyNsT"	/* magic at start of file */
+# define SSF_START_MAGIC_LEN	9
+# define SSF_VERSION		1
+
+# ifndef SEEK_SET
+#  define SEEK_SET 0
+# endif
+# ifndef SEEK_END
+#  define SEEK_END 2
+# endif
+
+/*
+ * Return an allocated string with the name of the syntax state file for
+ * "ffname", or NULL.  "reading" is passed to u_get_undo_file_name().
+ */
+    static char_u *
+syn_state_file_name(ffname, reading)
+    char_u	*ffname;
+    int		reading;
+{
+    char_u	*name;
+    char_u	*file_name = NULL;
+
+    name = concat_str(ffname, (char_u *)".syn");
+    if (name != NULL)
+    {
+	file_name = u_get_undo_file_name(name, reading);
+	vim_free(name);
     }
+    return file_name;
+}
+
+    static void
+syn_state_hash_nr(ctx, nr)
+    context_sha256_T	*ctx;
+    long		nr;
+{
+    char_u	buf[4];
+
+    buf[0] = (char_u)(nr >> 24);
+    buf[1] = (char_u)(nr >> 16);
+    buf[2] = (char_u)(nr >> 8);
+    buf[3] = (char_u)nr;
+    sha256_update(ctx, buf, 4);
 }
 
+/*
+ * Add group or cluster "id" to the hash.  Uses the name, the number depends
+ * on the order in which groups were defined.
+ */
+    static void
+syn_state_hash_id(ctx, block, id)
+    context_sha256_T	*ctx;
+    synblock_T		*block;
+    int			id;
+{
+    char_u	*name = NULL;
+
+    if (id >= SYNID_CLUSTER)
+    {
+	if (id - SYNID_CLUSTER < block->b_syn_clusters.ga_len)
+	    name = SYN_CLSTR(block)[id - SYNID_CLUSTER].scl_name;
+    }
+    else if (id > 0 && id < SYNID_ALLBUT && id <= highlight_ga.ga_len)
+	name = HL_TABLE()[id - 1].sg_name;
+    if (name != NULL)
+	sha256_update(ctx, name, (UINT32_T)(STRLEN(name) + 1));
+    else
+	syn_state_hash_nr(ctx, (long)id);
+}
+
+    static void
+syn_state_hash_list(ctx, block, list)
+    context_sha256_T	*ctx;
+    synblock_T		*block;
+    short		*list;
+{
+    if (list == NULL)
+	syn_state_hash_nr(ctx, -1L);
+    else
+    {
+	for ( ; *list != 0; ++list)
+	    syn_state_hash_id(ctx, block, *list);
+	syn_state_hash_nr(ctx, 0L);
+    }
+}
+
+/*
+ * Add the keywords in hashtable "ht" to the hash.  They are added in the
+ * order of the hashtable, a different order only means the saved states are
+ * not used.
+ */
+    static void
+syn_state_hash_keywords(ctx, block, ht)
+    context_sha256_T	*ctx;
+    synblock_T		*block;
+    hashtab_T		*ht;
+{
+    hashitem_T	*hi;
+    keyentry_T	*kp;
+    int		todo;
+
+    syn_state_hash_nr(ctx, (long)ht->ht_used);
+    todo = (int)ht->ht_used;
+    for (hi = ht->ht_array; todo > 0; ++hi)
+    {
+	if (!HASHITEM_EMPTY(hi))
+	{
+	    --todo;
+	    for (kp = HI2KE(hi); kp != NULL; kp = kp->ke_next)
+	    {
+		sha256_update(ctx, kp->keyword,
+					   (UINT32_T)(STRLEN(kp->keyword) + 1));
+		syn_state_hash_id(ctx, block, kp->k_syn.id);
+		syn_state_hash_nr(ctx, (long)kp->k_syn.inc_tag);
+		syn_state_hash_list(ctx, block, kp->k_syn.cont_in_list);
+		syn_state_hash_list(ctx, block, kp->next_list);
+		syn_state_hash_nr(ctx, (long)kp->flags);
+		syn_state_hash_nr(ctx, (long)kp->k_char);
+	    }
+	    syn_state_hash_nr(ctx, 0L);
+	}
+    }
+}
+
+/*
+ * Compute the hash of the syntax items in "block" and the options of "buf"
+ * that are used for them into hash[UNDO_HASH_SIZE].  The saved states are
+ * only valid for the same items.
+ */
+    static void
+syn_state_hash_syntax(buf, block, hash)
+    buf_T	*buf;
+    synblock_T	*block;
+    char_u	*hash;
+{
+    context_sha256_T	ctx;
+    synpat_T		*spp;
+    syn_cluster_T	*scp;
+    int			i;
+    int			j;
+
+    sha256_start(&ctx);
+    syn_state_hash_nr(&ctx, (long)block->b_syn_patterns.ga_len);
+    for (i = 0; i < block->b_syn_patterns.ga_len; ++i)
+    {
+	spp = &(SYN_ITEMS(block)[i]);
+	syn_state_hash_nr(&ctx, (long)spp->sp_type);
+	syn_state_hash_nr(&ctx, (long)spp->sp_syncing);
+	syn_state_hash_nr(&ctx, (long)spp->sp_flags);
+	syn_state_hash_nr(&ctx, (long)spp->sp_ic);
+	syn_state_hash_nr(&ctx, (long)spp->sp_off_flags);
+	for (j = 0; j < SPO_COUNT; ++j)
+	    syn_state_hash_nr(&ctx, (long)spp->sp_offsets[j]);
+	syn_state_hash_nr(&ctx, (long)spp->sp_sync_idx);
+	syn_state_hash_nr(&ctx, (long)spp->sp_syn.inc_tag);
+	syn_state_hash_id(&ctx, block, spp->sp_syn.id);
+	syn_state_hash_id(&ctx, block, spp->sp_syn_match_id);
+	if (spp->sp_pattern != NULL)
+	    sha256_update(&ctx, spp->sp_pattern,
+					(UINT32_T)(STRLEN(spp->sp_pattern) + 1));
+	syn_state_hash_list(&ctx, block, spp->sp_cont_list);
+	syn_state_hash_list(&ctx, block, spp->sp_next_list);
+	syn_state_hash_list(&ctx, block, spp->sp_syn.cont_in_list);
+    }
+    syn_state_hash_nr(&ctx, (long)block->b_syn_ic);
+    syn_state_hash_nr(&ctx, (long)block->b_syn_containedin);
+    syn_state_hash_nr(&ctx, (long)block->b_syn_sync_flags);
+    syn_state_hash_id(&ctx, block, block->b_syn_sync_id);
+    syn_state_hash_nr(&ctx, (long)block->b_syn_sync_minlines);
+    syn_state_hash_nr(&ctx, (long)block->b_syn_sync_maxlines);
+    syn_state_hash_nr(&ctx, (long)block->b_syn_sync_linebreaks);
+    if (block->b_syn_linecont_pat != NULL)
+	sha256_update(&ctx, block->b_syn_linecont_pat,
+			     (UINT32_T)(STRLEN(block->b_syn_linecont_pat) + 1));
+
+    syn_state_hash_keywords(&ctx, block, &block->b_keywtab);
+    syn_state_hash_keywords(&ctx, block, &block->b_keywtab_ic);
+    syn_state_hash_nr(&ctx, (long)block->b_syn_clusters.ga_len);
+    for (i = 0; i < block->b_syn_clusters.ga_len; ++i)
+    {
+	scp = &SYN_CLSTR(block)[i];
+	syn_state_hash_id(&ctx, block, SYNID_CLUSTER + i);
+	syn_state_hash_list(&ctx, block, scp->scl_list);
+    }
+
+    syn_state_hash_nr(&ctx, buf->b_p_smc);
+    sha256_update(&ctx, buf->b_p_isk, (UINT32_T)(STRLEN(buf->b_p_isk) + 1));
+#ifdef FEAT_MBYTE
+    sha256_update(&ctx, p_enc, (UINT32_T)(STRLEN(p_enc) + 1));
+#endif
+    sha256_finish(&ctx, hash);
+}
+
+/*
+ * Compute the hash of the text of "buf" into hash[UNDO_HASH_SIZE].
+ * Like u_compute_hash(), but for any buffer.
+ */
+    static void
+syn_state_hash_text(buf, hash)
+    buf_T	*buf;
+    char_u	*hash;
+{
+    context_sha256_T	ctx;
+    linenr_T		lnum;
+    char_u		*p;
+
+    sha256_start(&ctx);
+    for (lnum = 1; lnum <= buf->b_ml.ml_line_count; ++lnum)
+    {
+	p = ml_get_buf(buf, lnum, FALSE);
+	sha256_update(&ctx, p, (UINT32_T)(STRLEN(p) + 1));
+    }
+    sha256_finish(&ctx, hash);
+}
+
+/*
+ * Load the states for syn_buf that were saved by syn_state_write(), when
+ * the text and the syntax items are still the same.  Called when
+ * b_sst_array[] was just allocated and is empty.
+ */
+    static void
+syn_state_read()
+{
+    char_u	*file_name;
+    FILE	*fp = NULL;
+    char_u	magic[SSF_START_MAGIC_LEN];
+    char_u	text_hash[UNDO_HASH_SIZE];
+    char_u	syn_hash[UNDO_HASH_SIZE];
+    char_u	hash[UNDO_HASH_SIZE];
+    synstate_T	*last = NULL;
+    synstate_T	*p;
+    garray_T	ga;
+    bufstate_T	*bp;
+    long	file_size;
+    long	lnum;
+    long	prev_lnum = 0;
+    int		next_idx;
+    int		next_flags;
+    int		size;
+    int		n;
+    int		len;
+    int		i;
+    int		j;
+    int		bad;
+
+    if (syn_block != &syn_buf->b_s || syn_buf->b_ffname == NULL
+						     || bufIsChanged(syn_buf))
+	return;
+    file_name = syn_state_file_name(syn_buf->b_ffname, TRUE);
+    if (file_name == NULL)
+	return;
+    fp = mch_fopen((char *)file_name, READBIN);
+    if (fp == NULL)
+	goto theend;
+    /* The size is used to check the length of the texts. */
+    if (fseek(fp, 0L, SEEK_END) != 0 || (file_size = ftell(fp)) < 0
+					     || fseek(fp, 0L, SEEK_SET) != 0)
+	goto theend;
+
+    if (fread(magic, SSF_START_MAGIC_LEN, 1, fp) != 1
+	    || memcmp(magic, SSF_START_MAGIC, SSF_START_MAGIC_LEN) != 0
+	    || get2c(fp) != SSF_VERSION
+	    || fread(text_hash, UNDO_HASH_SIZE, 1, fp) != 1
+	    || fread(syn_hash, UNDO_HASH_SIZE, 1, fp) != 1
+	    || get4c(fp) != syn_buf->b_ml.ml_line_count)
+	goto theend;
+    syn_state_hash_syntax(syn_buf, syn_block, hash);
+    if (memcmp(hash, syn_hash, UNDO_HASH_SIZE) != 0)
+	goto theend;
+    syn_state_hash_text(syn_buf, hash);
+    if (memcmp(hash, text_hash, UNDO_HASH_SIZE) != 0)
+	goto theend;
+
+    /* Read states until the end marker, an error or no room left. */
+    while (syn_block->b_sst_freecount > 0)
+    {
+	lnum = get4c(fp);
+	if (lnum <= prev_lnum || lnum > syn_buf->b_ml.ml_line_count)
+	    break;
+	next_idx = get4c(fp);
+	next_flags = get4c(fp);
+	size = get2c(fp);
+	if (next_idx < 0 || next_idx > syn_block->b_syn_patterns.ga_len
+							    || size > 0x7fff)
+	    break;
+
+	ga_init2(&ga, (int)sizeof(bufstate_T), 10);
+	bad = FALSE;
+	for (i = 0; i < size && !bad; ++i)
+	{
+	    if (ga_grow(&ga, 1) == FAIL)
+	    {
+		bad = TRUE;
+		break;
+	    }
+	    bp = SYN_STATE_P(&ga) + ga.ga_len;
+	    bp->bs_idx = get4c(fp);
+	    bp->bs_flags = get4c(fp);
+#ifdef FEAT_CONCEAL
+	    bp->bs_seqnr = get4c(fp);
+	    bp->bs_cchar = get4c(fp);
+#else
+	    (void)get4c(fp);
+	    (void)get4c(fp);
+#endif
+	    bp->bs_extmatch = NULL;
+	    n = getc(fp);
+	    if (bp->bs_idx < 0 || bp->bs_idx >= syn_block->b_syn_patterns.ga_len
+						       || n < 0 || n > NSUBEXP)
+	    {
+		bad = TRUE;
+		break;
+	    }
+	    ++ga.ga_len;
+	    if (n > 0)
+	    {
+		bp->bs_extmatch = (reg_extmatch_T *)alloc_clear(
+					     (unsigned)sizeof(reg_extmatch_T));
+		if (bp->bs_extmatch == NULL)
+		    bad = TRUE;
+		else
+		    bp->bs_extmatch->refcnt = 1;
+	    }
+	    for (j = 0; j < n && !bad; ++j)
+	    {
+		len = get4c(fp);
+		if (len < 0 || len - 1 > file_size - ftell(fp))
+		    bad = TRUE;
+		else if (len > 0 && (bp->bs_extmatch->matches[j]
+					= read_string(fp, len - 1)) == NULL)
+		    bad = TRUE;
+	    }
+	}
+	if (bad || feof(fp))
+	{
+	    for (i = 0; i < ga.ga_len; ++i)
+		unref_extmatch(SYN_STATE_P(&ga)[i].bs_extmatch);
+	    ga_clear(&ga);
+	    break;
+	}
+
+	/* Move the first free entry to the end of the list. */
+	p = syn_block->b_sst_firstfree;
+	syn_block->b_sst_firstfree = p->sst_next;
+	--syn_block->b_sst_freecount;
+	p->sst_next = NULL;
+	if (last == NULL)
+	    syn_block->b_sst_first = p;
+	else
+	    last->sst_next = p;
+	last = p;
+
+	p->sst_lnum = lnum;
+	p->sst_stacksize = size;
+	if (size > SST_FIX_STATES)
+	    p->sst_union.sst_ga = ga;
+	else
+	{
+	    if (size > 0)
+		mch_memmove(p->sst_union.sst_stack, ga.ga_data,
+					       (size_t)size * sizeof(bufstate_T));
+	    ga_clear(&ga);
+	}
+	p->sst_next_list = next_idx == 0 ? NULL
+			       : SYN_ITEMS(syn_block)[next_idx - 1].sp_next_list;
+	p->sst_next_flags = next_flags;
+	p->sst_tick = display_tick;
+	p->sst_change_lnum = 0;
+	prev_lnum = lnum;
+    }
+
+theend:
+    if (fp != NULL)
+	fclose(fp);
+    vim_free(file_name);
+}
+
+/*
+ * Write the states in b_sst_array[] of "buf" to a file, when 'synstatefile'
+ * is set.  Called when the buffer is unloaded and when exiting.
+ */
+    void
+syn_state_write(buf)
+    buf_T	*buf;
+{
+    synblock_T	*block = &buf->b_s;
+    synstate_T	*p;
+    bufstate_T	*bp;
+    char_u	*file_name;
+    FILE	*fp;
+    int		fd;
+    int		perm;
+    char_u	magic[SSF_START_MAGIC_LEN];
+    char_u	hash[UNDO_HASH_SIZE];
+    int		next_idx;
+    int		i;
+    int		j;
+    int		n;
+    char_u	*s;
+    int		ok;
+
+    if (!p_ssf || buf->b_ffname == NULL || buf->b_ml.ml_mfp == NULL
+	    || block->b_sst_first == NULL || bt_dontwrite(buf)
+	    || bufIsChanged(buf) || buf->b_mod_set)
+	return;
+    file_name = syn_state_file_name(buf->b_ffname, FALSE);
+    if (file_name == NULL)
+	return;
+
+    /* Only overwrite a file that is a syntax state file. */
+    fp = mch_fopen((char *)file_name, READBIN);
+    if (fp != NULL)
+    {
+	ok = fread(magic, SSF_START_MAGIC_LEN, 1, fp) == 1
+		  && memcmp(magic, SSF_START_MAGIC, SSF_START_MAGIC_LEN) == 0;
+	fclose(fp);
+	if (!ok)
+	    goto theend;
+	mch_remove(file_name);
+    }
+
+    /* Use the permissions of the file, without any s-bit. */
+    perm = mch_getperm(buf->b_ffname);
+    if (perm < 0)
+	perm = 0600;
+    fd = mch_open((char *)file_name,
+		   O_CREAT|O_EXTRA|O_WRONLY|O_EXCL|O_NOFOLLOW, perm & 0777);
+    if (fd < 0)
+	goto theend;
+    fp = fdopen(fd, "w");
+    if (fp == NULL)
+    {
+	close(fd);
+	mch_remove(file_name);
+	goto theend;
+    }
+    if (p_verbose > 0)
+    {
+	verbose_enter();
+	smsg((char_u *)_("Writing syntax state file: %s"), file_name);
+	verbose_leave();
+    }
+
+    fwrite(SSF_START_MAGIC, (size_t)SSF_START_MAGIC_LEN, (size_t)1, fp);
+    put_bytes(fp, (long_u)SSF_VERSION, 2);
+    syn_state_hash_text(buf, hash);
+    fwrite(hash, (size_t)UNDO_HASH_SIZE, (size_t)1, fp);
+    syn_state_hash_syntax(buf, block, hash);
+    fwrite(hash, (size_t)UNDO_HASH_SIZE, (size_t)1, fp);
+    put_bytes(fp, (long_u)buf->b_ml.ml_line_count, 4);
+
+    for (p = block->b_sst_first; p != NULL; p = p->sst_next)
+    {
+	if (p->sst_change_lnum != 0)
+	    continue;
+	/* A "nextgroup" list can only be saved when it is from a pattern. */
+	next_idx = 0;
+	if (p->sst_next_list != NULL)
+	{
+	    for (i = 0; i < block->b_syn_patterns.ga_len; ++i)
+		if (SYN_ITEMS(block)[i].sp_next_list == p->sst_next_list)
+		    break;
+	    if (i == block->b_syn_patterns.ga_len)
+		continue;
+	    next_idx = i + 1;
+	}
+	if (p->sst_stacksize > SST_FIX_STATES)
+	    bp = SYN_STATE_P(&(p->sst_union.sst_ga));
+	else
+	    bp = p->sst_union.sst_stack;
+	for (i = 0; i < p->sst_stacksize; ++i)
+	    if (bp[i].bs_idx < 0)
+		break;
+	if (i < p->sst_stacksize)
+	    continue;
+
+	put_bytes(fp, (long_u)p->sst_lnum, 4);
+	put_bytes(fp, (long_u)next_idx, 4);
+	put_bytes(fp, (long_u)p->sst_next_flags, 4);
+	put_bytes(fp, (long_u)p->sst_stacksize, 2);
+	for (i = 0; i < p->sst_stacksize; ++i)
+	{
+	    put_bytes(fp, (long_u)bp[i].bs_idx, 4);
+	    put_bytes(fp, (long_u)bp[i].bs_flags, 4);
+#ifdef FEAT_CONCEAL
+	    put_bytes(fp, (long_u)bp[i].bs_seqnr, 4);
+	    put_bytes(fp, (long_u)bp[i].bs_cchar, 4);
+#else
+	    put_bytes(fp, (long_u)0, 4);
+	    put_bytes(fp, (long_u)0, 4);
+#endif
+	    n = bp[i].bs_extmatch == NULL ? 0 : NSUBEXP;
+	    putc(n, fp);
+	    for (j = 0; j < n; ++j)
+	    {
+		s = bp[i].bs_extmatch->matches[j];
+		if (s == NULL)
+		    put_bytes(fp, (long_u)0, 4);
+		else
+		{
+		    put_bytes(fp, (long_u)STRLEN(s) + 1, 4);
+		    fwrite(s, STRLEN(s), (size_t)1, fp);
+		}
+	    }
+	}
+    }
+    put_bytes(fp, (long_u)0, 4);
+
+    ok = !ferror(fp);
+    if (fclose(fp) != 0 || !ok)
+	mch_remove(file_name);
+
+theend:
+    vim_free(file_name);
+}
+
+/*
+ * Write the syntax state file for all loaded buffers.  Used when exiting.
+ */
+    void
+syn_state_write_all()
+{
+    buf_T	*buf;
+
+    for (buf = firstbuf; buf != NULL; buf = buf->b_next)
+	syn_state_write(buf);
+}
+#endif
+
 /*
  * Check for changes in a buffer to affect stored syntax states.  Uses the
  * b_mod_* fields.
@@ -1828,8 +2632,13 @@ get_syntax_attr(col, can_spell, keep_state)
     if (syn_block->b_sst_array == NULL)
 	return 0;
 
-    /* After 'synmaxcol' the attribute is always zero. */
-    if (syn_buf->b_p_smc > 0 && col >= (colnr_T)syn_buf->b_p_smc)
+    /* After 'synmaxcol' the attribute is always zero.  Also when the state
+     * for the line has not been parsed yet, see 'syntaxahead'. */
+    if ((syn_buf->b_p_smc > 0 && col >= (colnr_T)syn_buf->b_p_smc)
+#ifdef FEAT_RELTIME
+	    || current_ahead
+#endif
+	    )
     {
 	clear_current_state();
 #ifdef FEAT_EVAL
@@ -1891,6 +2700,7 @@ syn_current_attr(syncing, displaying, can_spell, keep_state)
     lpos_T	pos;
     int		lc_col;
     reg_extmatch_T *cur_extmatch = NULL;
+    synlit_T	*sl;
     char_u	*line;		/* current line.  NOTE: becomes invalid after
 				   looking for a pattern match! */
 
@@ -2062,6 +2872,7 @@ syn_current_attr(syncing, displaying, can_spell, keep_state)
 		     */
 		    next_match_idx = 0;		/* no match in this line yet */
 		    next_match_col = MAXCOL;
+		    sl = syn_lit_get();
 		    for (idx = syn_block->b_syn_patterns.ga_len; --idx >= 0; )
 		    {
 			spp = &(SYN_ITEMS(syn_block)[idx]);
@@ -2092,6 +2903,14 @@ syn_current_attr(syncing, displaying, can_spell, keep_state)
 			    if (lc_col < 0)
 				lc_col = 0;
 
+			    /* Skip the pattern when the text that a match
+			     * must contain is not in the rest of the line. */
+			    if (sl != NULL && sl->sl_lastcol[idx] < lc_col)
+			    {
+				spp->sp_startcol = MAXCOL;
+				continue;
+			    }
+
 			    regmatch.rmm_ic = spp->sp_ic;
 			    regmatch.regprog = spp->sp_prog;
 			    r = syn_regexec(&regmatch,
@@ -3249,60 +4068,634 @@ syn_add_start_off(result, regmatch, spp, idx, extra)
 	}
 	col = (int)(p - base);
     }
-    result->col = col;
+    result->col = col;
+}
+
+/*
+ * Get current line in syntax buffer.
+ */
+    static char_u *
+syn_getcurline()
+{
+    return ml_get_buf(syn_buf, current_lnum, FALSE);
+}
+
+/*
+ * Call vim_regexec() to find a match with "rmp" in "syn_buf".
+ * Returns TRUE when there is a match.
+ */
+    static int
+syn_regexec(rmp, lnum, col, st)
+    regmmatch_T	*rmp;
+    linenr_T	lnum;
+    colnr_T	col;
+    syn_time_T  *st UNUSED;
+{
+    int r;
+#ifdef FEAT_PROFILE
+    proftime_T	pt;
+
+    if (syn_time_on)
+	profile_start(&pt);
+#endif
+
+    rmp->rmm_maxcol = syn_buf->b_p_smc;
+    r = vim_regexec_multi(rmp, syn_win, syn_buf, lnum, col, NULL);
+
+#ifdef FEAT_PROFILE
+    if (syn_time_on)
+    {
+	profile_end(&pt);
+	profile_add(&st->total, &pt);
+	if (syn_time_syncing)
+	    profile_add(&st->sync, &pt);
+	if (profile_cmp(&pt, &st->slowest) < 0)
+	    st->slowest = pt;
+	++st->count;
+	if (r > 0)
+	    ++st->match;
+	syn_time_add_line(lnum, &pt);
+    }
+#endif
+
+    if (r > 0)
+    {
+	rmp->startpos[0].lnum += lnum;
+	rmp->endpos[0].lnum += lnum;
+	return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Return the child of "node" for byte "c", zero when there is none.
+ */
+    static int
+syn_lit_child(sl, node, c)
+    synlit_T	*sl;
+    int		node;
+    int		c;
+{
+    synlitnode_T *nodes = SYN_LIT_NODES(sl);
+    int		n;
+
+    for (n = nodes[node].sn_child; n != 0; n = nodes[n].sn_sibling)
+	if (nodes[n].sn_byte == c)
+	    break;
+    return n;
+}
+
+/*
+ * Add "text", which must be in a match of pattern "idx", to the index.
+ */
+    static int
+syn_lit_add(sl, idx, text, ic)
+    synlit_T	*sl;
+    int		idx;
+    char_u	*text;
+    int		ic;
+{
+    synlitnode_T *np;
+    synlittext_T *tp;
+    char_u	*p;
+    int		node = 0;
+    int		next;
+    int		c;
+
+    for (p = text; *p != NUL; ++p)
+    {
+	c = TOLOWER_ASC(*p);
+	next = syn_lit_child(sl, node, c);
+	if (next == 0)
+	{
+	    if (ga_grow(&sl->sl_nodes, 1) == FAIL)
+		return FAIL;
+	    next = sl->sl_nodes.ga_len++;
+	    np = &SYN_LIT_NODES(sl)[next];
+	    vim_memset(np, 0, sizeof(synlitnode_T));
+	    np->sn_lit = -1;
+	    np->sn_byte = c;
+	    np->sn_sibling = SYN_LIT_NODES(sl)[node].sn_child;
+	    SYN_LIT_NODES(sl)[node].sn_child = next;
+	}
+	node = next;
+    }
+
+    if (ga_grow(&sl->sl_texts, 1) == FAIL)
+	return FAIL;
+    tp = &SYN_LIT_TEXTS(sl)[sl->sl_texts.ga_len];
+    tp->sl_text = vim_strsave(text);
+    if (tp->sl_text == NULL)
+	return FAIL;
+    tp->sl_idx = idx;
+    tp->sl_len = (int)STRLEN(text);
+    tp->sl_ic = ic;
+    tp->sl_next = SYN_LIT_NODES(sl)[node].sn_lit;
+    SYN_LIT_NODES(sl)[node].sn_lit = sl->sl_texts.ga_len++;
+    if (ic)
+	sl->sl_has_ic = TRUE;
+    return OK;
+}
+
+/*
+ * Build the text index for the patterns of "block".
+ * Returns NULL when out of memory.
+ */
+    static synlit_T *
+syn_lit_build(block)
+    synblock_T	*block;
+{
+    synlit_T	*sl;
+    synlitnode_T *nodes;
+    synpat_T	*spp;
+    char_u	*text;
+    char_u	*p;
+    int		ic;
+    int		idx;
+    int		*queue;
+    int		head = 0;
+    int		tail = 0;
+    int		node;
+    int		child;
+    int		f;
+
+    sl = (synlit_T *)alloc_clear((unsigned)sizeof(synlit_T));
+    if (sl == NULL)
+	return NULL;
+    ga_init2(&sl->sl_nodes, (int)sizeof(synlitnode_T), 64);
+    ga_init2(&sl->sl_texts, (int)sizeof(synlittext_T), 16);
+    sl->sl_lastcol = (int *)alloc((unsigned)(sizeof(int)
+					  * (block->b_syn_patterns.ga_len + 1)));
+    if (sl->sl_lastcol == NULL || ga_grow(&sl->sl_nodes, 1) == FAIL)
+	goto fail;
+
+    /* the root node */
+    vim_memset(sl->sl_nodes.ga_data, 0, sizeof(synlitnode_T));
+    SYN_LIT_NODES(sl)[0].sn_lit = -1;
+    sl->sl_nodes.ga_len = 1;
+
+    for (idx = 0; idx < block->b_syn_patterns.ga_len; ++idx)
+    {
+	sl->sl_lastcol[idx] = MAXCOL;
+	spp = &(SYN_ITEMS(block)[idx]);
+	if ((spp->sp_type != SPTYPE_MATCH && spp->sp_type != SPTYPE_START)
+						       || spp->sp_prog == NULL)
+	    continue;
+	text = vim_regmust(spp->sp_prog, spp->sp_ic, &ic);
+	if (text == NULL)
+	    continue;
+	/* Only ASCII case folding is done here. */
+	if (ic)
+	{
+	    for (p = text; *p != NUL && *p < 0x80; ++p)
+		;
+	    if (*p != NUL)
+		continue;
+	}
+	if (syn_lit_add(sl, idx, text, ic) == FAIL)
+	    goto fail;
+    }
+
+    /*
+     * Compute the fail and dictionary links, breadth first.
+     */
+    queue = (int *)alloc((unsigned)(sizeof(int) * sl->sl_nodes.ga_len));
+    if (queue == NULL)
+	goto fail;
+    nodes = SYN_LIT_NODES(sl);
+    for (child = nodes[0].sn_child; child != 0; child = nodes[child].sn_sibling)
+	queue[tail++] = child;
+    while (head < tail)
+    {
+	node = queue[head++];
+	for (child = nodes[node].sn_child; child != 0;
+					      child = nodes[child].sn_sibling)
+	{
+	    f = nodes[node].sn_fail;
+	    while (f != 0 && syn_lit_child(sl, f, nodes[child].sn_byte) == 0)
+		f = nodes[f].sn_fail;
+	    f = syn_lit_child(sl, f, nodes[child].sn_byte);
+	    nodes[child].sn_fail = f;
+	    nodes[child].sn_dict = nodes[f].sn_lit >= 0 ? f : nodes[f].sn_dict;
+	    queue[tail++] = child;
+	}
+    }
+    vim_free(queue);
+
+    sl->sl_line_id = -1;
+    return sl;
+
+fail:
+    block->b_syn_lit = sl;
+    syn_lit_clear(block);
+    return NULL;
+}
+
+/*
+ * Find where the texts of index "sl" are in "line" and set sl_lastcol[].
+ */
+    static void
+syn_lit_scan(sl, line)
+    synlit_T	*sl;
+    char_u	*line;
+{
+    synlitnode_T *nodes = SYN_LIT_NODES(sl);
+    synlittext_T *texts = SYN_LIT_TEXTS(sl);
+    int		node = 0;
+    int		n;
+    int		t;
+    int		i;
+    int		c;
+    int		col;
+    int		has_high = FALSE;
+
+    for (t = 0; t < sl->sl_texts.ga_len; ++t)
+	sl->sl_lastcol[texts[t].sl_idx] = -1;
+
+    for (i = 0; line[i] != NUL; ++i)
+    {
+	c = line[i];
+	if (c >= 0x80)
+	    has_high = TRUE;
+	c = TOLOWER_ASC(c);
+	for (;;)
+	{
+	    n = syn_lit_child(sl, node, c);
+	    if (n != 0 || node == 0)
+		break;
+	    node = nodes[node].sn_fail;
+	}
+	node = n;
+
+	/* Every text ending here, longest first. */
+	for (n = nodes[node].sn_lit >= 0 ? node : nodes[node].sn_dict; n != 0;
+							 n = nodes[n].sn_dict)
+	    for (t = nodes[n].sn_lit; t >= 0; t = texts[t].sl_next)
+	    {
+		col = i + 1 - texts[t].sl_len;
+		if (texts[t].sl_ic || STRNCMP(line + col, texts[t].sl_text,
+							 texts[t].sl_len) == 0)
+		    sl->sl_lastcol[texts[t].sl_idx] = col;
+	    }
+    }
+
+    /* Case folding of other characters than ASCII is not done here, can't
+     * tell whether the text is there. */
+    if (has_high && sl->sl_has_ic)
+	for (t = 0; t < sl->sl_texts.ga_len; ++t)
+	    if (texts[t].sl_ic)
+		sl->sl_lastcol[texts[t].sl_idx] = MAXCOL;
+}
+
+/*
+ * Get the text index for the current syntax block, with sl_lastcol[] set for
+ * the current line.  Returns NULL when there is no index.
+ */
+    static synlit_T *
+syn_lit_get()
+{
+    synlit_T	*sl;
+
+    if (syn_block->b_syn_lit == NULL)
+	syn_block->b_syn_lit = syn_lit_build(syn_block);
+    sl = syn_block->b_syn_lit;
+    if (sl == NULL || sl->sl_texts.ga_len == 0)
+	return NULL;
+
+    if (sl->sl_line_id != current_line_id || sl->sl_lnum != current_lnum
+		       || sl->sl_changedtick != syn_buf->b_changedtick)
+    {
+	syn_lit_scan(sl, syn_getcurline());
+	sl->sl_line_id = current_line_id;
+	sl->sl_lnum = current_lnum;
+	sl->sl_changedtick = syn_buf->b_changedtick;
+    }
+    return sl;
+}
+
+/*
+ * Free the text index of "block".  Must be done when patterns are added or
+ * removed.
+ */
+    static void
+syn_lit_clear(block)
+    synblock_T	*block;
+{
+    synlit_T	*sl = block->b_syn_lit;
+    int		t;
+
+    if (sl == NULL)
+	return;
+    for (t = 0; t < sl->sl_texts.ga_len; ++t)
+	vim_free(SYN_LIT_TEXTS(sl)[t].sl_text);
+    ga_clear(&sl->sl_texts);
+    ga_clear(&sl->sl_nodes);
+    vim_free(sl->sl_lastcol);
+    vim_free(sl);
+    block->b_syn_lit = NULL;
+}
+
+/*
+ * Mix the bits of "h", so that each bit of the result depends on all bits.
+ */
+    static UINT32_T
+syn_kw_mix(h)
+    UINT32_T	h;
+{
+    h ^= h >> 16;
+    h *= (UINT32_T)0x85ebca6bUL;
+    h ^= h >> 13;
+    h *= (UINT32_T)0xc2b2ae35UL;
+    h ^= h >> 16;
+    return h;
+}
+
+/*
+ * Hash "len" bytes of "word".  When "fold" is TRUE ASCII upper case letters
+ * are hashed as lower case.
+ */
+    static UINT32_T
+syn_kw_hash(seed, word, len, fold)
+    UINT32_T	seed;
+    char_u	*word;
+    int		len;
+    int		fold;
+{
+    UINT32_T	h = seed ^ (UINT32_T)2166136261UL;
+    int		i;
+
+    if (fold)
+	for (i = 0; i < len; ++i)
+	    h = (h ^ TOLOWER_ASC(word[i])) * (UINT32_T)16777619UL;
+    else
+	for (i = 0; i < len; ++i)
+	    h = (h ^ word[i]) * (UINT32_T)16777619UL;
+    return syn_kw_mix(h);
+}
+
+/*
+ * Return the slot in "kt" for hash "h" with displacement "disp".  The step is
+ * odd, thus all slots are reached when "disp" goes from zero to kt_mask.
+ */
+    static int
+syn_kw_slot(kt, h, disp)
+    synkwtab_T	*kt;
+    UINT32_T	h;
+    int		disp;
+{
+    UINT32_T	base = syn_kw_mix(h ^ (UINT32_T)0x9e3779b9UL);
+    UINT32_T	step = syn_kw_mix(base ^ (UINT32_T)0x7f4a7c15UL) | 1;
+
+    return (int)((base + (UINT32_T)disp * step) & (UINT32_T)kt->kt_mask);
+}
+
+/*
+ * Return bit "round" (zero or one) in the bloom filter for a word of "len"
+ * bytes starting with "first" and ending in "last".
+ */
+    static int
+syn_kw_bloom_bit(len, first, last, round)
+    int		len;
+    int		first;
+    int		last;
+    int		round;
+{
+    UINT32_T	sig = ((UINT32_T)len << 16) + ((UINT32_T)first << 8) + last;
+
+    sig *= round == 0 ? (UINT32_T)0x9e3779b1UL : (UINT32_T)0x85ebca6bUL;
+    return (int)(sig >> 21);
+}
+
+/*
+ * Build the perfect hash table "kt" for the keywords in "ht".
+ * When out of memory or no table was found kt_slots is NULL.
+ */
+    static void
+syn_kw_build_tab(kt, ht)
+    synkwtab_T	*kt;
+    hashtab_T	*ht;
+{
+    int		n = (int)ht->ht_used;
+    keyentry_T	**keys;
+    UINT32_T	*hashes;
+    int		*next;		/* next keyword in the same bucket */
+    int		*first;		/* first keyword in each bucket */
+    int		*size;		/* number of keywords in each bucket */
+    int		slot[SYN_KW_MAXBUCKET];
+    hashitem_T	*hi;
+    int		todo;
+    int		nslots;
+    int		nbuckets;
+    int		max_size;
+    int		attempt;
+    int		placed = FALSE;
+    int		s, b, d, i, j, k;
+
+    vim_memset(kt, 0, sizeof(synkwtab_T));
+    if (n == 0)
+	return;
+    for (nslots = 2; nslots < n * 2; nslots <<= 1)
+	;
+    for (nbuckets = 1; nbuckets * 4 < n; nbuckets <<= 1)
+	;
+    keys = (keyentry_T **)alloc((unsigned)(sizeof(keyentry_T *) * n));
+    hashes = (UINT32_T *)alloc((unsigned)(sizeof(UINT32_T) * n));
+    next = (int *)alloc((unsigned)(sizeof(int) * n));
+    first = (int *)alloc((unsigned)(sizeof(int) * nbuckets));
+    size = (int *)alloc((unsigned)(sizeof(int) * nbuckets));
+    kt->kt_disp = (int *)alloc((unsigned)(sizeof(int) * nbuckets));
+    if (keys == NULL || hashes == NULL || next == NULL || first == NULL
+					|| size == NULL || kt->kt_disp == NULL)
+	goto theend;
+    kt->kt_bmask = nbuckets - 1;
+
+    todo = n;
+    i = 0;
+    for (hi = ht->ht_array; todo > 0; ++hi)
+	if (!HASHITEM_EMPTY(hi))
+	{
+	    char_u  *w;
+	    int	    len;
+
+	    --todo;
+	    keys[i++] = HI2KE(hi);
+	    w = HI2KE(hi)->keyword;
+	    len = (int)STRLEN(w);
+	    for (j = 0; j < 2; ++j)
+	    {
+		k = syn_kw_bloom_bit(len, w[0], w[len - 1], j);
+		kt->kt_bloom[k >> 3] |= 1 << (k & 7);
+	    }
+	}
+
+    /* Try a few seeds, then try again with twice as many slots. */
+    for (attempt = 0; attempt < 24 && !placed; ++attempt)
+    {
+	if (attempt > 0 && attempt % 8 == 0)
+	    nslots <<= 1;
+	vim_free(kt->kt_slots);
+	kt->kt_slots = (keyentry_T **)alloc_clear(
+				     (unsigned)(sizeof(keyentry_T *) * nslots));
+	if (kt->kt_slots == NULL)
+	    goto theend;
+	kt->kt_mask = nslots - 1;
+	kt->kt_seed = (UINT32_T)attempt * (UINT32_T)0x9e3779b9UL;
+
+	for (b = 0; b < nbuckets; ++b)
+	{
+	    first[b] = -1;
+	    size[b] = 0;
+	}
+	max_size = 0;
+	for (i = 0; i < n; ++i)
+	{
+	    char_u *w = keys[i]->keyword;
+
+	    hashes[i] = syn_kw_hash(kt->kt_seed, w, (int)STRLEN(w), FALSE);
+	    b = (int)(hashes[i] & (UINT32_T)kt->kt_bmask);
+	    next[i] = first[b];
+	    first[b] = i;
+	    if (++size[b] > max_size)
+		max_size = size[b];
+	}
+	if (max_size > SYN_KW_MAXBUCKET)
+	    continue;
+
+	/* Place the largest buckets first, while there are many free slots. */
+	placed = TRUE;
+	for (s = max_size; s > 0 && placed; --s)
+	    for (b = 0; b < nbuckets && placed; ++b)
+	    {
+		if (size[b] != s)
+		    continue;
+		for (d = 0; d < nslots; ++d)
+		{
+		    for (k = 0, i = first[b]; i >= 0; i = next[i], ++k)
+		    {
+			slot[k] = syn_kw_slot(kt, hashes[i], d);
+			if (kt->kt_slots[slot[k]] != NULL)
+			    break;
+			for (j = 0; j < k; ++j)
+			    if (slot[j] == slot[k])
+				break;
+			if (j < k)
+			    break;
+		    }
+		    if (i < 0)
+			break;
+		}
+		if (d == nslots)
+		{
+		    placed = FALSE;
+		    break;
+		}
+		kt->kt_disp[b] = d;
+		for (k = 0, i = first[b]; i >= 0; i = next[i], ++k)
+		    kt->kt_slots[slot[k]] = keys[i];
+	    }
+    }
+
+theend:
+    if (!placed)
+    {
+	vim_free(kt->kt_slots);
+	kt->kt_slots = NULL;
+    }
+    vim_free(keys);
+    vim_free(hashes);
+    vim_free(next);
+    vim_free(first);
+    vim_free(size);
 }
 
 /*
- * Get current line in syntax buffer.
+ * Get the keyword tables for the current syntax block, build them when
+ * needed.  Returns NULL when out of memory.
  */
-    static char_u *
-syn_getcurline()
+    static synkw_T *
+syn_kw_get()
 {
-    return ml_get_buf(syn_buf, current_lnum, FALSE);
+    synkw_T	*sk = syn_block->b_syn_kw;
+
+    if (sk == NULL)
+    {
+	sk = (synkw_T *)alloc((unsigned)sizeof(synkw_T));
+	if (sk == NULL)
+	    return NULL;
+	syn_kw_build_tab(&sk->sk_tab[0], &syn_block->b_keywtab);
+	syn_kw_build_tab(&sk->sk_tab[1], &syn_block->b_keywtab_ic);
+	syn_block->b_syn_kw = sk;
+    }
+    return sk;
 }
 
 /*
- * Call vim_regexec() to find a match with "rmp" in "syn_buf".
- * Returns TRUE when there is a match.
+ * Find the first keyword entry for the "len" bytes at "word" in "kt".
+ * When "fold" is TRUE ASCII upper case letters in "word" match lower case.
+ * Returns NULL when "word" is not a keyword.
  */
-    static int
-syn_regexec(rmp, lnum, col, st)
-    regmmatch_T	*rmp;
-    linenr_T	lnum;
-    colnr_T	col;
-    syn_time_T  *st UNUSED;
+    static keyentry_T *
+syn_kw_find(kt, word, len, fold)
+    synkwtab_T	*kt;
+    char_u	*word;
+    int		len;
+    int		fold;
 {
-    int r;
-#ifdef FEAT_PROFILE
-    proftime_T	pt;
+    keyentry_T	*kp;
+    UINT32_T	h;
+    int		first = word[0];
+    int		last = word[len - 1];
+    int		i;
 
-    if (syn_time_on)
-	profile_start(&pt);
-#endif
+    if (fold)
+    {
+	first = TOLOWER_ASC(first);
+	last = TOLOWER_ASC(last);
+    }
+    for (i = 0; i < 2; ++i)
+    {
+	int k = syn_kw_bloom_bit(len, first, last, i);
 
-    rmp->rmm_maxcol = syn_buf->b_p_smc;
-    r = vim_regexec_multi(rmp, syn_win, syn_buf, lnum, col, NULL);
+	if ((kt->kt_bloom[k >> 3] & (1 << (k & 7))) == 0)
+	    return NULL;
+    }
 
-#ifdef FEAT_PROFILE
-    if (syn_time_on)
+    h = syn_kw_hash(kt->kt_seed, word, len, fold);
+    kp = kt->kt_slots[syn_kw_slot(kt, h,
+			   kt->kt_disp[h & (UINT32_T)kt->kt_bmask])];
+    if (kp == NULL || kp->keyword[len] != NUL)
+	return NULL;
+    if (fold)
     {
-	profile_end(&pt);
-	profile_add(&st->total, &pt);
-	if (profile_cmp(&pt, &st->slowest) < 0)
-	    st->slowest = pt;
-	++st->count;
-	if (r > 0)
-	    ++st->match;
+	for (i = 0; i < len; ++i)
+	    if (kp->keyword[i] != TOLOWER_ASC(word[i]))
+		return NULL;
     }
-#endif
+    else if (STRNCMP(kp->keyword, word, len) != 0)
+	return NULL;
+    return kp;
+}
 
-    if (r > 0)
+/*
+ * Free the keyword tables of "block".  Must be done when keywords are added
+ * or removed.
+ */
+    static void
+syn_kw_clear(block)
+    synblock_T	*block;
+{
+    synkw_T	*sk = block->b_syn_kw;
+    int		i;
+
+    if (sk == NULL)
+	return;
+    for (i = 0; i < 2; ++i)
     {
-	rmp->startpos[0].lnum += lnum;
-	rmp->endpos[0].lnum += lnum;
-	return TRUE;
+	vim_free(sk->sk_tab[i].kt_disp);
+	vim_free(sk->sk_tab[i].kt_slots);
     }
-    return FALSE;
+    vim_free(sk);
+    block->b_syn_kw = NULL;
 }
 
 /*
@@ -3324,9 +4717,12 @@ check_keyword_id(line, startcol, endcolp, flagsp, next_listp, cur_si, ccharp)
     char_u	*kwp;
     int		round;
     int		kwlen;
+    int		ascii = TRUE;
     char_u	keyword[MAXKEYWLEN + 1]; /* assume max. keyword len is 80 */
     hashtab_T	*ht;
     hashitem_T	*hi;
+    synkw_T	*sk;
+    synkwtab_T	*kt;
 
     /* Find first character after the keyword.  First character was already
      * checked. */
@@ -3334,6 +4730,8 @@ check_keyword_id(line, startcol, endcolp, flagsp, next_listp, cur_si, ccharp)
     kwlen = 0;
     do
     {
+	if (kwp[kwlen] >= 0x80)
+	    ascii = FALSE;
 #ifdef FEAT_MBYTE
 	if (has_mbyte)
 	    kwlen += (*mb_ptr2len)(kwp + kwlen);
@@ -3345,12 +4743,13 @@ check_keyword_id(line, startcol, endcolp, flagsp, next_listp, cur_si, ccharp)
 
     if (kwlen > MAXKEYWLEN)
 	return 0;
+#ifdef FEAT_MBYTE
+    /* Only for UTF-8 str_foldcase() does not depend on the locale. */
+    if (!enc_utf8)
+#endif
+	ascii = FALSE;
 
-    /*
-     * Must make a copy of the keyword, so we can add a NUL and make it
-     * lowercase.
-     */
-    vim_strncpy(keyword, kwp, kwlen);
+    sk = syn_kw_get();
 
     /*
      * Try twice:
@@ -3362,36 +4761,57 @@ check_keyword_id(line, startcol, endcolp, flagsp, next_listp, cur_si, ccharp)
 	ht = round == 1 ? &syn_block->b_keywtab : &syn_block->b_keywtab_ic;
 	if (ht->ht_used == 0)
 	    continue;
-	if (round == 2)	/* ignore case */
-	    (void)str_foldcase(kwp, kwlen, keyword, MAXKEYWLEN + 1);
+	kt = sk == NULL ? NULL : &sk->sk_tab[round - 1];
 
 	/*
 	 * Find keywords that match.  There can be several with different
 	 * attributes.
+	 * The perfect hash table is used without a copy of the keyword.  When
+	 * ignoring case this only works for ASCII with UTF-8, other words
+	 * are folded with str_foldcase() first.
+	 */
+	if (kt != NULL && kt->kt_slots != NULL && (round == 1 || ascii))
+	    kp = syn_kw_find(kt, kwp, kwlen, round == 2);
+	else
+	{
+	    /* Must make a copy of the keyword, so we can add a NUL and make
+	     * it lowercase. */
+	    if (round == 2)
+		(void)str_foldcase(kwp, kwlen, keyword, MAXKEYWLEN + 1);
+	    else
+		vim_strncpy(keyword, kwp, kwlen);
+	    if (kt != NULL && kt->kt_slots != NULL)
+		kp = syn_kw_find(kt, keyword, (int)STRLEN(keyword), FALSE);
+	    else
+	    {
+		hi = hash_find(ht, keyword);
+		kp = HASHITEM_EMPTY(hi) ? NULL : HI2KE(hi);
+	    }
+	}
+
+	/*
 	 * When current_next_list is non-zero accept only that group, otherwise:
 	 *  Accept a not-contained keyword at toplevel.
 	 *  Accept a keyword at other levels only if it is in the contains list.
 	 */
-	hi = hash_find(ht, keyword);
-	if (!HASHITEM_EMPTY(hi))
-	    for (kp = HI2KE(hi); kp != NULL; kp = kp->ke_next)
+	for ( ; kp != NULL; kp = kp->ke_next)
+	{
+	    if (current_next_list != 0
+		    ? in_id_list(NULL, current_next_list, &kp->k_syn, 0)
+		    : (cur_si == NULL
+			? !(kp->flags & HL_CONTAINED)
+			: in_id_list(cur_si, cur_si->si_cont_list,
+				  &kp->k_syn, kp->flags & HL_CONTAINED)))
 	    {
-		if (current_next_list != 0
-			? in_id_list(NULL, current_next_list, &kp->k_syn, 0)
-			: (cur_si == NULL
-			    ? !(kp->flags & HL_CONTAINED)
-			    : in_id_list(cur_si, cur_si->si_cont_list,
-				      &kp->k_syn, kp->flags & HL_CONTAINED)))
-		{
-		    *endcolp = startcol + kwlen;
-		    *flagsp = kp->flags;
-		    *next_listp = kp->next_list;
+		*endcolp = startcol + kwlen;
+		*flagsp = kp->flags;
+		*next_listp = kp->next_list;
 #ifdef FEAT_CONCEAL
-		    *ccharp = kp->k_char;
+		*ccharp = kp->k_char;
 #endif
-		    return kp->k_syn.id;
-		}
+		return kp->k_syn.id;
 	    }
+	}
     }
     return 0;
 }
@@ -3487,10 +4907,12 @@ syntax_clear(block)
     block->b_syn_containedin = FALSE;
 
     /* free the keywords */
+    syn_kw_clear(block);
     clear_keywtab(&block->b_keywtab);
     clear_keywtab(&block->b_keywtab_ic);
 
     /* free the syntax patterns */
+    syn_lit_clear(block);
     for (i = block->b_syn_patterns.ga_len; --i >= 0; )
 	syn_clear_pattern(block, i);
     ga_clear(&block->b_syn_patterns);
@@ -3518,6 +4940,12 @@ syntax_clear(block)
     /* free the stored states */
     syn_stack_free_all(block);
     invalidate_current_state();
+#ifdef FEAT_PERSISTENT_UNDO
+    block->b_sst_file_tried = FALSE;
+#endif
+#ifdef FEAT_PROFILE
+    ga_clear(&block->b_syn_time_lines);
+#endif
 
     /* Reset the counter for ":syn include" */
     running_syn_inc_tag = 0;
@@ -3583,6 +5011,7 @@ syn_remove_pattern(block, idx)
     mch_memmove(spp, spp + 1,
 		   sizeof(synpat_T) * (block->b_syn_patterns.ga_len - idx - 1));
     --block->b_syn_patterns.ga_len;
+    syn_lit_clear(block);
 }
 
 /*
@@ -3719,6 +5148,7 @@ syn_clear_one(id, syncing)
     /* Clear keywords only when not ":syn sync clear group-name" */
     if (!syncing)
     {
+	syn_kw_clear(curwin->w_s);
 	(void)syn_clear_keyword(id, &curwin->w_s->b_keywtab);
 	(void)syn_clear_keyword(id, &curwin->w_s->b_keywtab_ic);
     }
@@ -4447,6 +5877,7 @@ add_keyword(name, id, flags, cont_in_list, next_list, conceal_char)
 	ht = &curwin->w_s->b_keywtab_ic;
     else
 	ht = &curwin->w_s->b_keywtab;
+    syn_kw_clear(curwin->w_s);
 
     hash = hash_hash(kp->keyword);
     hi = hash_lookup(ht, kp->keyword, hash);
@@ -4985,6 +6416,7 @@ syn_cmd_match(eap, syncing)
 		curwin->w_s->b_syn_containedin = TRUE;
 	    SYN_ITEMS(curwin->w_s)[idx].sp_next_list = syn_opt_arg.next_list;
 	    ++curwin->w_s->b_syn_patterns.ga_len;
+	    syn_lit_clear(curwin->w_s);
 
 	    /* remember that we found a match for syncing on */
 	    if (syn_opt_arg.flags & (HL_SYNC_HERE|HL_SYNC_THERE))
@@ -5239,6 +6671,7 @@ syn_cmd_region(eap, syncing)
 		    }
 		    ++curwin->w_s->b_syn_patterns.ga_len;
 		    ++idx;
+		    syn_lit_clear(curwin->w_s);
 #ifdef FEAT_FOLDING
 		    if (syn_opt_arg.flags & HL_FOLD)
 			++curwin->w_s->b_syn_folditems;
@@ -6553,6 +7986,10 @@ ex_syntime(eap)
 	syntime_clear();
     else if (STRCMP(eap->arg, "report") == 0)
 	syntime_report();
+    else if (STRCMP(eap->arg, "groups") == 0)
+	syntime_report_groups();
+    else if (STRCMP(eap->arg, "lines") == 0)
+	syntime_report_lines();
     else
 	EMSG2(_(e_invarg2), eap->arg);
 }
@@ -6563,10 +8000,37 @@ syn_clear_time(st)
 {
     profile_zero(&st->total);
     profile_zero(&st->slowest);
+    profile_zero(&st->sync);
     st->count = 0;
     st->match = 0;
 }
 
+/*
+ * Add time "tm" used for matching in line "lnum" to the times per line.
+ */
+    static void
+syn_time_add_line(lnum, tm)
+    linenr_T	lnum;
+    proftime_T	*tm;
+{
+    garray_T	    *gap = &syn_block->b_syn_time_lines;
+    syn_linetime_T  *lt;
+
+    if (gap->ga_itemsize == 0)
+	ga_init2(gap, (int)sizeof(syn_linetime_T), 1000);
+    if (lnum > gap->ga_len)
+    {
+	if (ga_grow(gap, lnum - gap->ga_len) == FAIL)
+	    return;
+	vim_memset((syn_linetime_T *)gap->ga_data + gap->ga_len, 0,
+			    sizeof(syn_linetime_T) * (lnum - gap->ga_len));
+	gap->ga_len = lnum;
+    }
+    lt = (syn_linetime_T *)gap->ga_data + lnum - 1;
+    profile_add(&lt->total, tm);
+    ++lt->count;
+}
+
 /*
  * Clear the syntax timing for the current buffer.
  */
@@ -6586,6 +8050,7 @@ syntime_clear()
 	spp = &(SYN_ITEMS(curwin->w_s)[idx]);
 	syn_clear_time(&spp->sp_time);
     }
+    ga_clear(&curwin->w_s->b_syn_time_lines);
 }
 
 #if defined(FEAT_CMDL_COMPL) || defined(PROTO)
@@ -6604,6 +8069,8 @@ get_syntime_arg(xp, idx)
 	case 1: return (char_u *)"off";
 	case 2: return (char_u *)"clear";
 	case 3: return (char_u *)"report";
+	case 4: return (char_u *)"groups";
+	case 5: return (char_u *)"lines";
     }
     return NULL;
 }
@@ -6616,8 +8083,10 @@ typedef struct
     int		match;
     proftime_T	slowest;
     proftime_T	average;
+    proftime_T	sync;
     int		id;
-    char_u	*pattern;
+    char_u	*pattern;	/* NULL for a group */
+    int		patterns;	/* nr of patterns for a group */
 } time_entry_T;
 
     static int
@@ -6635,7 +8104,51 @@ syn_compare_syntime(v1, v2)
 }
 
 /*
- * Clear the syntax timing for the current buffer.
+ * Add up the syntax timing of the patterns in the current window per group.
+ * "gap" must have been initialized for time_entry_T, the entries are in the
+ * order the groups are first used in.
+ */
+    static void
+syntime_groups(gap)
+    garray_T	*gap;
+{
+    int		idx;
+    int		*group_idx;
+    synpat_T	*spp;
+    time_entry_T *p;
+
+    group_idx = (int *)alloc_clear(
+			     (unsigned)(sizeof(int) * (highlight_ga.ga_len + 1)));
+    if (group_idx == NULL)
+	return;
+    for (idx = 0; idx < curwin->w_s->b_syn_patterns.ga_len; ++idx)
+    {
+	spp = &(SYN_ITEMS(curwin->w_s)[idx]);
+	if (spp->sp_time.count == 0 || spp->sp_syn.id > highlight_ga.ga_len)
+	    continue;
+	if (group_idx[spp->sp_syn.id] == 0)
+	{
+	    if (ga_grow(gap, 1) == FAIL)
+		break;
+	    p = ((time_entry_T *)gap->ga_data) + gap->ga_len;
+	    vim_memset(p, 0, sizeof(time_entry_T));
+	    p->id = spp->sp_syn.id;
+	    group_idx[spp->sp_syn.id] = ++gap->ga_len;
+	}
+	p = ((time_entry_T *)gap->ga_data) + group_idx[spp->sp_syn.id] - 1;
+	profile_add(&p->total, &spp->sp_time.total);
+	profile_add(&p->sync, &spp->sp_time.sync);
+	if (profile_cmp(&spp->sp_time.slowest, &p->slowest) < 0)
+	    p->slowest = spp->sp_time.slowest;
+	p->count += spp->sp_time.count;
+	p->match += spp->sp_time.match;
+	++p->patterns;
+    }
+    vim_free(group_idx);
+}
+
+/*
+ * ":syntime report": list the syntax patterns by time used.
  */
     static void
 syntime_report()
@@ -6647,6 +8160,7 @@ syntime_report()
 # endif
     int		len;
     proftime_T	total_total;
+    proftime_T	total_sync;
     int		total_count = 0;
     garray_T    ga;
     time_entry_T *p;
@@ -6659,6 +8173,7 @@ syntime_report()
 
     ga_init2(&ga, sizeof(time_entry_T), 50);
     profile_zero(&total_total);
+    profile_zero(&total_sync);
     for (idx = 0; idx < curwin->w_s->b_syn_patterns.ga_len; ++idx)
     {
 	spp = &(SYN_ITEMS(curwin->w_s)[idx]);
@@ -6668,6 +8183,7 @@ syntime_report()
 	    p = ((time_entry_T *)ga.ga_data) + ga.ga_len;
 	    p->total = spp->sp_time.total;
 	    profile_add(&total_total, &spp->sp_time.total);
+	    profile_add(&total_sync, &spp->sp_time.sync);
 	    p->count = spp->sp_time.count;
 	    p->match = spp->sp_time.match;
 	    total_count += spp->sp_time.count;
@@ -6731,8 +8247,269 @@ syntime_report()
 	msg_advance(13);
 	msg_outnum(total_count);
 	MSG_PUTS("\n");
+	MSG_PUTS(profile_msg(&total_sync));
+	msg_advance(13);
+	MSG_PUTS(_("syncing"));
+	MSG_PUTS("\n");
+	profile_sub(&total_total, &total_sync);
+	MSG_PUTS(profile_msg(&total_total));
+	msg_advance(13);
+	MSG_PUTS(_("displaying"));
+	MSG_PUTS("\n");
+    }
+}
+
+/*
+ * ":syntime groups": list the syntax groups by time used.
+ */
+    static void
+syntime_report_groups()
+{
+    int		idx;
+    garray_T    ga;
+    time_entry_T *p;
+
+    if (!syntax_present(curwin))
+    {
+	MSG(_(msg_no_items));
+	return;
+    }
+
+    ga_init2(&ga, sizeof(time_entry_T), 50);
+    syntime_groups(&ga);
+    qsort(ga.ga_data, (size_t)ga.ga_len, sizeof(time_entry_T),
+							 syn_compare_syntime);
+
+    MSG_PUTS_TITLE(_("  TOTAL      COUNT  MATCH   SYNC      PATTERNS    NAME"));
+    MSG_PUTS("\n");
+    for (idx = 0; idx < ga.ga_len && !got_int; ++idx)
+    {
+	p = ((time_entry_T *)ga.ga_data) + idx;
+
+	MSG_PUTS(profile_msg(&p->total));
+	MSG_PUTS(" ");
+	msg_advance(13);
+	msg_outnum(p->count);
+	MSG_PUTS(" ");
+	msg_advance(20);
+	msg_outnum(p->match);
+	MSG_PUTS(" ");
+	msg_advance(26);
+	MSG_PUTS(profile_msg(&p->sync));
+	MSG_PUTS(" ");
+	msg_advance(38);
+	msg_outnum(p->patterns);
+	MSG_PUTS(" ");
+	msg_advance(50);
+	msg_outtrans(HL_TABLE()[p->id - 1].sg_name);
+	MSG_PUTS("\n");
+    }
+    ga_clear(&ga);
+}
+
+#define SYNTIME_LINES 20	/* nr of lines for ":syntime lines" */
+
+/*
+ * ":syntime lines": list the lines where matching took the most time.
+ */
+    static void
+syntime_report_lines()
+{
+    garray_T		*gap = &curwin->w_s->b_syn_time_lines;
+    syn_linetime_T	*lt = (syn_linetime_T *)gap->ga_data;
+    linenr_T		top[SYNTIME_LINES];
+    int			ntop = 0;
+    int			i;
+    linenr_T		lnum;
+
+    if (!syntax_present(curwin))
+    {
+	MSG(_(msg_no_items));
+	return;
+    }
+
+    /* Insertion sort into the list of slowest lines. */
+    for (lnum = 1; lnum <= gap->ga_len; ++lnum)
+    {
+	if (lt[lnum - 1].count == 0)
+	    continue;
+	for (i = ntop; i > 0; --i)
+	{
+	    if (profile_cmp(&lt[top[i - 1] - 1].total, &lt[lnum - 1].total)
+									  <= 0)
+		break;
+	    if (i < SYNTIME_LINES)
+		top[i] = top[i - 1];
+	}
+	if (i < SYNTIME_LINES)
+	{
+	    top[i] = lnum;
+	    if (ntop < SYNTIME_LINES)
+		++ntop;
+	}
+    }
+
+    MSG_PUTS_TITLE(_("  TOTAL      COUNT  LINE"));
+    MSG_PUTS("\n");
+    for (i = 0; i < ntop && !got_int; ++i)
+    {
+	MSG_PUTS(profile_msg(&lt[top[i] - 1].total));
+	MSG_PUTS(" ");
+	msg_advance(13);
+	msg_outnum(lt[top[i] - 1].count);
+	MSG_PUTS(" ");
+	msg_advance(20);
+	msg_outnum((long)top[i]);
+	MSG_PUTS("\n");
+    }
+}
+
+# if defined(FEAT_EVAL) || defined(PROTO)
+/*
+ * Set "tv" to the time "tm" in seconds: a Float, or a String when there is no
+ * Float support.
+ */
+    static void
+syntime_tv(tv, tm)
+    typval_T	*tv;
+    proftime_T	*tm;
+{
+    tv->v_lock = 0;
+#  ifdef FEAT_FLOAT
+    tv->v_type = VAR_FLOAT;
+    tv->vval.v_float = profile_float(tm);
+#  else
+    tv->v_type = VAR_STRING;
+    tv->vval.v_string = vim_strsave((char_u *)profile_msg(tm));
+#  endif
+}
+
+/*
+ * Add the time "tm" to dictionary "d".
+ */
+    static void
+syntime_dict_add(d, key, tm)
+    dict_T	*d;
+    char	*key;
+    proftime_T	*tm;
+{
+    dictitem_T	*item;
+
+    item = dictitem_alloc((char_u *)key);
+    if (item == NULL)
+	return;
+    syntime_tv(&item->di_tv, tm);
+    if (dict_add(d, item) == FAIL)
+	dictitem_free(item);
+}
+
+/*
+ * Put the syntax timing of the current window in dictionary "d", for
+ * syntime().
+ */
+    void
+syntime_dict(d)
+    dict_T	*d;
+{
+    int		idx;
+    synpat_T	*spp;
+    garray_T    ga;
+    time_entry_T *p;
+    list_T	*list;
+    list_T	*l;
+    dict_T	*dict;
+    typval_T	tv;
+    proftime_T	total_total;
+    proftime_T	total_sync;
+    garray_T	*gap = &curwin->w_s->b_syn_time_lines;
+    linenr_T	lnum;
+
+    profile_zero(&total_total);
+    profile_zero(&total_sync);
+
+    list = list_alloc();
+    if (list == NULL)
+	return;
+    dict_add_list(d, "patterns", list);
+    for (idx = 0; idx < curwin->w_s->b_syn_patterns.ga_len; ++idx)
+    {
+	spp = &(SYN_ITEMS(curwin->w_s)[idx]);
+	if (spp->sp_time.count == 0)
+	    continue;
+	profile_add(&total_total, &spp->sp_time.total);
+	profile_add(&total_sync, &spp->sp_time.sync);
+	if ((dict = dict_alloc()) == NULL
+		|| list_append_dict(list, dict) == FAIL)
+	    return;
+	dict_add_nr_str(dict, "name", 0L,
+				       HL_TABLE()[spp->sp_syn.id - 1].sg_name);
+	dict_add_nr_str(dict, "pattern", 0L, spp->sp_pattern);
+	syntime_dict_add(dict, "total", &spp->sp_time.total);
+	syntime_dict_add(dict, "sync", &spp->sp_time.sync);
+	syntime_dict_add(dict, "slowest", &spp->sp_time.slowest);
+	dict_add_nr_str(dict, "count", spp->sp_time.count, NULL);
+	dict_add_nr_str(dict, "match", spp->sp_time.match, NULL);
+    }
+
+    list = list_alloc();
+    if (list == NULL)
+	return;
+    dict_add_list(d, "groups", list);
+    ga_init2(&ga, sizeof(time_entry_T), 50);
+    syntime_groups(&ga);
+    for (idx = 0; idx < ga.ga_len; ++idx)
+    {
+	p = ((time_entry_T *)ga.ga_data) + idx;
+	if ((dict = dict_alloc()) == NULL
+		|| list_append_dict(list, dict) == FAIL)
+	    break;
+	dict_add_nr_str(dict, "name", 0L, HL_TABLE()[p->id - 1].sg_name);
+	syntime_dict_add(dict, "total", &p->total);
+	syntime_dict_add(dict, "sync", &p->sync);
+	syntime_dict_add(dict, "slowest", &p->slowest);
+	dict_add_nr_str(dict, "count", (long)p->count, NULL);
+	dict_add_nr_str(dict, "match", (long)p->match, NULL);
+	dict_add_nr_str(dict, "patterns", (long)p->patterns, NULL);
+    }
+    ga_clear(&ga);
+
+    list = list_alloc();
+    if (list == NULL)
+	return;
+    dict_add_list(d, "lines", list);
+    for (lnum = 1; lnum <= gap->ga_len; ++lnum)
+    {
+	syn_linetime_T	*lt = (syn_linetime_T *)gap->ga_data + lnum - 1;
+
+	if (lt->count == 0)
+	    continue;
+	if ((l = list_alloc()) == NULL)
+	    break;
+	tv.v_type = VAR_LIST;
+	tv.v_lock = 0;
+	tv.vval.v_list = l;
+	if (list_append_tv(list, &tv) == FAIL)
+	{
+	    list_free(l, TRUE);
+	    break;
+	}
+	tv.v_type = VAR_NUMBER;
+	tv.vval.v_number = (varnumber_T)lnum;
+	list_append_tv(l, &tv);
+	syntime_tv(&tv, &lt->total);
+	list_append_tv(l, &tv);
+	clear_tv(&tv);
+	tv.v_type = VAR_NUMBER;
+	tv.vval.v_number = (varnumber_T)lt->count;
+	list_append_tv(l, &tv);
     }
+
+    syntime_dict_add(d, "total", &total_total);
+    syntime_dict_add(d, "sync", &total_sync);
+    profile_sub(&total_total, &total_sync);
+    syntime_dict_add(d, "display", &total_total);
 }
+# endif
 #endif
 
 #endif /* FEAT_SYN_HL */
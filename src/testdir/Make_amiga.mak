@@ -43,16 +43,30 @@ SCRIPTS = test1.out test3.out test4.out test5.out test6.out \
 		test_changelist.out \
 		test_close_count.out \
 		test_command_count.out \
+		test_errorformat.out \
 		test_eval.out \
 		test_insertcount.out \
+		test_largefile.out \
+		test_line2byte.out \
 		test_listlbr.out \
 		test_listlbr_utf8.out \
+		test_make.out \
 		test_mapping.out \
 		test_nested_function.out \
 		test_options.out \
 		test_qf_title.out \
+		test_regcache.out \
+		test_search_index.out \
 		test_signs.out \
-		test_utf8.out
+		test_sub_undo.out \
+		test_synstatefile.out \
+		test_syntax_ahead.out \
+		test_syntax_keyword.out \
+		test_syntax_text.out \
+		test_syntime.out \
+		test_utf8.out \
+		test_vimgrep.out \
+		test_writelong.out
 
 .SUFFIXES: .in .out
 
@@ -183,13 +197,27 @@ test_breakindent.out: test_breakindent.in
 test_changelist.out: test_changelist.in
 test_close_count.out: test_close_count.in
 test_command_count.out: test_command_count.in
+test_errorformat.out: test_errorformat.in
 test_eval.out: test_eval.in
 test_insertcount.out: test_insertcount.in
+test_largefile.out: test_largefile.in
+test_line2byte.out: test_line2byte.in
 test_listlbr.out: test_listlbr.in
 test_listlbr_utf8.out: test_listlbr_utf8.in
+test_make.out: test_make.in
 test_mapping.out: test_mapping.in
 test_nested_function.out: test_nested_function.in
 test_options.out: test_options.in
 test_qf_title.out: test_qf_title.in
+test_regcache.out: test_regcache.in
+test_search_index.out: test_search_index.in
 test_signs.out: test_signs.in
+test_sub_undo.out: test_sub_undo.in
+test_synstatefile.out: test_synstatefile.in
+test_syntax_ahead.out: test_syntax_ahead.in
+test_syntax_keyword.out: test_syntax_keyword.in
+test_syntax_text.out: test_syntax_text.in
+test_syntime.out: test_syntime.in
 test_utf8.out: test_utf8.in
+test_vimgrep.out: test_vimgrep.in
+test_writelong.out: test_writelong.in
@@ -64,16 +64,30 @@ SCRIPTS =	test3.out test4.out test5.out test6.out test7.out \
 		test_changelist.out \
 		test_close_count.out \
 		test_command_count.out \
+		test_errorformat.out \
 		test_eval.out \
 		test_insertcount.out \
+		test_largefile.out \
+		test_line2byte.out \
 		test_listlbr.out \
 		test_listlbr_utf8.out \
+		test_make.out \
 		test_mapping.out \
 		test_nested_function.out \
 		test_options.out \
 		test_qf_title.out \
+		test_regcache.out \
+		test_search_index.out \
 		test_signs.out \
-		test_utf8.out
+		test_sub_undo.out \
+		test_synstatefile.out \
+		test_syntax_ahead.out \
+		test_syntax_keyword.out \
+		test_syntax_text.out \
+		test_syntime.out \
+		test_utf8.out \
+		test_vimgrep.out \
+		test_writelong.out
 
 SCRIPTS32 =	test50.out test70.out
 
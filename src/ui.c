@@ -172,6 +172,12 @@ ui_inchar(buf, maxlen, wtime, tb_change_cnt)
     }
 #endif
 
+#ifdef FEAT_SYN_HL
+    /* Use the time waiting for a character to parse syntax ahead. */
+    if (wtime == -1)
+	syntax_ahead();
+#endif
+
     /* If we are going to wait for some time or block... */
     if (wtime == -1 || wtime > 100L)
     {
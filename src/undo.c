@@ -641,6 +641,46 @@ u_savecommon(top, bot, newbot, reload)
 
 	/* find line number for ue_bot for previous u_save() */
 	u_getbot();
+
+	/*
+	 * When saving the line just below the lines of the last entry, and
+	 * neither that entry nor this change the number of lines, add the
+	 * line to that entry.  This is what ":s" does on a range of lines,
+	 * the result is one entry instead of one for every line, which makes
+	 * undo and redo a lot faster.
+	 */
+	uep = curbuf->b_u_newhead->uh_entry;
+	if (size == 1 && newbot == bot && uep != NULL && uep->ue_size > 0
+		&& uep->ue_top + uep->ue_size == top
+		&& uep->ue_bot == top + 1
+#if !defined(UNIX) && !defined(DJGPP) && !defined(WIN32) && !defined(__EMX__)
+		&& uep->ue_size < 4000
+#endif
+		)
+	{
+	    if (uep->ue_size >= uep->ue_alloc)
+	    {
+		char_u	**array;
+
+		/* Double the size, to avoid copying the array many times. */
+		array = (char_u **)U_ALLOC_LINE(
+					 sizeof(char_u *) * uep->ue_size * 2);
+		if (array == NULL)
+		    goto nomem;
+		mch_memmove(array, uep->ue_array,
+					  sizeof(char_u *) * uep->ue_size);
+		vim_free(uep->ue_array);
+		uep->ue_array = array;
+		uep->ue_alloc = uep->ue_size * 2;
+	    }
+	    if ((uep->ue_array[uep->ue_size] = u_save_line(top + 1)) == NULL)
+		goto nomem;
+	    ++uep->ue_size;
+	    ++uep->ue_bot;
+	    curbuf->b_u_synced = FALSE;
+	    undo_undoes = FALSE;
+	    return OK;
+	}
     }
 
 #if !defined(UNIX) && !defined(DJGPP) && !defined(WIN32) && !defined(__EMX__)
@@ -2819,6 +2859,7 @@ u_undoredo(undo)
 	u_newcount += newsize;
 	u_oldcount += oldsize;
 	uep->ue_size = oldsize;
+	uep->ue_alloc = 0;
 	uep->ue_array = newarray;
 	uep->ue_bot = top + newsize + 1;
 
@@ -1024,6 +1024,7 @@ extern char *(*dyn_libintl_textdomain)(const char *domainname);
 #define RE_STRING	2	/* match in string instead of buffer text */
 #define RE_STRICT	4	/* don't allow [abc] without ] */
 #define RE_AUTO		8	/* automatic engine selection */
+#define RE_COST		16	/* engine selection by cost */
 
 #ifdef FEAT_SYN_HL
 /* values for reg_do_extmatch */
@@ -1070,6 +1071,8 @@ extern char *(*dyn_libintl_textdomain)(const char *domainname);
 #define MFS_STOP	2	/* stop syncing when a character is available */
 #define MFS_FLUSH	4	/* flushed file to disk */
 #define MFS_ZERO	8	/* only write block 0 */
+#define MFS_SLICE	16	/* only write a few blocks marked by
+				   mf_sync_start() */
 
 /* flags for buf_copy_options() */
 #define BCO_ENTER	1	/* going to enter the buffer */